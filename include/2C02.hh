@@ -2,6 +2,8 @@
 #define _2C02_HH
 
 #include "cartridge.hh"
+#include "palette.hh"
+#include "state.hh"
 #include <cstdint>
 #include <memory>
 
@@ -21,13 +23,56 @@ public:
   void connect_cartridge(const std::shared_ptr<Cartridge> cart);
   void clk();
 
+  // save states (see state.hh)
+  void save_state(StateWriter &w) const;
+  void load_state(StateReader &r);
+
   // signal the cpu that a vblank nmi has occured
   bool nmi = false;
   bool frame_complete = false;
+
+  // frame skip: no pixel composition or output, but sprite 0 hit,
+  // overflow and vblank timing still run
+  bool skip_render = false;
+
+  // a scanline counting mapper (mmc3) is clocked when ppu a12 rises. the
+  // dot it rises on is worked out from ctrl instead of watching every
+  // pattern fetch, so the bus can schedule it. this is how many dots from
+  // now until it rises, or -1 while nothing is rendered. with 8x16
+  // sprites it depends on each line's sprites, then it is the dots until
+  // they are evaluated and has to be asked again
+  int32_t dots_to_a12_rise() const;
+  // true if the dot a12 rose on was run in the last 3 dots
+  bool a12_rose() const;
+  // outside rendering the ppu address bus rests on v, so the cpu moves
+  // a12 itself through $2006 writes and $2007 accesses. this is a12 (0 or
+  // 1) while nothing is rendered, -1 while rendering drives the bus and
+  // the rises come from dots_to_a12_rise
+  int idle_a12() const;
   
 
-  // 256x240 screen buffer (RGBA)
-  uint32_t* screen_buffer = new uint32_t[256*240];
+  // output frame the ppu draws into. the ppu owns one, frontends can
+  // point it at their own storage between frames (e.g. a triple buffer)
+  struct Frame {
+    // 256x240 screen buffer (ARGB), written in OUTPUT_ARGB mode
+    uint32_t pixels[256*240];
+    // 9 bit palette indices (colour | emphasis << 6), written in
+    // OUTPUT_INDEXED mode. convert with palette (see palette.hh)
+    uint16_t index[256*240];
+    // hash of each line's output, equal hashes mean the line is unchanged
+    uint32_t line_hash[240];
+  };
+
+  enum OutputMode {
+    OUTPUT_ARGB,
+    OUTPUT_INDEXED
+  };
+  // indexed output writes half the bytes and leaves colour conversion to
+  // whoever consumes the frame
+  OutputMode output_mode = OUTPUT_ARGB;
+  void set_frame(Frame* f);
+  Frame* frame = nullptr;
+  uint32_t* screen_buffer = nullptr;
 
   // palette to convert nes colours to rgb
   struct Pixel {
@@ -36,6 +81,9 @@ public:
     uint8_t b;
   };
 
+  // 9 bit index -> ARGB, built from palette_lut with emphasis applied
+  Palette palette;
+
   // generated with https://github.com/Gumball2415/pally
   Pixel palette_lut[0x3F + 1] = {
     {0x62, 0x62, 0x62},
@@ -118,7 +166,7 @@ public:
     uint8_t attribute;
     // x pos
     uint8_t x;
-  } oam[64];
+  } oam[64] = {};
 
   uint8_t* oam_p = (uint8_t*) oam;
   
@@ -127,11 +175,13 @@ public:
 
 private:
   std::shared_ptr<Cartridge> cart;
+  Frame own_frame;
+  uint32_t line_hash = 0;
   
   // 2kb vram (2 nametables) (background)
-  uint8_t nametable[2][1024];
+  uint8_t nametable[2][1024] = {};
   
-  uint8_t palette_ram[32];
+  uint8_t palette_ram[32] = {};
 
   uint16_t vram_addr = 0x0000;
   uint16_t vram_addr_tmp = 0x0000;
@@ -184,18 +234,26 @@ private:
 
 
   // sprites on current scanline (max 8)
-  OAM scanline_sprites[8];
-  uint8_t n_sprites;
+  OAM scanline_sprites[8] = {};
+  uint8_t n_sprites = 0;
 
   // sprite shift registers (8 units, one for each potential visible sprite)
-  uint8_t sprite_shifter_lo[8];
-  uint8_t sprite_shifter_hi[8];
+  uint8_t sprite_shifter_lo[8] = {};
+  uint8_t sprite_shifter_hi[8] = {};
 
   bool possible_zerohit = false;
   bool rendering_zerohit = false;
       
   void clear_sprite_shifters();
   inline uint8_t reverse_bits(uint8_t b);
+
+  // a12 rise on the current line: the dot, -1 for none, -2 if 8x16
+  // sprites decide and aren't evaluated yet
+  int a12_rise_dot() const;
+  // same for any rendered line with 8x8 sprites
+  int a12_rise_in_line() const;
+  // dots from now until the ppu has run the given dot
+  int32_t dots_to(int16_t line, int16_t dot) const;
   
 };
 
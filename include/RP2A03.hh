@@ -2,8 +2,9 @@
 #define RP2A03_HH
 
 #include <cstdint>
-#include <memory>
+#include <functional>
 #include "apu.hh"
+#include "state.hh"
 
 class Bus;
 class PPU;
@@ -14,7 +15,7 @@ public:
   ~RP2A03();
 
   void connect_bus(Bus* b);
-  void connect_ppu(std::shared_ptr<PPU> p);
+  void connect_ppu(PPU* p);
 
   // 2A03 interprets writes to $4000 - $4017
   void cpu_write(uint16_t addr, uint8_t data);
@@ -22,6 +23,9 @@ public:
 
   void clk();
   void reset();
+  // save states (see state.hh)
+  void save_state(StateWriter &w) const;
+  void load_state(StateReader &r);
 
   // DMA
   // DMA transfer suspends cpu for 513/514 cycles
@@ -39,11 +43,17 @@ public:
   uint8_t controller_state[2] = {0};
   uint8_t controller_strobe = 0x00;
 
+  // optional frontend callback returning the buttons of a port, sampled
+  // when a $4016 write latches the pads (strobe 1->0) instead of once
+  // before the frame, so input that arrives mid frame still counts for
+  // that frame
+  std::function<uint8_t(int port)> input_provider;
+
   APU apu;
 
 private:
   Bus* bus = nullptr;
-  std::shared_ptr<PPU> ppu;
+  PPU* ppu = nullptr;
 
   // TODO: APU
 };
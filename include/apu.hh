@@ -3,6 +3,7 @@
 
 #include <cstdint>
 #include <memory>
+#include "state.hh"
 
 class Bus;
 
@@ -20,9 +21,19 @@ public:
 
   void clk();
   void reset();
+  // save states (see state.hh)
+  void save_state(StateWriter &w) const;
+  void load_state(StateReader &r);
 
   // main output
   float get_audio_sample();
+  // same mix from q15 tables, 1.0 = 32768 so it is returned widened
+  int32_t get_audio_sample_q15();
+
+  // each channel through its side of the mixer, in the order
+  // pulse 1, pulse 2, triangle, noise, dmc
+  static const int N_CHANNELS = 5;
+  void get_channel_samples(float out[N_CHANNELS]);
 
   enum frame_counter_mode {
     FOUR_STEP,
@@ -165,13 +176,23 @@ private:
     bool sample_buf_empty = true;
 
     uint8_t shift_reg = 0;
-    uint8_t bits_left = 0;
+    uint8_t bits_left = 8;
     bool silence = true;
 
-    uint16_t timer = 0;
+    bool interrupt = false;
+
+    // called each time the rate timer expires (scheduled, not per cycle)
     void clock_timer();
   } dmc;
 
+  // memory reader, runs as a dma on the scheduler whenever the sample
+  // buffer is empty and there are bytes left to play
+  void clock_dmc(uint64_t at);
+  void request_dmc_fetch(uint64_t at);
+  void dmc_fetch();
+  void restart_dmc_sample();
+  void set_dmc_interrupt(bool b);
+
   static constexpr uint16_t dmc_rates_ntsc[16] = {
     428, 380, 340, 320, 286, 254, 226, 214, 190, 160, 142, 128, 106, 84, 72, 54
   };
@@ -183,13 +204,40 @@ private:
   };
 
   // FRAME COUNTER
+  // the sequencer is driven by the scheduler: each step knows the cpu cycle
+  // it lands on (relative to the last $4017 write) and only that step is
+  // scheduled, nothing is checked per cycle
+  // https://www.nesdev.org/wiki/APU_Frame_Counter
+  struct frame_step_T {
+    uint32_t cycle;
+    bool quarter;
+    bool half;
+    bool irq;
+  };
+
+  static constexpr frame_step_T frame_steps[2][4] = {
+    // 4-step: ~240hz quarter frame, ~120hz half frame, irq on last step
+    {{7457, true, false, false}, {14913, true, true, false},
+     {22371, true, false, false}, {29829, true, true, true}},
+    // 5-step: ~192hz quarter frame, ~96hz half frame, no irq
+    {{7457, true, false, false}, {14913, true, true, false},
+     {22371, true, false, false}, {37281, true, true, false}}
+  };
+  static constexpr uint32_t frame_period[2] = {29830, 37282};
+
   uint8_t frame_counter_mode = FOUR_STEP;
   bool irq_inhibit = false;
   bool frame_interrupt = false;
-  uint32_t frame_clock_counter = 0;
-  bool frame_delay = false;
+  uint64_t frame_start = 0;
+  uint8_t frame_step = 0;
+
+  // pulse timers tick on every other cpu cycle
+  bool apu_cycle = false;
 
+  void restart_frame_counter();
+  void schedule_frame_step();
   void clock_frame_counter();
+  void set_frame_interrupt(bool b);
   // envelope and triangle linear counter
   void clock_quarter_frame();
   // length counters and sweep units
@@ -201,6 +249,8 @@ private:
   // MIXER
   float pulse_table[31];
   float tnd_table[203];
+  int16_t pulse_table_q15[31];
+  int16_t tnd_table_q15[203];
   void init_mixer_tables();
 };
 
@@ -0,0 +1,35 @@
+#ifndef ARCHIVE_HH
+#define ARCHIVE_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// roms inside zip and gzip files, decompressed in memory with the built
+// in inflater (inflate.hh), no library and no temp file
+// https://pkware.cachefly.net/webdocs/casestudies/APPNOTE.TXT
+// https://www.rfc-editor.org/rfc/rfc1952
+class Archive {
+public:
+  enum Type {
+    NONE,
+    GZIP,
+    ZIP
+  };
+  static Type detect(const uint8_t* data, size_t size);
+
+  // the rom of a gzip file, or the first .nes entry of a zip, into out
+  // (sized from the archive's header, so it is allocated once). false if
+  // there is none or it fails its crc. name is the stored file name
+  static bool extract_rom(const uint8_t* data, size_t size, std::vector<uint8_t> &out, std::string* name = nullptr);
+
+  // larger than any rom, a header asking for more is broken
+  static const size_t MAX_SIZE = 64 << 20;
+
+private:
+  static bool gunzip(const uint8_t* data, size_t size, std::vector<uint8_t> &out, std::string* name);
+  static bool unzip(const uint8_t* data, size_t size, std::vector<uint8_t> &out, std::string* name);
+};
+
+#endif
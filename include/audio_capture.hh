@@ -0,0 +1,81 @@
+#ifndef AUDIO_CAPTURE_HH
+#define AUDIO_CAPTURE_HH
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "spsc_queue.hh"
+
+// streams the mix and every apu channel into 16 bit wav files
+// the emulation thread only copies each frame's block into a lock-free
+// queue; a background thread converts and writes with large buffered writes.
+// if the writer falls behind, blocks are dropped rather than stalling
+class AudioCapture {
+public:
+  AudioCapture();
+  ~AudioCapture();
+
+  enum Stream {
+    MIX,
+    PULSE1,
+    PULSE2,
+    TRIANGLE,
+    NOISE,
+    DMC,
+    N_STREAMS
+  };
+
+  static const int BLOCK_SIZE = 1024;
+
+  // writes <prefix>.mix.wav and, with stems, <prefix>.<channel>.wav
+  bool start(const std::string &prefix, int sample_rate, bool stems);
+  void stop();
+
+  bool running() const { return active; }
+  bool stems_enabled() const { return stems; }
+
+  // emulation thread, never blocks
+  void push_block(Stream stream, const float* samples, int n);
+
+  uint64_t dropped_blocks() const { return dropped.load(); }
+
+  // emulation thread time the bus spent on capture, sampling stems and
+  // filtering and queueing blocks
+  void add_capture_time(uint64_t ns) { capture_ns += ns; }
+  // that time as a share of the audio captured, which is the share of
+  // every frame's time (0.01 = 1%)
+  double capture_load() const;
+
+private:
+  struct Block {
+    int len;
+    float samples[BLOCK_SIZE];
+  };
+
+  // ~4 seconds of headroom per stream
+  typedef SPSCQueue<Block, 256> BlockQueue;
+
+  bool active = false;
+  bool stems = false;
+  int sample_rate = 44100;
+
+  std::unique_ptr<BlockQueue> queues[N_STREAMS];
+  FILE* files[N_STREAMS] = {nullptr};
+  uint32_t data_bytes[N_STREAMS] = {0};
+
+  std::thread writer;
+  std::atomic<bool> quit{false};
+  std::atomic<uint64_t> dropped{0};
+  std::atomic<uint64_t> capture_ns{0};
+  std::atomic<uint64_t> mix_samples{0};
+
+  void writer_loop();
+  bool drain();
+  void write_header(FILE* f, uint32_t bytes);
+};
+
+#endif
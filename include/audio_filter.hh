@@ -0,0 +1,72 @@
+#ifndef AUDIO_FILTER_HH
+#define AUDIO_FILTER_HH
+
+#include <cmath>
+#include <cstdint>
+
+// the nes output stage is a chain of first order filters:
+// 90hz high pass -> 440hz high pass -> 14khz low pass
+// https://www.nesdev.org/wiki/APU_Mixer
+//
+// filters run on resampled output one frame block at a time, so the cost
+// scales with the output rate instead of the cpu clock
+class AudioFilter {
+public:
+  AudioFilter(float sample_rate = 44100.0f);
+  ~AudioFilter();
+
+  void set_sample_rate(float sample_rate);
+  void reset();
+
+  // filter a block in place, picks the fastest variant available
+  void process(float* buf, int n);
+
+  // reference implementation, one sample through all stages at a time
+  void process_scalar(float* buf, int n);
+
+  // fixed point variant for targets without fast floats
+  // samples are q15 in and out, coefficients are q30 and the filter state
+  // keeps 8 extra fraction bits so rounding does not build up in the
+  // feedback path
+  void process_q15(int32_t* buf, int n);
+
+  // filter output to the int16 ring. both paths scale 1.0 to 32768, so
+  // the float reference and the fixed path land on the same codes
+  static inline int16_t to_int16(float v) {
+    return to_int16_q15((int32_t) lrintf(v * 32768.0f));
+  }
+  static inline int16_t to_int16_q15(int32_t v) {
+    if (v > 32767) v = 32767;
+    if (v < -32768) v = -32768;
+    return (int16_t) v;
+  }
+
+  #ifdef __SSE2__
+  // one simd lane per stage, samples move through the lanes as a wavefront
+  // output is identical to process_scalar
+  void process_sse2(float* buf, int n);
+  #endif
+
+private:
+  static const int STAGES = 3;
+
+  // every stage has the form y[n] = b0*x[n] + b1*x[n-1] + a1*y[n-1]
+  // arrays are padded to 4 so they can be loaded as one vector
+  float b0[4] = {0};
+  float b1[4] = {0};
+  float a1[4] = {0};
+
+  // filter state (previous input and output of each stage)
+  float x_prev[4] = {0};
+  float y_prev[4] = {0};
+
+  int32_t b0_q30[STAGES] = {0};
+  int32_t b1_q30[STAGES] = {0};
+  int32_t a1_q30[STAGES] = {0};
+  int32_t x_prev_q23[STAGES] = {0};
+  int32_t y_prev_q23[STAGES] = {0};
+
+  inline float step(int stage, float x);
+};
+
+#endif
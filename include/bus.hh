@@ -4,11 +4,16 @@
 #include <cstdint>
 #include <array>
 #include <memory>
+#include <atomic>
 
 #include "RP2A03.hh"
 #include "cartridge.hh"
 #include "mos6502.hh"
 #include "2C02.hh"
+#include "audio_filter.hh"
+#include "scheduler.hh"
+#include "audio_capture.hh"
+#include "state.hh"
 
 class Bus {
 public:
@@ -22,25 +27,116 @@ public:
   uint8_t cpu_read(uint16_t addr, bool readonly);
 
   PPU ppu;
-  std::shared_ptr<RP2A03> rp;
+  RP2A03 rp;
   std::shared_ptr<Cartridge> cart;
-  std::shared_ptr<APU> apu;
 
   // interface
   void insert_cartridge(const std::shared_ptr<Cartridge>& cart);
   void reset();
   void clk();
+  // run until the ppu completes a frame, resampling audio along the way
+  void run_frame();
+  // frames completed by run_frame since power on
+  uint64_t frame_count = 0;
+
+  // whole machine state, everything needed to continue emulation exactly
+  // (frontend settings and audio output are not part of it)
+  void save_state(StateWriter &w) const;
+  bool load_state(StateReader &r);
+
+  // per component hashes of the machine state, for finding where two runs
+  // of the same input stop agreeing
+  enum StateComponent {
+    STATE_CPU,
+    STATE_RAM,
+    STATE_PPU,
+    STATE_APU,
+    STATE_MAPPER,
+    STATE_SYSTEM,
+    N_STATE_COMPONENTS
+  };
+  static const char* component_name(int component);
+  void hash_state(uint64_t hashes[N_STATE_COMPONENTS]);
+  // when set, run_frame leaves the hashes of each finished frame here
+  bool hash_frames = false;
+  uint64_t frame_hash[N_STATE_COMPONENTS] = {0};
 
   uint32_t sys_clocks = 0;
+  // never reset, timestamps for the scheduler are taken from this
+  uint64_t cpu_clocks = 0;
+  Scheduler scheduler;
+
+  // irq is a shared level triggered line, each source drives its own bit
+  enum IRQ_SOURCE : uint8_t {
+    IRQ_APU_FRAME = 1 << 0,
+    IRQ_APU_DMC   = 1 << 1,
+    IRQ_MAPPER    = 1 << 2,
+  };
+  uint8_t irq_lines = 0x00;
+  void set_irq(IRQ_SOURCE source, bool asserted);
 
+  // cycles the cpu is halted for while the dmc reads a sample byte
+  uint8_t cpu_stall = 0;
+  void stall_cpu(uint8_t cycles);
+
+  // output ring, int16 so the audio callback moves half the bytes
   static const int AUDIO_BUF_SIZE = 4096;
-  float audio_buf[AUDIO_BUF_SIZE];
-  int audio_write_pos = 0;
-  int audio_read_pos = 0;
+  int16_t audio_buf[AUDIO_BUF_SIZE];
+  // written by the emulation thread, read by the audio callback
+  std::atomic<int> audio_write_pos{0};
+  std::atomic<int> audio_read_pos{0};
+
+  // off while fast forwarding, the ring would only overflow
+  bool audio_output = true;
 
-  void push_audio_sample(float sample);
-  float pop_audio_sample();
+  void push_audio_sample(int16_t sample);
+  int16_t pop_audio_sample();
   int get_audio_buf_size();
+
+  // fixed point (q15) mixer and filters instead of the float reference path
+  // default can be flipped at build time with -DAUDIO_FIXED_POINT
+  #ifdef AUDIO_FIXED_POINT
+  bool audio_fixed_point = true;
+  #else
+  bool audio_fixed_point = false;
+  #endif
+
+  // resampled output of the current frame, filtered as one block
+  // before it is handed to the ring buffer
+  static const int AUDIO_BLOCK_SIZE = 1024;
+  float audio_block[AUDIO_BLOCK_SIZE];
+  int32_t audio_block_q15[AUDIO_BLOCK_SIZE];
+  int audio_block_len = 0;
+  AudioFilter audio_filter;
+
+  // optional capture of the mix and per channel stems (owned by frontend)
+  AudioCapture* audio_capture = nullptr;
+  float stem_block[APU::N_CHANNELS][AUDIO_BLOCK_SIZE];
+  AudioFilter stem_filter[APU::N_CHANNELS];
+  // time spent on capture in the current block, handed over on flush
+  uint64_t capture_ns = 0;
+
+  // ppu clocks between output samples (~44khz)
+  static const int AUDIO_RESAMPLE_PERIOD = 122;
+  // called by the resampler at the output rate
+  void sample_audio();
+  void flush_audio_block();
+
+private:
+  #ifdef DEBUG
+  // trace line limits
+  int debug_mask_writes = 0;
+  int debug_nmi_waits = 0;
+  #endif
+
+  // reused between hash_state calls, keeps its capacity
+  StateWriter hash_scratch;
+
+  // the cartridge counts scanlines, ppu a12 rises are scheduled for it
+  bool watch_a12 = false;
+  void schedule_a12();
+  void a12_event();
+  void idle_a12_event(int before);
 };
 
 #endif
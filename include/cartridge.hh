@@ -4,21 +4,34 @@
 #include <cstdint>
 #include <memory>
 #include <string>
-#include <fstream>
 #include <vector>
+#include "rom_cache.hh"
+#include "save_ram.hh"
+#include "state.hh"
 
+#include "mappers/mapper_registry.hh"
 #include "mappers/mapper_template.hh"
-#include "mappers/all_mappers.hh"
 
 class Cartridge {
 public:
-  Cartridge(const std::string &romfile);
+  // with a cache, cartridges of the same rom share its (read only) image
+  // and only own their chr ram and the mapper's registers and prg ram
+  Cartridge(const std::string &romfile, RomCache* cache = nullptr);
   ~Cartridge();
 
+  // false if the rom couldn't be loaded or its mapper isn't supported
   bool valid = false;
-  uint8_t mapper_id;
-  uint8_t banks_PRG;
-  uint8_t banks_CHR;
+  uint16_t mapper_id = 0;
+  // what the board carries besides the mapper (MapperRegistry::Capability)
+  uint8_t capabilities = 0;
+  uint16_t banks_PRG = 0;
+  uint16_t banks_CHR = 0;
+  // fnv-1a over prg and chr rom, identifies the game in movies. only
+  // worked out when asked for, see RomImage::rom_hash
+  uint64_t rom_hash() const { return image ? image->rom_hash() : 0; }
+
+  // header fields are in image->info
+  std::shared_ptr<const RomImage> image;
 
   enum Mirror {
     HORIZONTAL,
@@ -37,9 +50,27 @@ public:
   bool ppu_read(uint16_t addr, uint8_t &data);
   bool ppu_write(uint16_t addr, uint8_t data);
 
+  // mirroring, chr ram, the mapper's registers and prg ram
+  void save_state(StateWriter &w) const;
+  void load_state(StateReader &r);
+
+  // keeps battery backed prg ram in a file from now on, loading what was
+  // saved there. false if the board has no battery or the file can't be
+  // opened, the ram then stays in memory
+  bool open_save(const std::string &path);
+  // the rom's path with a .sav extension
+  static std::string save_path(const std::string &romfile);
+  const SaveRam* save() const { return save_ram.get(); }
+
 private:
-   std::vector<uint8_t> mem_PRG;
-   std::vector<uint8_t> mem_CHR;
+  const uint8_t* mem_PRG = nullptr;
+  // prg_ram, or the save file's mapping
+  uint8_t* mem_RAM = nullptr;
+  std::vector<uint8_t> prg_ram;
+  std::unique_ptr<SaveRam> save_ram;
+  // the image's chr rom, or chr_ram
+  const uint8_t* mem_CHR = nullptr;
+  std::vector<uint8_t> chr_ram;
 };
 
 #endif
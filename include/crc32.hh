@@ -0,0 +1,15 @@
+#ifndef CRC32_HH
+#define CRC32_HH
+
+#include <cstddef>
+#include <cstdint>
+
+// the crc-32 of zip, gzip and png (reflected 0xEDB88320)
+// eight bytes per step through eight tables (slicing by 8)
+class Crc32 {
+public:
+  // crc of data following whatever gave crc, start with 0
+  static uint32_t update(uint32_t crc, const void* data, size_t len);
+};
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef FRAME_PACER_HH
+#define FRAME_PACER_HH
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+
+// paces the emulation thread against absolute deadlines so the frame rate
+// does not drift, and keeps jitter statistics for the frontend to show
+class FramePacer {
+public:
+  // 1789773 hz cpu / 29780.5 cycles per frame
+  static constexpr double NTSC_RATE = 60.0988;
+
+  FramePacer(double rate = NTSC_RATE);
+  ~FramePacer();
+
+  // restart pacing from now
+  void reset();
+
+  // sleep until the next frame is due
+  void wait();
+
+  // fast forward: wait() returns immediately, frames are still counted
+  void set_unlimited(bool b);
+  bool is_unlimited() const { return unlimited; }
+
+  struct Stats {
+    double fps = 0.0;
+    // fps as a multiple of real time
+    double speed = 0.0;
+    // how far wakeups landed from their deadline
+    double jitter_avg_ms = 0.0;
+    double jitter_stddev_ms = 0.0;
+    double jitter_max_ms = 0.0;
+    // frames that missed their deadline by more than a frame
+    uint64_t late = 0;
+    uint64_t frames = 0;
+  };
+
+  // stats gathered since the previous call, safe to call from any thread
+  Stats collect();
+
+private:
+  typedef std::chrono::steady_clock clock;
+
+  double rate;
+  clock::duration period;
+  clock::time_point next;
+  bool unlimited = false;
+
+  std::mutex stats_lock;
+  clock::time_point window_start;
+  uint64_t frames = 0;
+  uint64_t late = 0;
+  uint64_t jitter_samples = 0;
+  double jitter_sum = 0.0;
+  double jitter_sum_sq = 0.0;
+  double jitter_max = 0.0;
+};
+
+#endif
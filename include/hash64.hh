@@ -0,0 +1,33 @@
+#ifndef HASH64_HH
+#define HASH64_HH
+
+#include <cstddef>
+#include <cstdint>
+
+// fast 64 bit hash in the style of xxh3: 8 accumulators take a 64 byte
+// stripe at a time (32x32->64 multiplies, easy to vectorise) and are
+// scrambled every 1kb, then folded down. not cryptographic, and not
+// compatible with real xxh3, but the result only depends on the bytes so
+// it is the same on every build and platform
+class Hash64 {
+public:
+  static uint64_t hash(const void* data, size_t len, uint64_t seed = 0);
+  static uint64_t hash_scalar(const void* data, size_t len, uint64_t seed = 0);
+  #ifdef __SSE2__
+  // 2 lanes per register, identical result to the scalar one
+  static uint64_t hash_sse2(const void* data, size_t len, uint64_t seed = 0);
+  #endif
+
+  static const int STRIPE = 64;
+  static const int STRIPES_PER_BLOCK = 16;
+
+private:
+  static void init(uint64_t acc[8], uint64_t seed);
+  // n = the stripe's position in its block
+  static void stripe_scalar(uint64_t acc[8], const uint8_t* p, int n);
+  static void scramble_scalar(uint64_t acc[8]);
+  // last partial stripe (zero padded) and the fold down to 64 bits
+  static uint64_t finish(uint64_t acc[8], const uint8_t* tail, size_t tail_len, size_t len);
+};
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef INFLATE_HH
+#define INFLATE_HH
+
+#include <cstddef>
+#include <cstdint>
+
+// raw deflate decoder (rfc 1951), for roms stored in zip and gzip files
+// https://www.rfc-editor.org/rfc/rfc1951
+//
+// the output goes straight into a buffer the caller sized from the
+// container's header, there is no window or intermediate copy. huffman
+// codes up to FAST_BITS long (nearly all of them) decode with one table
+// lookup, longer ones bit by bit
+class Inflate {
+public:
+  // decodes the stream in into out. false if the data is damaged or
+  // doesn't fit in out_size bytes. out_len is how much was written
+  static bool inflate(const uint8_t* in, size_t in_size, uint8_t* out, size_t out_size, size_t &out_len);
+
+  static const int MAX_BITS = 15;
+  static const int FAST_BITS = 10;
+
+private:
+  struct Huffman {
+    // symbol | length << 9 for codes of up to FAST_BITS bits, 0 for the
+    // prefixes of longer ones. indexed by the next bits of input
+    uint16_t fast[1 << FAST_BITS];
+    // canonical code: how many codes of each length, symbols by code
+    uint16_t count[MAX_BITS + 1];
+    uint16_t symbol[288];
+  };
+
+  struct Bits;
+
+  // false if the lengths over-subscribe the code space
+  static bool build(Huffman &h, const uint8_t* lengths, int n);
+  // -1 on damaged data
+  static int decode(Bits &bits, const Huffman &h);
+  static bool codes(Bits &bits, const Huffman &lit, const Huffman &dist, uint8_t* out, size_t out_size, size_t &pos);
+  static bool dynamic_tables(Bits &bits, Huffman &lit, Huffman &dist);
+};
+
+#endif
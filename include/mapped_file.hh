@@ -0,0 +1,36 @@
+#ifndef MAPPED_FILE_HH
+#define MAPPED_FILE_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// a whole file as read only memory. mapped private where mmap exists, so
+// pages are read lazily and shared with every other process that has the
+// file in its page cache. elsewhere (or for empty files) it is one read
+class MappedFile {
+public:
+  MappedFile();
+  ~MappedFile();
+  MappedFile(MappedFile &&other);
+  MappedFile &operator=(MappedFile &&other);
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  bool open(const std::string &path);
+  void close();
+
+  bool is_open() const { return bytes != nullptr; }
+  bool is_mapped() const { return mapped; }
+  const uint8_t* data() const { return bytes; }
+  size_t size() const { return length; }
+
+private:
+  const uint8_t* bytes = nullptr;
+  size_t length = 0;
+  bool mapped = false;
+  std::vector<uint8_t> buffer;
+};
+
+#endif
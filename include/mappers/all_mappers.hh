@@ -1,7 +0,0 @@
-#ifndef ALL_MAPPERS_HH
-#define ALL_MAPPERS_HH
-
-#include <mappers/mapper_000.hh>
-#include <mappers/mapper_001.hh>
-
-#endif
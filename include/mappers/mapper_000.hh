@@ -5,7 +5,7 @@
 
 class Mapper_000 : public Mapper_Template {
 public:
-  Mapper_000(uint8_t banks_PRG, uint8_t banks_CHR);
+  Mapper_000(uint16_t banks_PRG, uint16_t banks_CHR);
   ~Mapper_000();
 
   
@@ -4,6 +4,7 @@
 #include "mapper_template.hh"
 #include <cstdint>
 #include <functional>
+#include "state.hh"
 
 class Mapper_001 : public Mapper_Template {
 private:
@@ -29,15 +30,16 @@ private:
   std::function<void(uint8_t)> mirror_callback;
 
 public:
-  std::vector<uint8_t> prg_ram;
-  
-  Mapper_001(uint8_t banks_PRG, uint8_t banks_CHR, std::function<void(uint8_t)> mirror_callback);
+  Mapper_001(uint16_t banks_PRG, uint16_t banks_CHR, std::function<void(uint8_t)> mirror_callback);
   ~Mapper_001();
   
   bool cpu_mapread(uint16_t addr, uint32_t &addr_mapped) override;
   bool cpu_mapwrite(uint16_t addr, uint32_t &addr_mapped, uint8_t data) override;
   bool ppu_mapread(uint16_t addr, uint32_t &addr_mapped) override;
   bool ppu_mapwrite(uint16_t addr, uint32_t &addr_mapped) override;
+
+  void save_state(StateWriter &w) const override;
+  void load_state(StateReader &r) override;
   
   void reset();
 };
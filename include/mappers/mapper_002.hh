@@ -0,0 +1,18 @@
+#ifndef MAPPER_002_HH
+#define MAPPER_002_HH
+
+#include "mapper_discrete.hh"
+#include <cstdint>
+
+// UxROM: switchable 16kb at $8000, the last bank fixed at $C000, 8kb chr
+// https://www.nesdev.org/wiki/UxROM
+class Mapper_002 : public Mapper_Discrete {
+public:
+  Mapper_002(uint16_t banks_PRG, uint16_t banks_CHR);
+  ~Mapper_002();
+
+protected:
+  void apply() override;
+};
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef MAPPER_003_HH
+#define MAPPER_003_HH
+
+#include "mapper_discrete.hh"
+#include <cstdint>
+
+// CNROM: fixed prg, switchable 8kb chr
+// https://www.nesdev.org/wiki/CNROM
+class Mapper_003 : public Mapper_Discrete {
+public:
+  Mapper_003(uint16_t banks_PRG, uint16_t banks_CHR);
+  ~Mapper_003();
+
+protected:
+  void apply() override;
+};
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef MAPPER_004_HH
+#define MAPPER_004_HH
+
+#include "mapper_template.hh"
+#include <cstdint>
+#include <functional>
+#include "state.hh"
+
+// MMC3 (TxROM)
+// https://www.nesdev.org/wiki/MMC3
+class Mapper_004 : public Mapper_Template {
+private:
+  // $8000: which of R0-R7 the next $8001 write sets, prg and chr modes
+  uint8_t bank_select = 0x00;
+  // R0-R1 2kb chr, R2-R5 1kb chr, R6-R7 8kb prg
+  uint8_t registers[8] = {0, 2, 4, 5, 6, 7, 0, 1};
+
+  // $A001: bit 7 enables prg ram, bit 6 protects it from writes
+  uint8_t ram_protect = 0x80;
+
+  // scanline counter, clocked by the bus when ppu a12 rises
+  uint8_t irq_latch = 0x00;
+  uint8_t irq_counter = 0x00;
+  bool irq_reload = false;
+  bool irq_enable = false;
+  bool irq = false;
+
+  // offsets into prg and chr of each 8kb cpu window ($8000-$FFFF) and
+  // 1kb ppu window ($0000-$1FFF), rebuilt when a register changes
+  uint32_t prg_offset[4] = {0};
+  uint32_t chr_offset[8] = {0};
+  void update_banks();
+
+  std::function<void(uint8_t)> mirror_callback;
+
+public:
+  Mapper_004(uint16_t banks_PRG, uint16_t banks_CHR, std::function<void(uint8_t)> mirror_callback);
+  ~Mapper_004();
+
+  bool cpu_mapread(uint16_t addr, uint32_t &addr_mapped) override;
+  bool cpu_mapwrite(uint16_t addr, uint32_t &addr_mapped, uint8_t data) override;
+  bool ppu_mapread(uint16_t addr, uint32_t &addr_mapped) override;
+  bool ppu_mapwrite(uint16_t addr, uint32_t &addr_mapped) override;
+
+  void clock_scanline() override;
+  bool irq_asserted() const override { return irq; }
+
+  void save_state(StateWriter &w) const override;
+  void load_state(StateReader &r) override;
+};
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef MAPPER_007_HH
+#define MAPPER_007_HH
+
+#include "mapper_discrete.hh"
+#include <cstdint>
+#include <functional>
+
+// AxROM: switchable 32kb prg, 8kb chr ram, bit 4 picks the nametable for
+// single screen mirroring
+// https://www.nesdev.org/wiki/AxROM
+class Mapper_007 : public Mapper_Discrete {
+private:
+  std::function<void(uint8_t)> mirror_callback;
+
+public:
+  Mapper_007(uint16_t banks_PRG, uint16_t banks_CHR, std::function<void(uint8_t)> mirror_callback);
+  ~Mapper_007();
+
+protected:
+  void apply() override;
+};
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef MAPPER_011_HH
+#define MAPPER_011_HH
+
+#include "mapper_discrete.hh"
+#include <cstdint>
+
+// Color Dreams: switchable 32kb prg (bits 0-1) and 8kb chr (bits 4-7)
+// https://www.nesdev.org/wiki/Color_Dreams
+class Mapper_011 : public Mapper_Discrete {
+public:
+  Mapper_011(uint16_t banks_PRG, uint16_t banks_CHR);
+  ~Mapper_011();
+
+protected:
+  void apply() override;
+};
+
+#endif
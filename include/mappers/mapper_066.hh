@@ -0,0 +1,18 @@
+#ifndef MAPPER_066_HH
+#define MAPPER_066_HH
+
+#include "mapper_discrete.hh"
+#include <cstdint>
+
+// GxROM: switchable 32kb prg (bits 4-5) and 8kb chr (bits 0-1)
+// https://www.nesdev.org/wiki/GxROM
+class Mapper_066 : public Mapper_Discrete {
+public:
+  Mapper_066(uint16_t banks_PRG, uint16_t banks_CHR);
+  ~Mapper_066();
+
+protected:
+  void apply() override;
+};
+
+#endif
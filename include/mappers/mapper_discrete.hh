@@ -0,0 +1,45 @@
+#ifndef MAPPER_DISCRETE_HH
+#define MAPPER_DISCRETE_HH
+
+#include "mapper_template.hh"
+#include <cstdint>
+#include <functional>
+#include "state.hh"
+
+// boards built from discrete logic (UxROM, CNROM, AxROM, GxROM, Color
+// Dreams): one latch written anywhere in $8000-$FFFF picks the banks.
+// the windows are only recomputed when it is written, reads are one
+// table lookup like NROM's mask
+class Mapper_Discrete : public Mapper_Template {
+public:
+  Mapper_Discrete(uint16_t banks_PRG, uint16_t banks_CHR);
+  ~Mapper_Discrete();
+
+  bool cpu_mapread(uint16_t addr, uint32_t &addr_mapped) override;
+  bool cpu_mapwrite(uint16_t addr, uint32_t &addr_mapped, uint8_t data) override;
+  bool ppu_mapread(uint16_t addr, uint32_t &addr_mapped) override;
+  bool ppu_mapwrite(uint16_t addr, uint32_t &addr_mapped) override;
+
+  void save_state(StateWriter &w) const override;
+  void load_state(StateReader &r) override;
+
+  // nes 2.0 submappers 1 and 2 of uxrom, cnrom and axrom say whether the
+  // board has bus conflicts, 0 keeps the board's default
+  void set_submapper(uint8_t submapper);
+
+protected:
+  uint8_t latch = 0x00;
+  // offsets of the 16kb cpu windows at $8000 and $C000, and of the 8kb
+  // ppu window
+  uint32_t prg_offset[2] = {0};
+  uint32_t chr_offset = 0;
+
+  // sets the windows from latch
+  virtual void apply() = 0;
+
+  void set_prg_16k(int window, uint32_t bank);
+  void set_prg_32k(uint32_t bank);
+  void set_chr_8k(uint32_t bank);
+};
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef MAPPER_REGISTRY_HH
+#define MAPPER_REGISTRY_HH
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "mapper_template.hh"
+
+// every mapper registers itself from its own .cc with an id, a factory and
+// what the board carries besides the mapper, so adding one touches
+// nothing else. the cartridge looks the id up once when a rom is loaded
+// and keeps the capabilities, nothing is looked up per access
+class MapperRegistry {
+public:
+  enum Capability : uint8_t {
+    // 8kb (or what the header asks for) of prg ram at $6000
+    PRG_RAM = 1 << 0,
+    // 8kb of chr ram when the rom has no chr
+    CHR_RAM = 1 << 1,
+    // the prg ram can be battery backed and kept in a .sav file
+    BATTERY = 1 << 2,
+    // a scanline counter clocked by ppu a12 drives the irq line
+    IRQ     = 1 << 3,
+  };
+
+  // what a factory gets from the cartridge
+  struct Board {
+    uint16_t banks_PRG = 0;
+    uint16_t banks_CHR = 0;
+    uint8_t submapper = 0;
+    // mirroring in mmc1's encoding (0 one screen lower, 1 upper,
+    // 2 vertical, 3 horizontal)
+    std::function<void(uint8_t)> set_mirror;
+  };
+
+  typedef std::shared_ptr<Mapper_Template> (*Factory)(const Board &board);
+
+  struct Entry {
+    uint16_t id;
+    const char* name;
+    uint8_t capabilities;
+    // the most 16kb prg and 8kb chr banks the board's registers reach
+    uint16_t max_banks_PRG;
+    uint16_t max_banks_CHR;
+    Factory create;
+  };
+
+  // a static one of these in a mapper's .cc adds it before main runs
+  struct Registration {
+    Registration(const Entry &entry);
+  };
+
+  // nullptr for a mapper that isn't supported
+  static const Entry* find(uint16_t id);
+  // sorted by id
+  static std::vector<Entry> all();
+};
+
+#endif
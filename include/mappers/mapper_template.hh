@@ -2,10 +2,11 @@
 #define MAPPER_TEMPLATE_HH
 
 #include <cstdint>
+#include "state.hh"
 
 class Mapper_Template {
 public:
-  Mapper_Template(uint8_t banks_PRG, uint8_t banks_CHR);
+  Mapper_Template(uint16_t banks_PRG, uint16_t banks_CHR);
   ~Mapper_Template();
 
   virtual bool cpu_mapread(uint16_t addr, uint32_t &addr_mapped) = 0;
@@ -13,10 +14,25 @@ public:
   virtual bool ppu_mapread(uint16_t addr, uint32_t &addr_mapped) = 0;
   virtual bool ppu_mapwrite(uint16_t addr, uint32_t &addr_mapped) = 0;
 
+  // bank registers and any ram the mapper owns, nothing by default
+  virtual void save_state(StateWriter &w) const;
+  virtual void load_state(StateReader &r);
+
+  // boards with a scanline counter (mmc3, registered with the irq
+  // capability) are clocked by the bus each time ppu a12 rises, and drive
+  // the irq line
+  virtual void clock_scanline() {}
+  virtual bool irq_asserted() const { return false; }
+
+  // on boards whose registers sit under rom, the rom drives the data bus
+  // during a register write too and the mapper sees the value and-ed with
+  // the rom byte. games avoid it, but some rely on it
+  bool bus_conflicts = false;
+
 
 protected:
-  uint8_t banks_PRG = 0;
-  uint8_t banks_CHR = 0;
+  uint16_t banks_PRG = 0;
+  uint16_t banks_CHR = 0;
 };
 
 
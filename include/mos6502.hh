@@ -2,8 +2,7 @@
 #define MOS6502_HH
 
 #include <cstdint>
-#include <string>
-#include <vector>
+#include "state.hh"
 
 class Bus;
 
@@ -30,6 +29,10 @@ public:
   void irq();
   void nmi();
 
+  // save states (see state.hh)
+  void save_state(StateWriter &w) const;
+  void load_state(StateReader &r);
+
   // flags which are stored in the psr
   enum FLAG : uint8_t {
     CARRY     = 1 << 0,
@@ -85,13 +88,18 @@ public:
 
 private:
   struct Instruction {
-    std::string inst_name;
+    const char* inst_name;
     uint8_t (CPU::*opcode)();
     uint8_t (CPU::*addr_mode)();
     uint8_t inst_cycles;
   };
 
-  std::vector<CPU::Instruction> lookup;
+  static const Instruction lookup[256];
+
+  #ifdef DEBUG
+  // instructions since the last trace line
+  int debug_count = 0;
+  #endif
 
   Bus *bus = nullptr;
   void write(uint16_t addr, uint8_t data);
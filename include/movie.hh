@@ -0,0 +1,104 @@
+#ifndef MOVIE_HH
+#define MOVIE_HH
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "mapped_file.hh"
+
+// input movies: the controller bytes every frame was run with, so a run
+// can be reproduced exactly from its start state
+//
+// header: "NESMOVIE", u32 version, u64 rom hash, u32 start state size,
+//         start state
+// records: varint (frame delta << 1 | kind), then
+//   kind 0, input:    u8 port 0, u8 port 1 (in effect from that frame on)
+//   kind 1, keyframe: u8 port 0, u8 port 1, varint size, save state taken
+//                     at the start of that frame
+// only input changes are stored, keyframes let playback seek without
+// replaying from the start
+class MovieWriter {
+public:
+  MovieWriter();
+  ~MovieWriter();
+
+  bool open(const std::string &path, uint64_t rom_hash, const std::vector<uint8_t> &start_state);
+  void close();
+  bool is_open() const { return file != nullptr; }
+
+  // input the frame was run with, frames must not go backwards
+  void record(uint64_t frame, uint8_t port0, uint8_t port1);
+  void keyframe(uint64_t frame, const std::vector<uint8_t> &state);
+
+private:
+  FILE* file = nullptr;
+  uint64_t last_frame = 0;
+  // last frame passed to record(), closing marks it as the end
+  uint64_t end_frame = 0;
+  uint8_t input[2] = {0};
+
+  void put_varint(uint64_t v);
+  void put_record(uint64_t frame, int kind);
+};
+
+// reads a whole movie through a read only mapping (or one read where mmap
+// is not available), so opening costs a scan over the record headers only
+class MovieReader {
+public:
+  MovieReader();
+  ~MovieReader();
+
+  bool open(const std::string &path);
+  void close();
+  bool is_open() const { return data != nullptr; }
+
+  uint64_t rom_hash = 0;
+  const uint8_t* start_state = nullptr;
+  size_t start_state_size = 0;
+
+  // last frame that has a record
+  uint64_t length() const { return last_frame; }
+
+  // input for a frame. streams forward, use seek() to go back
+  void input(uint64_t frame, uint8_t &port0, uint8_t &port1);
+
+  // moves to the last keyframe at or before frame and returns its state
+  // false if there is none, playback then starts from start_state at 0
+  bool seek(uint64_t frame, uint64_t &key_frame, const uint8_t* &state, size_t &state_size);
+
+  // keyframes in frame order, states point into the mapped file
+  size_t keyframe_count() const { return keyframes.size(); }
+  void keyframe(size_t i, uint64_t &frame, const uint8_t* &state, size_t &state_size) const;
+
+private:
+  MappedFile file;
+  // file.data() and file.size()
+  const uint8_t* data = nullptr;
+  size_t size = 0;
+
+  size_t records_start = 0;
+  size_t pos = 0;
+  uint64_t pos_frame = 0;
+  uint8_t current[2] = {0};
+
+  struct Keyframe {
+    uint64_t frame;
+    uint8_t ports[2];
+    size_t state_offset;
+    size_t state_size;
+    // first record after it
+    size_t next;
+  };
+  std::vector<Keyframe> keyframes;
+  uint64_t last_frame = 0;
+
+  bool get_varint(size_t &p, uint64_t &v) const;
+  // parses the record at p, returns false at the end of the data
+  bool next_record(size_t &p, uint64_t &frame, int &kind, uint8_t ports[2],
+                   size_t &state_offset, size_t &state_size) const;
+  bool build_index();
+};
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef PALETTE_HH
+#define PALETTE_HH
+
+#include <cstdint>
+
+// lookup from the ppu's 9 bit palette index to ARGB
+// bits 0-5: colour from palette ram, bits 6-8: emphasis (PPUMASK bits 5-7)
+// https://www.nesdev.org/wiki/PPU_palettes
+class Palette {
+public:
+  Palette();
+  ~Palette();
+
+  static const int SIZE = 512;
+
+  // base colour for each of the 64 indices, call update() afterwards
+  void set_colour(uint8_t index, uint8_t r, uint8_t g, uint8_t b);
+  // rebuilds the emphasised variants from the base colours
+  void update();
+
+  inline uint32_t operator[](uint16_t index) const {
+    return argb[index & (SIZE - 1)];
+  }
+
+  // convert a run of indices, picks the fastest variant the cpu supports
+  void to_argb(const uint16_t* index, uint32_t* out, int n) const;
+  void to_argb_scalar(const uint16_t* index, uint32_t* out, int n) const;
+  #if defined(__x86_64__) && defined(__GNUC__)
+  // 8 pixels per step through a vector gather
+  __attribute__((target("avx2")))
+  void to_argb_avx2(const uint16_t* index, uint32_t* out, int n) const;
+  #endif
+
+  uint32_t argb[SIZE];
+
+private:
+  uint8_t base[64][3];
+  bool use_avx2 = false;
+};
+
+#endif
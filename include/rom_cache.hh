@@ -0,0 +1,78 @@
+#ifndef ROM_CACHE_HH
+#define ROM_CACHE_HH
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "mapped_file.hh"
+#include "rom_info.hh"
+
+// the read only part of a cartridge: header fields and the prg and chr
+// rom. never changes after loading, so any number of cartridges (and
+// threads) can share one
+//
+// prg and chr point straight into the mapped file (see mapped_file.hh),
+// nothing is copied. zip and gzip files (see archive.hh) are inflated
+// into a buffer of their own, as is a file cut short of what its header
+// says (zero padded)
+class RomImage {
+public:
+  // nullptr if the file can't be read or its header is not valid
+  static std::shared_ptr<const RomImage> load(const std::string &path);
+  static std::shared_ptr<const RomImage> load(MappedFile &&file);
+
+  RomInfo info;
+  // fnv-1a over prg and chr rom, identifies the game in movies. worked
+  // out on first call, it reads every byte and so faults in every page
+  uint64_t rom_hash() const;
+
+  const uint8_t* prg = nullptr;
+  size_t prg_size = 0;
+  // null when the board has chr ram instead
+  const uint8_t* chr = nullptr;
+  size_t chr_size = 0;
+
+private:
+  MappedFile file;
+  std::vector<uint8_t> bytes;
+  mutable std::once_flag hash_once;
+  mutable uint64_t hash = 0;
+};
+
+// process wide cache of rom images keyed by the file's identity (device,
+// inode, size and modification time), so running the same game many times
+// (nes-batch) maps and parses its rom once without reading all of it. a
+// hard link shares, a copy under another name doesn't
+class RomCache {
+public:
+  RomCache();
+  ~RomCache();
+
+  // the cache every cartridge uses unless told otherwise
+  static RomCache &global();
+
+  // nullptr if the file can't be read. safe to call from any thread
+  std::shared_ptr<const RomImage> load(const std::string &path);
+
+  size_t size();
+  // images still in use by cartridges stay alive until those go
+  void clear();
+
+private:
+  struct Key {
+    uint64_t dev = 0, ino = 0, size = 0;
+    int64_t mtime_sec = 0, mtime_nsec = 0;
+    bool operator<(const Key &other) const;
+    bool operator==(const Key &other) const;
+  };
+  static bool identify(const std::string &path, Key &key);
+
+  std::mutex lock;
+  std::map<Key, std::shared_ptr<const RomImage>> images;
+};
+
+#endif
@@ -0,0 +1,84 @@
+#ifndef ROM_INDEX_HH
+#define ROM_INDEX_HH
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "mapped_file.hh"
+#include "rom_info.hh"
+
+// metadata of a whole rom library, written by nes-index. it is read
+// through a mapping, so finding a game costs no rom file reads at all
+//
+// "NESINDEX", u32 version, u32 entry count, the entries sorted by file
+// hash, then nul terminated paths and titles. fields are in native byte
+// order, the index is rebuilt rather than moved between machines
+class RomIndex {
+public:
+  RomIndex();
+  ~RomIndex();
+
+  struct Entry {
+    // Hash64 of the whole file, what the index is sorted and looked up
+    // by. the rom cache keys on file identity instead (see rom_cache.hh)
+    uint64_t file_hash;
+    // Cartridge::rom_hash, what movies are tied to
+    uint64_t rom_hash;
+    uint32_t prg_rom_size;
+    uint32_t chr_rom_size;
+    // volatile and battery backed together
+    uint32_t prg_ram_size;
+    uint32_t chr_ram_size;
+    // offsets of the strings
+    uint32_t path;
+    uint32_t title;
+    uint16_t mapper;
+    uint8_t submapper;
+    uint8_t region;
+    uint8_t flags;
+    uint8_t unused[3];
+  };
+
+  enum EntryFlags : uint8_t {
+    FLAG_NES2 = 1 << 0,
+    FLAG_BATTERY = 1 << 1,
+    FLAG_VERTICAL = 1 << 2,
+    FLAG_FOUR_SCREEN = 1 << 3
+  };
+
+  // one scanned rom, for write()
+  struct Rom {
+    RomInfo info;
+    uint64_t file_hash;
+    uint64_t rom_hash;
+    std::string path;
+    std::string title;
+  };
+  static bool write(const std::string &path, std::vector<Rom> roms);
+
+  bool open(const std::string &path);
+  void close();
+
+  size_t count() const { return n_entries; }
+  const Entry &entry(size_t i) const { return entries[i]; }
+  const char* path(const Entry &e) const { return strings + e.path; }
+  const char* title(const Entry &e) const { return strings + e.title; }
+
+  // nullptr if not there
+  const Entry* find(uint64_t file_hash) const;
+  const Entry* find_rom_hash(uint64_t rom_hash) const;
+  // case insensitive
+  const Entry* find_title(const std::string &title) const;
+
+  // rom path for a title or a hex file/rom hash, empty if none matches
+  std::string resolve(const std::string &name) const;
+
+private:
+  MappedFile file;
+  const Entry* entries = nullptr;
+  size_t n_entries = 0;
+  const char* strings = nullptr;
+};
+
+#endif
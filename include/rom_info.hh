@@ -0,0 +1,59 @@
+#ifndef ROM_INFO_HH
+#define ROM_INFO_HH
+
+#include <cstddef>
+#include <cstdint>
+
+// what an ines or nes 2.0 header says about a rom
+// https://www.nesdev.org/wiki/INES
+// https://www.nesdev.org/wiki/NES_2.0
+struct RomInfo {
+  enum Format {
+    INES,
+    NES2
+  };
+  enum Region {
+    NTSC,
+    PAL,
+    MULTI_REGION,
+    DENDY
+  };
+  enum Console {
+    NES,
+    VS_SYSTEM,
+    PLAYCHOICE,
+    EXTENDED
+  };
+
+  Format format = INES;
+  uint16_t mapper = 0;
+  uint8_t submapper = 0;
+  Console console = NES;
+  Region region = NTSC;
+
+  bool vertical_mirror = false;
+  bool four_screen = false;
+  bool battery = false;
+  bool trainer = false;
+
+  // all in bytes. ines only knows prg ram in 8kb units (0 = 8kb) and has
+  // chr ram exactly when there is no chr rom
+  uint64_t prg_rom_size = 0;
+  uint64_t chr_rom_size = 0;
+  uint32_t prg_ram_size = 0;
+  uint32_t prg_nvram_size = 0;
+  uint32_t chr_ram_size = 0;
+  uint32_t chr_nvram_size = 0;
+
+  // where prg rom starts in the file, after the header and trainer
+  size_t rom_offset = 0;
+
+  static const size_t HEADER_SIZE = 16;
+
+  // false if data doesn't start with a valid header
+  static bool parse(const uint8_t* data, size_t size, RomInfo &info);
+
+  static const char* region_name(Region region);
+};
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef SAVE_RAM_HH
+#define SAVE_RAM_HH
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// battery backed prg ram kept in a .sav file. where mmap exists the file
+// is mapped shared, so the cpu writes straight into the page cache and
+// the bytes survive the process dying. a background thread msyncs the
+// pages written since its last pass every FLUSH_INTERVAL_MS, so a crash
+// of the whole machine loses at most one interval. elsewhere the ram is
+// plain memory, loaded on open and written back on close
+class SaveRam {
+public:
+  SaveRam();
+  ~SaveRam();
+  SaveRam(const SaveRam &) = delete;
+  SaveRam &operator=(const SaveRam &) = delete;
+
+  static const int FLUSH_INTERVAL_MS = 1000;
+
+  // creates the file, or grows it to size, keeping what was saved
+  bool open(const std::string &path, size_t size);
+  // flushes everything and unmaps
+  void close();
+
+  bool is_open() const { return bytes != nullptr; }
+  bool is_mapped() const { return mapped; }
+  uint8_t* data() { return bytes; }
+  size_t size() const { return length; }
+
+  // call after writing offset. a plain store, the flusher does the rest
+  inline void touch(size_t offset) {
+    dirty[offset >> page_shift].store(1, std::memory_order_relaxed);
+  }
+  // after the whole ram changed, e.g. a state was loaded
+  void touch_all();
+
+  // writes the dirty pages out now. false on an io error
+  bool flush();
+
+  uint64_t flushed_pages() const { return n_flushed.load(); }
+
+private:
+  uint8_t* bytes = nullptr;
+  size_t length = 0;
+  bool mapped = false;
+  std::string path;
+  std::vector<uint8_t> buffer;
+
+  int page_shift = 12;
+  std::unique_ptr<std::atomic<uint8_t>[]> dirty;
+  size_t n_pages = 0;
+  std::atomic<uint64_t> n_flushed{0};
+
+  std::thread flusher;
+  std::mutex mutex;
+  std::condition_variable wake;
+  bool quit = false;
+
+  void flusher_loop();
+};
+
+#endif
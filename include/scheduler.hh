@@ -0,0 +1,56 @@
+#ifndef SCHEDULER_HH
+#define SCHEDULER_HH
+
+#include <cstdint>
+#include <functional>
+#include "state.hh"
+
+// events are keyed by absolute cpu cycle. devices compute when their next
+// piece of work is due and only get called at that timestamp, instead of
+// comparing a counter on every clock
+class Scheduler {
+public:
+  Scheduler();
+  ~Scheduler();
+
+  enum Event : uint8_t {
+    APU_FRAME,      // frame sequencer step (quarter/half frame, frame irq)
+    DMC_TIMER,      // dmc output unit shifts out one bit
+    DMC_DMA,        // dmc memory reader refills the sample buffer
+    MAPPER_A12,     // ppu a12 rises, clocks an mmc3 scanline counter
+    N_EVENTS
+  };
+
+  static constexpr uint64_t NEVER = UINT64_MAX;
+
+  // handler is called with the cycle the event was scheduled for
+  void set_handler(Event e, std::function<void(uint64_t)> handler);
+
+  void schedule(Event e, uint64_t cycle);
+  void cancel(Event e);
+  bool pending(Event e) const;
+  uint64_t when(Event e) const;
+
+  void reset();
+
+  // save states (see state.hh)
+  void save_state(StateWriter &w) const;
+  void load_state(StateReader &r);
+
+  // cheap check, called once per cpu cycle
+  inline void run(uint64_t now) {
+    if (now >= next_event) {
+      dispatch(now);
+    }
+  }
+
+private:
+  uint64_t next_event = NEVER;
+  uint64_t timestamps[N_EVENTS];
+  std::function<void(uint64_t)> handlers[N_EVENTS];
+
+  void dispatch(uint64_t now);
+  void update_next();
+};
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef SPSC_QUEUE_HH
+#define SPSC_QUEUE_HH
+
+#include <atomic>
+#include <cstddef>
+
+// bounded lock-free single producer / single consumer ring
+// slots are filled and drained in place so large blocks are never copied
+// through the queue itself. N must be a power of two
+template <typename T, size_t N>
+class SPSCQueue {
+  static_assert((N & (N - 1)) == 0, "queue size must be a power of two");
+
+public:
+  // producer: slot to fill, or nullptr if the queue is full
+  T* write_slot() {
+    size_t head = this->head.load(std::memory_order_relaxed);
+    if (head - this->tail.load(std::memory_order_acquire) == N) {
+      return nullptr;
+    }
+    return &slots[head & (N - 1)];
+  }
+
+  // producer: publish the slot returned by write_slot()
+  void push() {
+    this->head.store(this->head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  }
+
+  // consumer: oldest filled slot, or nullptr if the queue is empty
+  T* read_slot() {
+    size_t tail = this->tail.load(std::memory_order_relaxed);
+    if (tail == this->head.load(std::memory_order_acquire)) {
+      return nullptr;
+    }
+    return &slots[tail & (N - 1)];
+  }
+
+  // consumer: hand the slot returned by read_slot() back to the producer
+  void pop() {
+    this->tail.store(this->tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  }
+
+  size_t size() const {
+    return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+  }
+
+private:
+  T slots[N];
+  // keep the indices on separate cache lines
+  alignas(64) std::atomic<size_t> head{0};
+  alignas(64) std::atomic<size_t> tail{0};
+};
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef STATE_HH
+#define STATE_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+// save states are the raw bytes of each component's fields, appended in a
+// fixed order. they are only meant to be loaded by the same build
+class StateWriter {
+public:
+  template <typename T>
+  void write(const T &value) {
+    static_assert(std::is_trivially_copyable<T>::value, "state fields must be plain data");
+    this->write_bytes(&value, sizeof(T));
+  }
+
+  void write_bytes(const void* src, size_t n) {
+    const uint8_t* p = (const uint8_t*) src;
+    data.insert(data.end(), p, p + n);
+  }
+
+  // same name on both sides, so one field list can both save and load
+  template <typename T>
+  void field(const T &value) {
+    this->write(value);
+  }
+
+  std::vector<uint8_t> data;
+};
+
+class StateReader {
+public:
+  StateReader(const uint8_t* data, size_t size) : data(data), size(size) {}
+
+  template <typename T>
+  void read(T &value) {
+    static_assert(std::is_trivially_copyable<T>::value, "state fields must be plain data");
+    this->read_bytes(&value, sizeof(T));
+  }
+
+  void read_bytes(void* dst, size_t n) {
+    if (!ok || pos + n > size) {
+      ok = false;
+      return;
+    }
+    memcpy(dst, data + pos, n);
+    pos += n;
+  }
+
+  template <typename T>
+  void field(T &value) {
+    this->read(value);
+  }
+
+  // false once a read ran past the end, the state is then only partly loaded
+  bool ok = true;
+
+private:
+  const uint8_t* data;
+  size_t size;
+  size_t pos = 0;
+};
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef THREAD_POOL_HH
+#define THREAD_POOL_HH
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// fixed set of worker threads for splitting work into pieces
+// the calling thread takes part in the work, so a pool of size 1 has no
+// workers and runs everything inline
+//
+// work stealing: each thread starts on its own contiguous share of the
+// index range and takes from the front of it. a thread that runs out
+// steals the back half of another thread's share, so uneven tasks (whole
+// emulation jobs, not just equal sized bands) still keep every core busy
+class ThreadPool {
+public:
+  // 0 = one thread per core
+  ThreadPool(int n_threads = 0);
+  ~ThreadPool();
+
+  // threads that take part in parallel_for, including the caller
+  int size() const { return (int) workers.size() + 1; }
+
+  // runs fn(i) for every i in [0, n) and returns once all have finished
+  void parallel_for(int n, const std::function<void(int)> &fn);
+
+private:
+  std::vector<std::thread> workers;
+
+  std::mutex lock;
+  std::condition_variable wake;
+  std::condition_variable done;
+
+  const std::function<void(int)>* task = nullptr;
+  int active = 0;
+  uint64_t generation = 0;
+  bool stopping = false;
+
+  // a thread's remaining share, begin << 32 | end. the owner and thieves
+  // both change it with a compare exchange, one cache line each
+  struct alignas(64) Share {
+    std::atomic<uint64_t> range{0};
+  };
+  // [0] is the calling thread's, [i + 1] worker i's
+  std::unique_ptr<Share[]> shares;
+
+  void worker_loop(int self);
+  void run_tasks(const std::function<void(int)>* fn, int self);
+  bool pop(int self, int &i);
+  bool steal(int self);
+};
+
+#endif
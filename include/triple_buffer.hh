@@ -0,0 +1,48 @@
+#ifndef TRIPLE_BUFFER_HH
+#define TRIPLE_BUFFER_HH
+
+#include <atomic>
+#include <cstdint>
+
+// lock-free triple buffer for handing whole frames from one producer to
+// one consumer. the producer always has a back buffer to draw into, the
+// consumer always gets the newest completed frame, neither ever waits
+template <typename T>
+class TripleBuffer {
+public:
+  // producer: buffer to draw the next frame into
+  T* back() {
+    return &slots[back_idx];
+  }
+
+  // producer: hand the back buffer over and take the spare one
+  void publish() {
+    back_idx = middle.exchange(back_idx | FRESH, std::memory_order_acq_rel) & INDEX;
+  }
+
+  // consumer: newest published frame, or nullptr if nothing new was
+  // published since the last call
+  T* acquire() {
+    if (!(middle.load(std::memory_order_acquire) & FRESH)) {
+      return nullptr;
+    }
+    front_idx = middle.exchange(front_idx, std::memory_order_acq_rel) & INDEX;
+    return &slots[front_idx];
+  }
+
+  // consumer: frame returned by the last acquire()
+  T* front() {
+    return &slots[front_idx];
+  }
+
+private:
+  static const uint8_t INDEX = 0x03;
+  static const uint8_t FRESH = 0x04;
+
+  T slots[3];
+  uint8_t back_idx = 0;
+  uint8_t front_idx = 1;
+  std::atomic<uint8_t> middle{2};
+};
+
+#endif
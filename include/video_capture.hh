@@ -0,0 +1,104 @@
+#ifndef VIDEO_CAPTURE_HH
+#define VIDEO_CAPTURE_HH
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "palette.hh"
+#include "spsc_queue.hh"
+#include "video_filter.hh"
+
+// records frames to a y4m file, or to a png sequence when the path ends
+// in .png (shot.png -> shot_000000.png, shot_000001.png, ...)
+//
+// the emulation thread only copies the frame's palette indices into a
+// queue slot. a converter thread filters and converts them (to yuv 4:2:0
+// for y4m), and a writer thread does large buffered writes. if either
+// falls behind, frames are dropped rather than stalling emulation
+class VideoCapture {
+public:
+  VideoCapture();
+  ~VideoCapture();
+
+  enum Format {
+    Y4M,
+    PNG
+  };
+
+  bool start(const std::string &path, const Palette* palette, VideoFilter::Type filter);
+  void stop();
+
+  bool running() const { return active; }
+
+  // emulation thread, never blocks
+  void push_frame(const uint16_t* index);
+
+  uint64_t dropped_frames() const { return dropped.load(); }
+  uint64_t written_frames() const { return written.load(); }
+
+  // stream header for w x h frames, each frame follows as "FRAME\n" and
+  // the y, u and v planes
+  static std::string y4m_header(int w, int h);
+
+  // ARGB -> planar yuv 4:2:0, bt.601 full range (what C420jpeg means)
+  // chroma comes from the average of each 2x2 block. w must be a multiple
+  // of 8 and h even
+  static void to_yuv420(const uint32_t* argb, int w, int h, uint8_t* y, uint8_t* u, uint8_t* v);
+  static void to_yuv420_scalar(const uint32_t* argb, int w, int h, uint8_t* y, uint8_t* u, uint8_t* v);
+  #ifdef __SSE2__
+  // 8 luma and 4 chroma samples per step, identical output to the scalar one
+  static void to_yuv420_sse2(const uint32_t* argb, int w, int h, uint8_t* y, uint8_t* u, uint8_t* v);
+  #endif
+
+  // w x h rgb rows (3 bytes per pixel) as an uncompressed png
+  static bool save_png(const std::string &path, const uint8_t* rgb, int w, int h);
+
+private:
+  struct IndexFrame {
+    uint16_t index[256*240];
+  };
+
+  // converted frame, y4m planes or rgb rows depending on the format
+  struct Picture {
+    std::vector<uint8_t> data;
+  };
+
+  // ~250ms of headroom in front of the converter, then a few frames
+  // in front of the writer
+  typedef SPSCQueue<IndexFrame, 16> IndexQueue;
+  typedef SPSCQueue<Picture, 4> PictureQueue;
+
+  bool active = false;
+  Format format = Y4M;
+  std::string path;
+  int width = 0;
+  int height = 0;
+
+  std::unique_ptr<IndexQueue> frames;
+  std::unique_ptr<PictureQueue> pictures;
+  std::unique_ptr<VideoFilter> filter;
+  std::vector<uint32_t> argb;
+
+  FILE* file = nullptr;
+
+  std::thread converter;
+  std::thread writer;
+  std::atomic<bool> quit{false};
+  std::atomic<bool> converter_done{false};
+  std::atomic<uint64_t> dropped{0};
+  std::atomic<uint64_t> written{0};
+
+  void converter_loop();
+  void writer_loop();
+  bool convert();
+  bool drain();
+
+  void write_png(const Picture &picture);
+};
+
+#endif
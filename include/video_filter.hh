@@ -0,0 +1,92 @@
+#ifndef VIDEO_FILTER_HH
+#define VIDEO_FILTER_HH
+
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "palette.hh"
+#include "thread_pool.hh"
+
+// turns the ppu's indexed frames into ARGB at the output resolution
+// lines are independent apart from a small vertical radius, so a frame is
+// cut into horizontal bands that run on the thread pool
+class VideoFilter {
+public:
+  enum Type {
+    NEAREST,  // 1x, plain palette lookup
+    SCALE2X,  // https://www.scale2x.it/algorithm
+    SCALE3X,
+    HQ2X,     // https://en.wikipedia.org/wiki/Hqx
+    NTSC,     // composite signal encode/decode, 3x wide
+    N_TYPES
+  };
+
+  VideoFilter(ThreadPool* pool);
+  ~VideoFilter();
+
+  static const char* name(Type type);
+  // false for a name no filter has
+  static bool from_name(const std::string &name, Type &type);
+
+  void set_type(Type type);
+  Type get_type() const { return type; }
+
+  // colours used by every filter except NTSC, which builds its own from
+  // the signal. call again when the palette changes
+  void set_palette(const Palette* palette);
+
+  // output size
+  int width() const;
+  int height() const;
+  int scale_x() const;
+  int scale_y() const;
+  // how many input lines above and below an output line depends on
+  int radius() const;
+
+  // filters lines [first, last] of a 256x240 index frame into out, which
+  // points at the first output row belonging to line first. pitch is in bytes
+  void apply(const uint16_t* index, int first, int last, uint32_t* out, int pitch);
+
+private:
+  Type type = NEAREST;
+  ThreadPool* pool;
+  const Palette* palette = nullptr;
+
+  // hq2x: y, u and v of every index, for telling visible edges apart
+  // from small colour steps
+  int16_t yuv[3][Palette::SIZE] = {};
+
+  // ntsc: contribution of a pixel to the 3 output samples of the pixel
+  // `d` columns away, per colour phase and 9 bit index
+  // laid out [phase][index][tap][sub][bgra]
+  static const int NTSC_TAPS = 5;
+  std::vector<float> ntsc_kernel;
+
+  void build_yuv();
+  void build_ntsc_kernel();
+
+  void filter_lines(const uint16_t* index, int first, int last, uint32_t* out, int pitch);
+
+  void nearest_line(const uint16_t* index, int y, uint32_t* out, int pitch);
+  void scale2x_line(const uint16_t* index, int y, uint32_t* out, int pitch);
+  void scale3x_line(const uint16_t* index, int y, uint32_t* out, int pitch);
+  void hq2x_line(const uint16_t* index, int y, uint32_t* out, int pitch);
+  uint32_t hq2x_pixel(int rule, const uint16_t n[9], const uint32_t c[9], const uint8_t frame[5]) const;
+  void ntsc_line(const uint16_t* index, int y, uint32_t* out, int pitch);
+
+  // the thresholds hq2x uses on y, u and v
+  static const int Y_THRESHOLD = 0x30;
+  static const int U_THRESHOLD = 0x07;
+  static const int V_THRESHOLD = 0x06;
+  inline bool differs(uint16_t a, uint16_t b) const {
+    a &= Palette::SIZE - 1;
+    b &= Palette::SIZE - 1;
+    return abs(yuv[0][a] - yuv[0][b]) > Y_THRESHOLD
+        || abs(yuv[1][a] - yuv[1][b]) > U_THRESHOLD
+        || abs(yuv[2][a] - yuv[2][b]) > V_THRESHOLD;
+  }
+};
+
+#endif
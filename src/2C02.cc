@@ -5,6 +5,12 @@
 
 PPU::PPU() {
   this->oam_p = (uint8_t*)this->oam;
+  this->set_frame(&this->own_frame);
+
+  for (int i = 0; i < 64; i++) {
+    palette.set_colour(i, palette_lut[i].r, palette_lut[i].g, palette_lut[i].b);
+  }
+  palette.update();
 }
 
 PPU::~PPU() {
@@ -267,6 +273,92 @@ void PPU::ppu_write(uint16_t addr, uint8_t data) {
   }
 }
 
+int PPU::a12_rise_dot() const {
+  if (!(mask & 0x18) || scanline >= 240) {
+    return -1;
+  }
+  if ((ctrl & 0x20) && cycle <= 257) {
+    return -2;
+  }
+  return this->a12_rise_in_line();
+}
+
+int PPU::a12_rise_in_line() const {
+  // fetches come in 8 dot groups that each read one pattern table: 32
+  // background tiles, a tile for each of the 8 sprite slots from dot 257
+  // (tile $FF for empty ones) and 2 background tiles from dot 321. the
+  // mapper filters out the short dips to $2xxx for nametable fetches, so
+  // a12 rises once, 3 dots into the first $1000 group after a $0000 one
+  uint8_t bg = (ctrl >> 4) & 0x01;
+  uint8_t sprite[8];
+  for (int i = 0; i < 8; i++) {
+    // 8x16 sprites pick the table with the tile's low bit
+    sprite[i] = (ctrl & 0x20) ? scanline_sprites[i].tile_id & 0x01 : (ctrl >> 3) & 0x01;
+  }
+
+  // the background groups before the sprites can't rise, they follow the
+  // previous line's prefetch from the same table
+  uint8_t last = bg;
+  for (int i = 0; i < 8; i++) {
+    if (sprite[i] && !last) {
+      return 257 + 8 * i + 3;
+    }
+    last = sprite[i];
+  }
+  if (bg && !last) {
+    return 321 + 3;
+  }
+  return -1;
+}
+
+int32_t PPU::dots_to(int16_t line, int16_t dot) const {
+  // a frame is 262 lines of 341 dots, less dot 0 of line 0
+  auto position = [](int32_t l, int32_t d) {
+    return (l + 1) * 341 + d - (l >= 0 ? 1 : 0);
+  };
+  const int32_t frame = 262 * 341 - 1;
+  int32_t now = position(scanline, (scanline == 0 && cycle == 0) ? 1 : cycle);
+  return ((position(line, dot) - now) % frame + frame) % frame;
+}
+
+int32_t PPU::dots_to_a12_rise() const {
+  if (!(mask & 0x18)) {
+    return -1;
+  }
+  int rise = this->a12_rise_dot();
+  if (rise == -2) {
+    return this->dots_to(scanline, 257);
+  }
+  if (rise >= cycle) {
+    return this->dots_to(scanline, rise);
+  }
+
+  // the next rendered line, the pre render line after vblank
+  int16_t next = (scanline >= -1 && scanline < 239) ? scanline + 1 : -1;
+  if (ctrl & 0x20) {
+    return this->dots_to(next, 257);
+  }
+  rise = this->a12_rise_in_line();
+  return rise < 0 ? -1 : this->dots_to(next, rise);
+}
+
+int PPU::idle_a12() const {
+  if ((mask & 0x18) && scanline < 240) {
+    return -1;
+  }
+  return (vram_addr >> 12) & 0x01;
+}
+
+bool PPU::a12_rose() const {
+  int rise = this->a12_rise_dot();
+  return rise >= 0 && rise < cycle && cycle - rise <= 3;
+}
+
+void PPU::set_frame(Frame* f) {
+  this->frame = f;
+  this->screen_buffer = f->pixels;
+}
+
 void PPU::connect_cartridge(const std::shared_ptr<Cartridge> cartr) {
   this->cart = cartr;
 }
@@ -390,7 +482,11 @@ void PPU::clk() {
       uint8_t pixel = 0x00;
       uint8_t palette = 0x00;
 
-      if (!fg_pixel && !bg_pixel) {
+      if (skip_render) {
+        // frame is being skipped, only the flags below matter
+      }
+
+      else if (!fg_pixel && !bg_pixel) {
         pixel = 0x00;
         palette = 0x00;
       }
@@ -443,7 +539,7 @@ void PPU::clk() {
       // calculate final colour
       // index = 0x3F00 + (palette * 4) + pixel
       // visible screen area
-      if (cycle >= 1 && cycle < 257 && scanline >= 0) {
+      if (!skip_render && cycle >= 1 && cycle < 257 && scanline >= 0) {
         uint8_t final_pixel = pixel;
         uint8_t final_palette = palette;
         
@@ -458,12 +554,32 @@ void PPU::clk() {
           palette_addr = 0x3F00;
         }
         uint8_t colour_index = ppu_read(palette_addr) & 0x3F;
-        Pixel colour = palette_lut[colour_index];
-        
-        this->screen_buffer[(scanline * 256) + (cycle - 1)] = 0xFF000000 
-                                                            | (colour.r << 16)
-                                                            | (colour.g << 8)
-                                                            |  colour.b;
+        // greyscale (mask bit 0) keeps only the luma column
+        if (mask & 0x01) {
+          colour_index &= 0x30;
+        }
+        // emphasis bits (mask bits 5-7) ride along in bits 6-8
+        uint16_t index = colour_index | ((mask & 0xE0) << 1);
+
+        uint32_t value;
+        if (output_mode == OUTPUT_INDEXED) {
+          value = index;
+          this->frame->index[(scanline * 256) + (cycle - 1)] = index;
+        }
+        else {
+          value = this->palette[index];
+          this->screen_buffer[(scanline * 256) + (cycle - 1)] = value;
+        }
+
+        // fnv-1a style running hash of the line, so consumers can tell
+        // which lines changed without comparing pixels
+        if (cycle == 1) {
+          line_hash = 2166136261u;
+        }
+        line_hash = (line_hash ^ value) * 16777619u;
+        if (cycle == 256) {
+          frame->line_hash[scanline] = line_hash;
+        }
       }
 
 
@@ -781,3 +897,69 @@ inline uint8_t PPU::reverse_bits(uint8_t b) {
   b = ((b & 0xAA) >> 1) | ((b & 0x55) << 1);
   return b;
 }
+
+void PPU::save_state(StateWriter &w) const {
+  w.write(nmi);
+  w.write(frame_complete);
+  w.write(oam);
+  w.write(oam_addr);
+  w.write(nametable);
+  w.write(palette_ram);
+  w.write(vram_addr);
+  w.write(vram_addr_tmp);
+  w.write(fine_x);
+  w.write(address_latch);
+  w.write(ppu_data_buf);
+  w.write(ctrl);
+  w.write(mask);
+  w.write(status);
+  w.write(scanline);
+  w.write(cycle);
+  w.write(bg_shifter_pattern_lo);
+  w.write(bg_shifter_pattern_hi);
+  w.write(bg_shifter_attrib_lo);
+  w.write(bg_shifter_attrib_hi);
+  w.write(bg_next_tile_id);
+  w.write(bg_next_tile_attrib);
+  w.write(bg_next_tile_lsb);
+  w.write(bg_next_tile_msb);
+  w.write(scanline_sprites);
+  w.write(n_sprites);
+  w.write(sprite_shifter_lo);
+  w.write(sprite_shifter_hi);
+  w.write(possible_zerohit);
+  w.write(rendering_zerohit);
+}
+
+void PPU::load_state(StateReader &r) {
+  r.read(nmi);
+  r.read(frame_complete);
+  r.read(oam);
+  r.read(oam_addr);
+  r.read(nametable);
+  r.read(palette_ram);
+  r.read(vram_addr);
+  r.read(vram_addr_tmp);
+  r.read(fine_x);
+  r.read(address_latch);
+  r.read(ppu_data_buf);
+  r.read(ctrl);
+  r.read(mask);
+  r.read(status);
+  r.read(scanline);
+  r.read(cycle);
+  r.read(bg_shifter_pattern_lo);
+  r.read(bg_shifter_pattern_hi);
+  r.read(bg_shifter_attrib_lo);
+  r.read(bg_shifter_attrib_hi);
+  r.read(bg_next_tile_id);
+  r.read(bg_next_tile_attrib);
+  r.read(bg_next_tile_lsb);
+  r.read(bg_next_tile_msb);
+  r.read(scanline_sprites);
+  r.read(n_sprites);
+  r.read(sprite_shifter_lo);
+  r.read(sprite_shifter_hi);
+  r.read(possible_zerohit);
+  r.read(rendering_zerohit);
+}
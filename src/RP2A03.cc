@@ -15,7 +15,13 @@ void RP2A03::connect_bus(Bus* b) {
   this->apu.connect_bus(b);
 }
 
-void RP2A03::connect_ppu(std::shared_ptr<PPU> p) {
+void RP2A03::reset() {
+  this->dma_transfer = false;
+  this->dma_alignment = true;
+  this->apu.reset();
+}
+
+void RP2A03::connect_ppu(PPU* p) {
   this->ppu = p;
 }
 
@@ -63,8 +69,14 @@ void RP2A03::cpu_write(uint16_t addr, uint8_t data) {
   }
 
   if (addr == 0x4016) {
-    // when strobe goes from 1->0, latch state
+    // when strobe goes from 1->0, latch state. games strobe right before
+    // reading the pads, so that's the freshest point to ask, and asking
+    // only there means the provider sees one call per latch
     if ((controller_strobe & 0x01) && !(data & 0x01)) {
+      if (input_provider) {
+        controller[0] = input_provider(0);
+        controller[1] = input_provider(1);
+      }
       controller_state[0] = controller[0];
       controller_state[1] = controller[1];
     }
@@ -165,3 +177,28 @@ void RP2A03::clk() {
   this->apu.clk();
 }
 
+void RP2A03::save_state(StateWriter &w) const {
+  w.write(dma_transfer);
+  w.write(dma_alignment);
+  w.write(dma_page);
+  w.write(dma_addr);
+  w.write(dma_data);
+  w.write(dma_start_addr);
+  w.write(controller);
+  w.write(controller_state);
+  w.write(controller_strobe);
+  this->apu.save_state(w);
+}
+
+void RP2A03::load_state(StateReader &r) {
+  r.read(dma_transfer);
+  r.read(dma_alignment);
+  r.read(dma_page);
+  r.read(dma_addr);
+  r.read(dma_data);
+  r.read(dma_start_addr);
+  r.read(controller);
+  r.read(controller_state);
+  r.read(controller_strobe);
+  this->apu.load_state(r);
+}
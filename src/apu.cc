@@ -12,6 +12,15 @@ APU::~APU() {
 
 void APU::connect_bus(Bus* b) {
   this->bus = b;
+  this->bus->scheduler.set_handler(Scheduler::APU_FRAME, [this](uint64_t) {
+    this->clock_frame_counter();
+  });
+  this->bus->scheduler.set_handler(Scheduler::DMC_TIMER, [this](uint64_t at) {
+    this->clock_dmc(at);
+  });
+  this->bus->scheduler.set_handler(Scheduler::DMC_DMA, [this](uint64_t) {
+    this->dmc_fetch();
+  });
 }
 
 void APU::reset() {
@@ -20,9 +29,9 @@ void APU::reset() {
 
   // reset frame counter
   frame_counter_mode = FOUR_STEP;
-  frame_clock_counter = 0;
   irq_inhibit = false;
-  frame_interrupt = false;
+  set_frame_interrupt(false);
+  restart_frame_counter();
 
   // reset all channels
   for (int i = 0; i < 2; i++) {
@@ -31,6 +40,13 @@ void APU::reset() {
   triangle = triangle_channel_T();
   noise = noise_channel_T();
   dmc = DMC_channel_T();
+  set_dmc_interrupt(false);
+
+  // the dmc output unit never stops, even when silent
+  if (bus) {
+    bus->scheduler.cancel(Scheduler::DMC_DMA);
+    bus->scheduler.schedule(Scheduler::DMC_TIMER, bus->cpu_clocks + dmc_rates_ntsc[dmc.freq]);
+  }
 }
 
 void APU::cpu_write(uint16_t addr, uint8_t data) {
@@ -127,7 +143,10 @@ void APU::cpu_write(uint16_t addr, uint8_t data) {
     case 0x4010:
       dmc.irq_enable = data & 0x80;
       dmc.loop = data & 0x40;
-      dmc.freq = data & 0x7F;
+      dmc.freq = data & 0x0F;
+      if (!dmc.irq_enable) {
+        set_dmc_interrupt(false);
+      }
       break;
     case 0x4011:
       dmc.output_level = data & 0x7F;
@@ -160,12 +179,18 @@ void APU::cpu_write(uint16_t addr, uint8_t data) {
       if (!noise.enabled) {
         noise.length_counter = 0;
       }
+      // writing $4015 acknowledges the dmc interrupt
+      set_dmc_interrupt(false);
       if (!dmc.enabled) {
         dmc.bytes_left = 0;
       }
-      else if (!dmc.bytes_left) {
-        dmc.current_addr = dmc.sample_addr;
-        dmc.bytes_left = dmc.sample_length;
+      else {
+        if (!dmc.bytes_left) {
+          restart_dmc_sample();
+        }
+        if (bus) {
+          request_dmc_fetch(bus->cpu_clocks);
+        }
       }
       break;
 
@@ -174,10 +199,9 @@ void APU::cpu_write(uint16_t addr, uint8_t data) {
       frame_counter_mode = (data & 0x80) ? FIVE_STEP : FOUR_STEP;
       irq_inhibit = data & 0x40;
       if (irq_inhibit) {
-        frame_interrupt = false;
+        set_frame_interrupt(false);
       }
-      frame_clock_counter = 0;
-      frame_delay = true;
+      restart_frame_counter();
       if (frame_counter_mode == FIVE_STEP) {
         clock_quarter_frame();
         clock_half_frame();
@@ -208,9 +232,11 @@ uint8_t APU::cpu_read(uint16_t addr, bool readonly) {
     if (frame_interrupt) {
       data |= 0x40;
     }
-    // dmc interrupt would be 0x80;
+    if (dmc.interrupt) {
+      data |= 0x80;
+    }
     if (!readonly) {
-      frame_interrupt = false;
+      set_frame_interrupt(false);
     }
   }
   return data;
@@ -218,69 +244,58 @@ uint8_t APU::cpu_read(uint16_t addr, bool readonly) {
 
 void APU::clk() {
   // clock channels run at cpu speed, channels divide down from there
-  bool quarter_frame = false;
-  bool half_frame = false;
-
-  // frame counter timing
-  if (frame_counter_mode == FOUR_STEP) {
-    // 4-step: ~240hz quarter frame ~120hz half frame
-    if (frame_clock_counter == 3728) {
-      quarter_frame = true;
-    }
-    if (frame_clock_counter == 7456) {
-      quarter_frame = true;
-      half_frame = true;
-    }
-    if (frame_clock_counter == 11185) {
-      quarter_frame = true;
-    }
-    if (frame_clock_counter == 14914) {
-      quarter_frame = true;
-      half_frame = true;
-      frame_clock_counter = 0;
-      if (!irq_inhibit) {
-        frame_interrupt = true;
-      }
-    }
+  // (frame counter steps arrive through the scheduler)
+  apu_cycle = !apu_cycle;
+  if (apu_cycle) {
+    pulse[0].clock_timer();
+    pulse[1].clock_timer();
   }
-  else {
-    // 5-step: ~192hz quarter frame ~96hz half frame
-    if (frame_clock_counter == 3728) {
-      quarter_frame = true;
-    }
-    if (frame_clock_counter == 7456) {
-      quarter_frame = true;
-      half_frame = true;
-    }
-    if (frame_clock_counter == 11185) {
-      quarter_frame = true;
-    }
-    if (frame_clock_counter == 14914) {
-      quarter_frame = true;
-      half_frame = true;
-    }
-    if (frame_clock_counter == 18640) {
-      frame_clock_counter = 0;
-    }
+  triangle.clock_timer();
+  noise.clock_timer();
+}
+
+// -- FRAME COUNTER --
+
+void APU::restart_frame_counter() {
+  frame_start = bus ? bus->cpu_clocks : 0;
+  frame_step = 0;
+  schedule_frame_step();
+}
+
+void APU::schedule_frame_step() {
+  if (!bus) {
+    return;
   }
+  uint64_t at = frame_start + frame_steps[frame_counter_mode][frame_step].cycle;
+  bus->scheduler.schedule(Scheduler::APU_FRAME, at);
+}
 
-  frame_clock_counter++;
+void APU::clock_frame_counter() {
+  const frame_step_T &step = frame_steps[frame_counter_mode][frame_step];
 
-  if (quarter_frame) {
+  if (step.quarter) {
     clock_quarter_frame();
   }
-  if (half_frame) {
+  if (step.half) {
     clock_half_frame();
   }
+  if (step.irq && !irq_inhibit) {
+    set_frame_interrupt(true);
+  }
 
-  // clock timers every cpu cycle
-  if (this->frame_clock_counter % 2) {
-    pulse[0].clock_timer();
-    pulse[1].clock_timer();
+  frame_step++;
+  if (frame_step == 4) {
+    frame_step = 0;
+    frame_start += frame_period[frame_counter_mode];
+  }
+  schedule_frame_step();
+}
+
+void APU::set_frame_interrupt(bool b) {
+  frame_interrupt = b;
+  if (bus) {
+    bus->set_irq(Bus::IRQ_APU_FRAME, b);
   }
-  triangle.clock_timer();
-  noise.clock_timer();
-  dmc.clock_timer();
 }
 
 void APU::clock_quarter_frame() {
@@ -469,44 +484,89 @@ void APU::noise_channel_T::clock_length_counter() {
 // -- DMC CHANNEL --
 
 void APU::DMC_channel_T::clock_timer() {
-  if (!timer) {
-    timer = dmc_rates_ntsc[freq];
-    
-    if (!silence) {
-      if (shift_reg & 0x01) {
-        if (output_level <= 125) {
-          output_level += 2;
-        }
+  if (!silence) {
+    if (shift_reg & 0x01) {
+      if (output_level <= 125) {
+        output_level += 2;
       }
-      else {
-        if (output_level >= 2) {
-          output_level -= 2;
-        }
+    }
+    else {
+      if (output_level >= 2) {
+        output_level -= 2;
       }
     }
+  }
 
-    shift_reg >>= 1;
-    bits_left--;
+  shift_reg >>= 1;
+  bits_left--;
 
-    if (!bits_left) {
-      bits_left = 8;
-      if (sample_buf_empty) {
-        silence = true;
-      }
-      else {
-        silence = false;
-        shift_reg = sample_buf;
-        sample_buf_empty = true;
-      }
+  // end of output cycle, start a new one from the sample buffer
+  if (!bits_left) {
+    bits_left = 8;
+    if (sample_buf_empty) {
+      silence = true;
+    }
+    else {
+      silence = false;
+      shift_reg = sample_buf;
+      sample_buf_empty = true;
     }
   }
-  else {
-    timer--;
+}
+
+void APU::clock_dmc(uint64_t at) {
+  dmc.clock_timer();
+  // the output unit may have just emptied the buffer
+  request_dmc_fetch(at);
+  bus->scheduler.schedule(Scheduler::DMC_TIMER, at + dmc_rates_ntsc[dmc.freq]);
+}
+
+void APU::request_dmc_fetch(uint64_t at) {
+  if (dmc.sample_buf_empty
+      && dmc.bytes_left > 0
+      && !bus->scheduler.pending(Scheduler::DMC_DMA)) {
+    bus->scheduler.schedule(Scheduler::DMC_DMA, at);
+  }
+}
+
+void APU::dmc_fetch() {
+  // state may have changed ($4015 write) since the request was made
+  if (!dmc.sample_buf_empty || !dmc.bytes_left) {
+    return;
   }
 
-  // memory reader goes here
-  // dmc simplified for now
-  // TODO:
+  // the cpu is halted while the byte is read: 4 cycles, or 2 when it
+  // lands in the middle of an oam dma that is already halting it
+  // https://www.nesdev.org/wiki/DMA#DMC_DMA
+  bus->stall_cpu(bus->rp.dma_transfer ? 2 : 4);
+
+  dmc.sample_buf = bus->cpu_read(dmc.current_addr, false);
+  dmc.sample_buf_empty = false;
+
+  // address wraps around to $8000, not $0000
+  dmc.current_addr = (dmc.current_addr == 0xFFFF) ? 0x8000 : dmc.current_addr + 1;
+  dmc.bytes_left--;
+
+  if (!dmc.bytes_left) {
+    if (dmc.loop) {
+      restart_dmc_sample();
+    }
+    else if (dmc.irq_enable) {
+      set_dmc_interrupt(true);
+    }
+  }
+}
+
+void APU::restart_dmc_sample() {
+  dmc.current_addr = dmc.sample_addr;
+  dmc.bytes_left = dmc.sample_length;
+}
+
+void APU::set_dmc_interrupt(bool b) {
+  dmc.interrupt = b;
+  if (bus) {
+    bus->set_irq(Bus::IRQ_APU_DMC, b);
+  }
 }
 
 
@@ -514,14 +574,24 @@ void APU::DMC_channel_T::clock_timer() {
 
 void APU::init_mixer_tables() {
   // pulse mixer
-  for (int i = 0; i < 31; i++) {
+  pulse_table[0] = 0.0f;
+  for (int i = 1; i < 31; i++) {
     pulse_table[i] = 95.52f / (8128.0f/i + 100.0f);
   }
 
   // TND mixer (triangle noise dmc)
-  for (int i = 0; i < 203; i++) {
+  tnd_table[0] = 0.0f;
+  for (int i = 1; i < 203; i++) {
     tnd_table[i] = 163.67f / (24329.0f/i + 100.0f);
   }
+
+  // q15 copies for the fixed point path, both stay below 1.0 on their own
+  for (int i = 0; i < 31; i++) {
+    pulse_table_q15[i] = (int16_t) lroundf(pulse_table[i] * 32768.0f);
+  }
+  for (int i = 0; i < 203; i++) {
+    tnd_table_q15[i] = (int16_t) lroundf(tnd_table[i] * 32768.0f);
+  }
 }
 
 float APU::get_audio_sample() {
@@ -536,3 +606,121 @@ float APU::get_audio_sample() {
 
   return pulse_mix + tnd_mix;
 }
+
+int32_t APU::get_audio_sample_q15() {
+  uint8_t pulse_out = pulse[0].sample + pulse[1].sample;
+  uint8_t tnd_out = 3*triangle.sample + 2*noise.sample + dmc.output_level;
+  return (int32_t) pulse_table_q15[pulse_out] + tnd_table_q15[tnd_out];
+}
+
+void APU::get_channel_samples(float out[N_CHANNELS]) {
+  out[0] = pulse_table[pulse[0].sample];
+  out[1] = pulse_table[pulse[1].sample];
+  out[2] = tnd_table[3*triangle.sample];
+  out[3] = tnd_table[2*noise.sample];
+  out[4] = tnd_table[dmc.output_level];
+}
+
+// the channel structs have padding, so they go out field by field and
+// states (and their hashes) only ever hold field bytes
+template <typename S, typename Pulse>
+static void pulse_state(S &s, Pulse &p) {
+  s.field(p.enabled);
+  s.field(p.duty_cycle);
+  s.field(p.length_counter_halt);
+  s.field(p.constant_volume);
+  s.field(p.volume_envelope);
+  s.field(p.sweep_enabled);
+  s.field(p.sweep_divider_period);
+  s.field(p.sweep_negate);
+  s.field(p.sweep_shift_count);
+  s.field(p.sweep_divider);
+  s.field(p.sweep_reload);
+  s.field(p.timer);
+  s.field(p.timer_period);
+  s.field(p.length_counter);
+  s.field(p.sequencer_pos);
+  s.field(p.envelope_divider);
+  s.field(p.envelope_decay);
+  s.field(p.envelope_start);
+  s.field(p.sample);
+}
+
+template <typename S, typename Triangle>
+static void triangle_state(S &s, Triangle &t) {
+  s.field(t.enabled);
+  s.field(t.ctrl);
+  s.field(t.linear_counter_reload);
+  s.field(t.timer);
+  s.field(t.timer_period);
+  s.field(t.length_counter);
+  s.field(t.linear_counter);
+  s.field(t.set_linear_counter_reload);
+  s.field(t.sequencer_pos);
+  s.field(t.sample);
+}
+
+template <typename S, typename Noise>
+static void noise_state(S &s, Noise &n) {
+  s.field(n.enabled);
+  s.field(n.length_counter_halt);
+  s.field(n.const_volume);
+  s.field(n.volume_envelope);
+  s.field(n.mode);
+  s.field(n.period);
+  s.field(n.length_counter);
+  s.field(n.shift_reg);
+  s.field(n.timer);
+  s.field(n.envelope_divider);
+  s.field(n.envelope_decay);
+  s.field(n.envelope_start);
+  s.field(n.sample);
+}
+
+template <typename S, typename DMC>
+static void dmc_state(S &s, DMC &d) {
+  s.field(d.enabled);
+  s.field(d.irq_enable);
+  s.field(d.loop);
+  s.field(d.freq);
+  s.field(d.output_level);
+  s.field(d.sample_addr);
+  s.field(d.sample_length);
+  s.field(d.current_addr);
+  s.field(d.bytes_left);
+  s.field(d.sample_buf);
+  s.field(d.sample_buf_empty);
+  s.field(d.shift_reg);
+  s.field(d.bits_left);
+  s.field(d.silence);
+  s.field(d.interrupt);
+}
+
+void APU::save_state(StateWriter &w) const {
+  pulse_state(w, pulse[0]);
+  pulse_state(w, pulse[1]);
+  triangle_state(w, triangle);
+  noise_state(w, noise);
+  dmc_state(w, dmc);
+  w.write(frame_counter_mode);
+  w.write(irq_inhibit);
+  w.write(frame_interrupt);
+  w.write(frame_start);
+  w.write(frame_step);
+  w.write(apu_cycle);
+}
+
+// pending frame sequencer and dmc events are restored with the scheduler
+void APU::load_state(StateReader &r) {
+  pulse_state(r, pulse[0]);
+  pulse_state(r, pulse[1]);
+  triangle_state(r, triangle);
+  noise_state(r, noise);
+  dmc_state(r, dmc);
+  r.read(frame_counter_mode);
+  r.read(irq_inhibit);
+  r.read(frame_interrupt);
+  r.read(frame_start);
+  r.read(frame_step);
+  r.read(apu_cycle);
+}
@@ -0,0 +1,171 @@
+#include "archive.hh"
+#include <cctype>
+#include <cstring>
+
+#include "crc32.hh"
+#include "inflate.hh"
+
+static uint32_t le16(const uint8_t* p) {
+  return p[0] | p[1] << 8;
+}
+
+static uint32_t le32(const uint8_t* p) {
+  return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t) p[3] << 24;
+}
+
+static bool ends_with_nes(const std::string &name) {
+  if (name.size() < 4) {
+    return false;
+  }
+  std::string ext = name.substr(name.size() - 4);
+  for (char &c : ext) {
+    c = tolower((unsigned char) c);
+  }
+  return ext == ".nes";
+}
+
+Archive::Type Archive::detect(const uint8_t* data, size_t size) {
+  if (size >= 18 && data[0] == 0x1F && data[1] == 0x8B) {
+    return GZIP;
+  }
+  if (size >= 22 && le32(data) == 0x04034B50) {
+    return ZIP;
+  }
+  return NONE;
+}
+
+bool Archive::extract_rom(const uint8_t* data, size_t size, std::vector<uint8_t> &out, std::string* name) {
+  switch (detect(data, size)) {
+    case GZIP: return gunzip(data, size, out, name);
+    case ZIP: return unzip(data, size, out, name);
+    default: return false;
+  }
+}
+
+bool Archive::gunzip(const uint8_t* data, size_t size, std::vector<uint8_t> &out, std::string* name) {
+  enum {
+    FHCRC = 1 << 1,
+    FEXTRA = 1 << 2,
+    FNAME = 1 << 3,
+    FCOMMENT = 1 << 4
+  };
+  // only deflate exists
+  if (data[2] != 8) {
+    return false;
+  }
+  uint8_t flags = data[3];
+  size_t pos = 10;
+  // the trailer is the crc and the size mod 2^32 of the first member
+  size_t end = size - 8;
+
+  if (flags & FEXTRA) {
+    if (pos + 2 > end) {
+      return false;
+    }
+    pos += 2 + le16(data + pos);
+  }
+  if (flags & FNAME) {
+    size_t start = pos;
+    while (pos < end && data[pos]) {
+      pos++;
+    }
+    if (name) {
+      name->assign((const char*) data + start, pos - start);
+    }
+    pos++;
+  }
+  if (flags & FCOMMENT) {
+    while (pos < end && data[pos]) {
+      pos++;
+    }
+    pos++;
+  }
+  if (flags & FHCRC) {
+    pos += 2;
+  }
+  if (pos > end) {
+    return false;
+  }
+
+  uint32_t crc = le32(data + end);
+  size_t out_size = le32(data + end + 4);
+  if (out_size > MAX_SIZE) {
+    return false;
+  }
+  out.resize(out_size);
+  size_t got;
+  if (!Inflate::inflate(data + pos, end - pos, out.data(), out.size(), got) || got != out_size) {
+    return false;
+  }
+  return Crc32::update(0, out.data(), out.size()) == crc;
+}
+
+bool Archive::unzip(const uint8_t* data, size_t size, std::vector<uint8_t> &out, std::string* name) {
+  // end of central directory, it is followed by a comment of up to 64kb
+  size_t eocd = size - 22;
+  size_t lowest = size > 22 + 0xFFFF ? size - 22 - 0xFFFF : 0;
+  while (le32(data + eocd) != 0x06054B50) {
+    if (eocd == lowest) {
+      return false;
+    }
+    eocd--;
+  }
+  size_t entries = le16(data + eocd + 10);
+  size_t pos = le32(data + eocd + 16);
+
+  for (size_t i = 0; i < entries; i++) {
+    if (pos + 46 > size || le32(data + pos) != 0x02014B50) {
+      return false;
+    }
+    const uint8_t* entry = data + pos;
+    size_t name_len = le16(entry + 28);
+    size_t next = pos + 46 + name_len + le16(entry + 30) + le16(entry + 32);
+    if (pos + 46 + name_len > size) {
+      return false;
+    }
+    std::string entry_name((const char*) entry + 46, name_len);
+    if (!ends_with_nes(entry_name)) {
+      pos = next;
+      continue;
+    }
+
+    uint32_t flags = le16(entry + 8);
+    uint32_t method = le16(entry + 10);
+    uint32_t crc = le32(entry + 16);
+    size_t packed_size = le32(entry + 20);
+    size_t out_size = le32(entry + 24);
+    size_t local = le32(entry + 42);
+    // encrypted entries can't be read
+    if ((flags & 1) || (method != 0 && method != 8) || out_size > MAX_SIZE) {
+      return false;
+    }
+
+    // the local header repeats the name but may have its own extra field
+    if (local + 30 > size || le32(data + local) != 0x04034B50) {
+      return false;
+    }
+    size_t start = local + 30 + le16(data + local + 26) + le16(data + local + 28);
+    if (start > size || packed_size > size - start) {
+      return false;
+    }
+
+    out.resize(out_size);
+    if (method == 0) {
+      if (packed_size != out_size) {
+        return false;
+      }
+      memcpy(out.data(), data + start, out_size);
+    }
+    else {
+      size_t got;
+      if (!Inflate::inflate(data + start, packed_size, out.data(), out.size(), got) || got != out_size) {
+        return false;
+      }
+    }
+    if (name) {
+      *name = entry_name;
+    }
+    return Crc32::update(0, out.data(), out.size()) == crc;
+  }
+  return false;
+}
@@ -0,0 +1,163 @@
+#include "audio_capture.hh"
+#include "audio_filter.hh"
+#include <chrono>
+#include <cstring>
+
+static const char* stream_names[AudioCapture::N_STREAMS] = {
+  "mix", "pulse1", "pulse2", "triangle", "noise", "dmc"
+};
+
+// large stdio buffers so the writer issues few, big writes
+static const size_t FILE_BUF_SIZE = 1 << 20;
+
+AudioCapture::AudioCapture() {
+
+}
+
+AudioCapture::~AudioCapture() {
+  this->stop();
+}
+
+bool AudioCapture::start(const std::string &prefix, int rate, bool with_stems) {
+  if (active) {
+    return false;
+  }
+  this->sample_rate = rate;
+  this->stems = with_stems;
+
+  int n = stems ? N_STREAMS : 1;
+  for (int i = 0; i < n; i++) {
+    std::string path = prefix + "." + stream_names[i] + ".wav";
+    files[i] = fopen(path.c_str(), "wb");
+    if (!files[i]) {
+      for (int j = 0; j < i; j++) {
+        fclose(files[j]);
+        files[j] = nullptr;
+      }
+      return false;
+    }
+    setvbuf(files[i], nullptr, _IOFBF, FILE_BUF_SIZE);
+    // sizes are patched in stop()
+    write_header(files[i], 0);
+    data_bytes[i] = 0;
+    queues[i] = std::make_unique<BlockQueue>();
+  }
+
+  quit = false;
+  dropped = 0;
+  capture_ns = 0;
+  mix_samples = 0;
+  active = true;
+  writer = std::thread(&AudioCapture::writer_loop, this);
+  return true;
+}
+
+void AudioCapture::stop() {
+  if (!active) {
+    return;
+  }
+  quit = true;
+  writer.join();
+  active = false;
+
+  for (int i = 0; i < N_STREAMS; i++) {
+    if (files[i]) {
+      fseek(files[i], 0, SEEK_SET);
+      write_header(files[i], data_bytes[i]);
+      fclose(files[i]);
+      files[i] = nullptr;
+    }
+    queues[i].reset();
+  }
+}
+
+void AudioCapture::push_block(Stream stream, const float* samples, int n) {
+  if (!active || !queues[stream]) {
+    return;
+  }
+  // what was produced, dropped or not
+  if (stream == MIX) {
+    mix_samples += n;
+  }
+  Block* block = queues[stream]->write_slot();
+  if (!block) {
+    dropped++;
+    return;
+  }
+  if (n > BLOCK_SIZE) {
+    n = BLOCK_SIZE;
+  }
+  block->len = n;
+  memcpy(block->samples, samples, n * sizeof(float));
+  queues[stream]->push();
+}
+
+double AudioCapture::capture_load() const {
+  uint64_t samples = mix_samples;
+  if (samples == 0) {
+    return 0.0;
+  }
+  return capture_ns / (samples * 1e9 / sample_rate);
+}
+
+void AudioCapture::writer_loop() {
+  while (!quit) {
+    if (!drain()) {
+      // nothing queued, a frame's worth of audio takes ~16ms to show up
+      std::this_thread::sleep_for(std::chrono::milliseconds(4));
+    }
+  }
+  // flush whatever was queued before stop()
+  drain();
+}
+
+bool AudioCapture::drain() {
+  bool any = false;
+  int16_t pcm[BLOCK_SIZE];
+
+  for (int i = 0; i < N_STREAMS; i++) {
+    if (!queues[i]) {
+      continue;
+    }
+    Block* block;
+    while ((block = queues[i]->read_slot())) {
+      // the same codes the ring gets
+      for (int s = 0; s < block->len; s++) {
+        pcm[s] = AudioFilter::to_int16(block->samples[s]);
+      }
+      fwrite(pcm, sizeof(int16_t), block->len, files[i]);
+      data_bytes[i] += block->len * sizeof(int16_t);
+      queues[i]->pop();
+      any = true;
+    }
+  }
+  return any;
+}
+
+// https://docs.fileformat.com/audio/wav/
+void AudioCapture::write_header(FILE* f, uint32_t bytes) {
+  auto u32 = [&](uint32_t v) {
+    uint8_t b[4] = {(uint8_t) v, (uint8_t)(v >> 8), (uint8_t)(v >> 16), (uint8_t)(v >> 24)};
+    fwrite(b, 1, 4, f);
+  };
+  auto u16 = [&](uint16_t v) {
+    uint8_t b[2] = {(uint8_t) v, (uint8_t)(v >> 8)};
+    fwrite(b, 1, 2, f);
+  };
+
+  fwrite("RIFF", 1, 4, f);
+  u32(36 + bytes);
+  fwrite("WAVE", 1, 4, f);
+
+  fwrite("fmt ", 1, 4, f);
+  u32(16);                // chunk size
+  u16(1);                 // pcm
+  u16(1);                 // mono
+  u32(sample_rate);
+  u32(sample_rate * 2);   // byte rate
+  u16(2);                 // block align
+  u16(16);                // bits per sample
+
+  fwrite("data", 1, 4, f);
+  u32(bytes);
+}
@@ -0,0 +1,149 @@
+#include "audio_filter.hh"
+#include <cmath>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+AudioFilter::AudioFilter(float sample_rate) {
+  this->set_sample_rate(sample_rate);
+}
+
+AudioFilter::~AudioFilter() {
+
+}
+
+void AudioFilter::set_sample_rate(float sample_rate) {
+  const float dt = 1.0f / sample_rate;
+  const float pi = 3.14159265f;
+
+  // high pass: y = k * (y[n-1] + x[n] - x[n-1])
+  const float hp_freq[2] = {90.0f, 440.0f};
+  for (int i = 0; i < 2; i++) {
+    float rc = 1.0f / (2.0f * pi * hp_freq[i]);
+    float k = rc / (rc + dt);
+    b0[i] = k;
+    b1[i] = -k;
+    a1[i] = k;
+  }
+
+  // low pass: y = y[n-1] + k * (x[n] - y[n-1])
+  float rc = 1.0f / (2.0f * pi * 14000.0f);
+  float k = dt / (rc + dt);
+  b0[2] = k;
+  b1[2] = 0.0f;
+  a1[2] = 1.0f - k;
+
+  for (int i = 0; i < STAGES; i++) {
+    b0_q30[i] = (int32_t) lroundf(b0[i] * (1 << 30));
+    b1_q30[i] = (int32_t) lroundf(b1[i] * (1 << 30));
+    a1_q30[i] = (int32_t) lroundf(a1[i] * (1 << 30));
+  }
+
+  this->reset();
+}
+
+void AudioFilter::reset() {
+  for (int i = 0; i < 4; i++) {
+    x_prev[i] = 0.0f;
+    y_prev[i] = 0.0f;
+  }
+  for (int i = 0; i < STAGES; i++) {
+    x_prev_q23[i] = 0;
+    y_prev_q23[i] = 0;
+  }
+}
+
+inline float AudioFilter::step(int stage, float x) {
+  float y = b0[stage]*x + b1[stage]*x_prev[stage] + a1[stage]*y_prev[stage];
+  x_prev[stage] = x;
+  y_prev[stage] = y;
+  return y;
+}
+
+void AudioFilter::process(float* buf, int n) {
+  #ifdef __SSE2__
+  this->process_sse2(buf, n);
+  #else
+  this->process_scalar(buf, n);
+  #endif
+}
+
+void AudioFilter::process_scalar(float* buf, int n) {
+  for (int i = 0; i < n; i++) {
+    float v = buf[i];
+    for (int s = 0; s < STAGES; s++) {
+      v = step(s, v);
+    }
+    buf[i] = v;
+  }
+}
+
+void AudioFilter::process_q15(int32_t* buf, int n) {
+  for (int i = 0; i < n; i++) {
+    // q15 -> q23
+    int32_t v = buf[i] * 256;
+    for (int s = 0; s < STAGES; s++) {
+      int64_t acc = (int64_t) b0_q30[s] * v
+                  + (int64_t) b1_q30[s] * x_prev_q23[s]
+                  + (int64_t) a1_q30[s] * y_prev_q23[s];
+      int32_t y = (int32_t) ((acc + (1 << 29)) >> 30);
+      x_prev_q23[s] = v;
+      y_prev_q23[s] = y;
+      v = y;
+    }
+    // q23 -> q15
+    buf[i] = (v + 128) >> 8;
+  }
+}
+
+#ifdef __SSE2__
+void AudioFilter::process_sse2(float* buf, int n) {
+  // need enough samples to fill the pipeline
+  if (n < STAGES) {
+    this->process_scalar(buf, n);
+    return;
+  }
+
+  // prologue: stage s sees sample 0 on step s
+  // after this stage 0 wants sample 2, stage 1 sample 1, stage 2 sample 0
+  float in1 = step(0, buf[0]);
+  float in2 = step(1, in1);
+  in1 = step(0, buf[1]);
+
+  __m128 vb0 = _mm_loadu_ps(b0);
+  __m128 vb1 = _mm_loadu_ps(b1);
+  __m128 va1 = _mm_loadu_ps(a1);
+  __m128 vxp = _mm_loadu_ps(x_prev);
+  __m128 vyp = _mm_loadu_ps(y_prev);
+
+  // lane s holds the input of stage s
+  __m128 vin = _mm_setr_ps(buf[2], in1, in2, 0.0f);
+
+  for (int t = 2; t < n; t++) {
+    __m128 vy = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vb0, vin),
+                                      _mm_mul_ps(vb1, vxp)),
+                           _mm_mul_ps(va1, vyp));
+    vxp = vin;
+    vyp = vy;
+
+    // last stage finished sample t-2
+    buf[t - 2] = _mm_cvtss_f32(_mm_shuffle_ps(vy, vy, _MM_SHUFFLE(2, 2, 2, 2)));
+
+    // every stage output moves one lane up, next sample enters lane 0
+    vin = _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(vy), 4));
+    if (t + 1 < n) {
+      vin = _mm_move_ss(vin, _mm_set_ss(buf[t + 1]));
+    }
+  }
+
+  _mm_storeu_ps(x_prev, vxp);
+  _mm_storeu_ps(y_prev, vyp);
+
+  // epilogue: drain samples n-2 and n-1 out of stages 1 and 2
+  float lanes[4];
+  _mm_storeu_ps(lanes, vin);
+  buf[n - 2] = step(2, lanes[2]);
+  buf[n - 1] = step(2, step(1, lanes[1]));
+}
+#endif
@@ -1,5 +1,7 @@
 #include "bus.hh"
 #include "RP2A03.hh"
+#include "hash64.hh"
+#include <chrono>
 #include <memory>
 
 Bus::Bus() {
@@ -9,10 +11,12 @@ Bus::Bus() {
   this->cpu.connect_bus(this);
 
   // RP2A03
-  this->rp = std::make_shared<RP2A03>();
-  this->rp->connect_bus(this);
-  // i have no clue
-  this->rp->connect_ppu(std::shared_ptr<PPU>(&this->ppu, [](PPU*){}));
+  this->rp.connect_bus(this);
+  this->rp.connect_ppu(&this->ppu);
+
+  this->scheduler.set_handler(Scheduler::MAPPER_A12, [this](uint64_t) {
+    this->a12_event();
+  });
 } 
 
 Bus::~Bus() {
@@ -24,12 +28,9 @@ void Bus::cpu_write(uint16_t addr, uint8_t data) {
   if (addr == 0x2001) {
   printf("PPUMASK write:  PC=%04X, A=%02X at SL=%d\n", cpu.pc - 1, cpu.a, ppu.scanline);
 }
-  // static bool first_frame = true;
-  static int write_count = 0;
-  
-  if (addr == 0x2001 && write_count < 100) {
+  if (addr == 0x2001 && debug_mask_writes < 100) {
     printf("[%d] PPUMASK:   %02X at PC=%04X, SL=%d, Cycle=%d\n", 
-           write_count++, data, cpu.pc, ppu.scanline, ppu.cycle);
+           debug_mask_writes++, data, cpu.pc, ppu.scanline, ppu.cycle);
   }
   #endif
 
@@ -42,10 +43,23 @@ void Bus::cpu_write(uint16_t addr, uint8_t data) {
     this->cpu_mem[addr & 0x07FF] = data;
   }
   else if (addr >= 0x2000 && addr <= 0x3FFF) {
+    int a12 = watch_a12 ? ppu.idle_a12() : -1;
     ppu.cpu_write(addr & 0x0007, data);
+    if (watch_a12) {
+      // ctrl and mask decide when a12 rises
+      if ((addr & 0x0006) == 0) {
+        this->schedule_a12();
+      }
+      this->idle_a12_event(a12);
+    }
   }
   else if (addr >= 0x4000 && addr <= 0x4017) {
-    rp->cpu_write(addr, data);
+    rp.cpu_write(addr, data);
+  }
+
+  // a mapper register write may have acknowledged the mapper's irq
+  if (watch_a12 && addr >= 0x8000) {
+    this->set_irq(IRQ_MAPPER, cart->mapper->irq_asserted());
   }
 }
 
@@ -65,12 +79,16 @@ uint8_t Bus::cpu_read(uint16_t addr, bool readonly) {
 
   // 3. ppu registers (mirrored)
   else if (addr >= 0x2000 && addr <= 0x3FFF) {
+    int a12 = watch_a12 && !readonly ? ppu.idle_a12() : -1;
     data = ppu.cpu_read(addr & 0x0007, readonly);
+    if (a12 >= 0) {
+      this->idle_a12_event(a12);
+    }
   }
 
   // 4. apu i/o registers
   else if (addr >= 0x4000 && addr <= 0x4017) {
-    data = rp->cpu_read(addr, readonly);
+    data = rp.cpu_read(addr, readonly);
   }
 
   #ifdef DEBUG
@@ -85,18 +103,67 @@ uint8_t Bus::cpu_read(uint16_t addr, bool readonly) {
 void Bus::insert_cartridge(const std::shared_ptr<Cartridge>& cartr) {
   this->cart = cartr;
   this->ppu.connect_cartridge(cartr);
+  watch_a12 = cartr->mapper && (cartr->capabilities & MapperRegistry::IRQ);
+  this->schedule_a12();
 }
 
 void Bus::reset() {
+  this->rp.reset();
   this->cpu.reset();
   this->sys_clocks = 0;
 }
+
+void Bus::stall_cpu(uint8_t cycles) {
+  cpu_stall += cycles;
+}
+
+void Bus::set_irq(IRQ_SOURCE source, bool asserted) {
+  if (asserted) {
+    irq_lines |= source;
+  }
+  else {
+    irq_lines &= ~source;
+  }
+}
+
+// called from within clk (or before the first one), where the ppu has run
+// this clock's dot and the cpu cycle isn't counted yet: the dot d dots
+// from now runs d + 1 ppu clocks later, and the scheduler sees it at the
+// next cpu cycle after that
+void Bus::schedule_a12() {
+  int32_t dots = watch_a12 ? ppu.dots_to_a12_rise() : -1;
+  if (dots < 0) {
+    scheduler.cancel(Scheduler::MAPPER_A12);
+    return;
+  }
+  scheduler.schedule(Scheduler::MAPPER_A12, cpu_clocks + (dots + 3) / 3);
+}
+
+void Bus::a12_event() {
+  // either a12 rose, or 8x16 sprites were just evaluated and the rise on
+  // this line is known now
+  if (ppu.a12_rose()) {
+    cart->mapper->clock_scanline();
+    this->set_irq(IRQ_MAPPER, cart->mapper->irq_asserted());
+  }
+  this->schedule_a12();
+}
+
+// a12 was `before` ahead of a ppu register access outside rendering.
+// the access moved v, a rise clocks the counter like one from a fetch
+void Bus::idle_a12_event(int before) {
+  if (before == 0 && ppu.idle_a12() == 1) {
+    cart->mapper->clock_scanline();
+    this->set_irq(IRQ_MAPPER, cart->mapper->irq_asserted());
+  }
+}
+
 void Bus::clk() {
   // ppu runs 3x faster than the cpu
   ppu.clk();
 
   if (ppu.nmi) {
-    if (!rp->dma_transfer && cpu.inst_cycles == 0) {
+    if (!rp.dma_transfer && cpu.inst_cycles == 0) {
       #ifdef DEBUG
       printf("NMI serviced at PC=0x%04X, SL=%d\n", cpu.pc, ppu.scanline);
       #endif
@@ -105,47 +172,222 @@ void Bus::clk() {
     }
     #ifdef DEBUG
     else {
-      static int nmi_wait_count = 0;
-      if (nmi_wait_count++ % 1000 == 0) {
+      if (debug_nmi_waits++ % 1000 == 0) {
         printf("NMI waiting: DMA=%d, inst_cycles=%d\n", 
-             rp->dma_transfer, cpu.inst_cycles);
+             rp.dma_transfer, cpu.inst_cycles);
       }
     }
     #endif
   }
+  // irq is only taken between instructions and when the i flag is clear
+  // (cpu.irq checks the flag)
+  else if (irq_lines && !rp.dma_transfer && cpu.inst_cycles == 0) {
+    cpu.irq();
+  }
 
   // every 3 ppu cycles
   if (!(sys_clocks % 3)) {
-    rp->clk();
+    scheduler.run(cpu_clocks);
+    rp.clk();
     // check if dma hijacking bus
-    if (rp->dma_transfer) {
+    if (rp.dma_transfer) {
       // suspend cpu if dma
     }
+    else if (cpu_stall) {
+      // dmc dma stole this cycle
+      cpu_stall--;
+    }
     else {
       // normal
       cpu.clk();
     }
+    cpu_clocks++;
   }
   sys_clocks++;
 }
 
-void Bus::push_audio_sample(float sample) {
-  audio_buf[audio_write_pos] = sample;
-  audio_write_pos = (audio_write_pos + 1) % AUDIO_BUF_SIZE;
+void Bus::run_frame() {
+  while (!ppu.frame_complete) {
+    clk();
+    if (sys_clocks % AUDIO_RESAMPLE_PERIOD == 0) {
+      sample_audio();
+    }
+  }
+  ppu.frame_complete = false;
+  frame_count++;
+  flush_audio_block();
+  if (hash_frames) {
+    hash_state(frame_hash);
+  }
+}
+
+// bumped whenever the layout of any component's state changes
+static const uint32_t STATE_MAGIC = 0x5453454E; // "NEST"
+static const uint32_t STATE_VERSION = 3;
+
+void Bus::save_state(StateWriter &w) const {
+  w.write(STATE_MAGIC);
+  w.write(STATE_VERSION);
+  w.write(cpu_mem);
+  w.write(sys_clocks);
+  w.write(cpu_clocks);
+  w.write(frame_count);
+  w.write(irq_lines);
+  w.write(cpu_stall);
+  cpu.save_state(w);
+  ppu.save_state(w);
+  rp.save_state(w);
+  scheduler.save_state(w);
+  cart->save_state(w);
+}
+
+bool Bus::load_state(StateReader &r) {
+  uint32_t magic = 0;
+  uint32_t version = 0;
+  r.read(magic);
+  r.read(version);
+  if (!r.ok || magic != STATE_MAGIC || version != STATE_VERSION) {
+    return false;
+  }
+  r.read(cpu_mem);
+  r.read(sys_clocks);
+  r.read(cpu_clocks);
+  r.read(frame_count);
+  r.read(irq_lines);
+  r.read(cpu_stall);
+  cpu.load_state(r);
+  ppu.load_state(r);
+  rp.load_state(r);
+  scheduler.load_state(r);
+  cart->load_state(r);
+  return r.ok;
+}
+
+const char* Bus::component_name(int component) {
+  static const char* names[N_STATE_COMPONENTS] = {"cpu", "ram", "ppu", "apu", "mapper", "system"};
+  return component >= 0 && component < N_STATE_COMPONENTS ? names[component] : "?";
 }
 
-float Bus::pop_audio_sample() {
-  if (audio_read_pos == audio_write_pos) {
-    return 0.0f;
+// same bytes as the save state, split up by component
+void Bus::hash_state(uint64_t hashes[N_STATE_COMPONENTS]) {
+  StateWriter &w = hash_scratch;
+
+  w.data.clear();
+  cpu.save_state(w);
+  hashes[STATE_CPU] = Hash64::hash(w.data.data(), w.data.size());
+
+  hashes[STATE_RAM] = Hash64::hash(cpu_mem.data(), cpu_mem.size());
+
+  w.data.clear();
+  ppu.save_state(w);
+  hashes[STATE_PPU] = Hash64::hash(w.data.data(), w.data.size());
+
+  // the 2a03 side: apu, oam dma and controller ports
+  w.data.clear();
+  rp.save_state(w);
+  hashes[STATE_APU] = Hash64::hash(w.data.data(), w.data.size());
+
+  w.data.clear();
+  cart->save_state(w);
+  hashes[STATE_MAPPER] = Hash64::hash(w.data.data(), w.data.size());
+
+  w.data.clear();
+  w.write(sys_clocks);
+  w.write(cpu_clocks);
+  w.write(frame_count);
+  w.write(irq_lines);
+  w.write(cpu_stall);
+  scheduler.save_state(w);
+  hashes[STATE_SYSTEM] = Hash64::hash(w.data.data(), w.data.size());
+}
+
+void Bus::push_audio_sample(int16_t sample) {
+  int pos = audio_write_pos.load(std::memory_order_relaxed);
+  int next = (pos + 1) % AUDIO_BUF_SIZE;
+  // full, drop rather than overwrite what the callback has not played
+  if (next == audio_read_pos.load(std::memory_order_acquire)) {
+    return;
+  }
+  audio_buf[pos] = sample;
+  audio_write_pos.store(next, std::memory_order_release);
+}
+
+int16_t Bus::pop_audio_sample() {
+  int pos = audio_read_pos.load(std::memory_order_relaxed);
+  if (pos == audio_write_pos.load(std::memory_order_acquire)) {
+    return 0;
   }
-  float sample = audio_buf[audio_read_pos];
-  audio_read_pos = (audio_read_pos + 1) % AUDIO_BUF_SIZE;
+  int16_t sample = audio_buf[pos];
+  audio_read_pos.store((pos + 1) % AUDIO_BUF_SIZE, std::memory_order_release);
   return sample;
 }
 
 int Bus::get_audio_buf_size() {
-  if (audio_write_pos >= audio_read_pos) {
-    return audio_write_pos - audio_read_pos;
+  int write_pos = audio_write_pos.load(std::memory_order_acquire);
+  int read_pos = audio_read_pos.load(std::memory_order_acquire);
+  if (write_pos >= read_pos) {
+    return write_pos - read_pos;
+  }
+  return AUDIO_BUF_SIZE - read_pos + write_pos;
+}
+
+void Bus::sample_audio() {
+  if (audio_block_len == AUDIO_BLOCK_SIZE) {
+    flush_audio_block();
+  }
+
+  if (audio_capture && audio_capture->stems_enabled()) {
+    auto start = std::chrono::steady_clock::now();
+    float stems[APU::N_CHANNELS];
+    rp.apu.get_channel_samples(stems);
+    for (int c = 0; c < APU::N_CHANNELS; c++) {
+      stem_block[c][audio_block_len] = stems[c];
+    }
+    capture_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - start).count();
+  }
+  if (audio_fixed_point) {
+    audio_block_q15[audio_block_len++] = rp.apu.get_audio_sample_q15();
+  }
+  else {
+    audio_block[audio_block_len++] = rp.apu.get_audio_sample();
+  }
+}
+
+void Bus::flush_audio_block() {
+  if (audio_fixed_point) {
+    audio_filter.process_q15(audio_block_q15, audio_block_len);
+    for (int i = 0; i < audio_block_len && audio_output; i++) {
+      push_audio_sample(AudioFilter::to_int16_q15(audio_block_q15[i]));
+    }
+  }
+  else {
+    audio_filter.process(audio_block, audio_block_len);
+    for (int i = 0; i < audio_block_len && audio_output; i++) {
+      push_audio_sample(AudioFilter::to_int16(audio_block[i]));
+    }
+  }
+
+  if (audio_capture) {
+    auto start = std::chrono::steady_clock::now();
+    // capture always takes floats
+    if (audio_fixed_point) {
+      for (int i = 0; i < audio_block_len; i++) {
+        audio_block[i] = audio_block_q15[i] / 32768.0f;
+      }
+    }
+    audio_capture->push_block(AudioCapture::MIX, audio_block, audio_block_len);
+    if (audio_capture->stems_enabled()) {
+      for (int c = 0; c < APU::N_CHANNELS; c++) {
+        stem_filter[c].process(stem_block[c], audio_block_len);
+        audio_capture->push_block((AudioCapture::Stream)(AudioCapture::PULSE1 + c),
+                                  stem_block[c], audio_block_len);
+      }
+    }
+    capture_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - start).count();
+    audio_capture->add_capture_time(capture_ns);
   }
-  return AUDIO_BUF_SIZE - audio_read_pos + audio_write_pos;
+  capture_ns = 0;
+  audio_block_len = 0;
 }
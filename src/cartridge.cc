@@ -1,87 +1,74 @@
 #include "cartridge.hh"
-#include "mappers/mapper_000.hh"
+#include <algorithm>
+#include <filesystem>
 #include <memory>
 
 
 
-Cartridge::Cartridge(const std::string &romfile) {
-
-  // https://www.nesdev.org/wiki/INES
-  typedef struct {
-    char header_start[4];  // constant 'N', 'E', 'S', EOF
-    uint8_t PRG_ROM_size;  // PRG ROM size in 16kb units
-    uint8_t CHR_ROM_size;  // CHR ROM size in 8kb units
-    uint8_t flags6;   // Mapper, mirroring, battery, trainer
-    uint8_t flags7;   // Mapper, VS/Playchoice, NES 2.0
-    uint8_t flags8;   // PRG-RAM size (rarely used extension)
-    uint8_t flags9;   // TV system (rarely used extension)
-    uint8_t flags10;  // TV system, PRG-RAM presence (unofficial, rarely used extension)
-    char unused[5];   // unused - should be zeroed but some rippers put their name across bytes 7-15
-  } ines_header_T;
-
-  ines_header_T header;
-
-  std::ifstream ifs;
-  ifs.open(romfile, std::ifstream::binary);
-  if (ifs.is_open()) {
-    ifs.read((char*)&header, sizeof(ines_header_T));
+Cartridge::Cartridge(const std::string &romfile, RomCache* cache) {
+  image = cache ? cache->load(romfile) : RomImage::load(romfile);
+  if (!image) {
+    return;
+  }
 
-    // dont care about trainer bytes
-    if (header.flags6 & 0x04) {
-      ifs.seekg(512, std::ios_base::cur);
-    }
+  const RomInfo &info = image->info;
+  mapper_id = info.mapper;
+  mirror = info.vertical_mirror ? VERTICAL : HORIZONTAL;
 
-    mapper_id = ((header.flags6 & 0xF0) >> 4) | (header.flags7 & 0xF0);
+  // unknown mapper, nothing can run
+  const MapperRegistry::Entry* board = MapperRegistry::find(mapper_id);
+  if (!board) {
+    return;
+  }
+  capabilities = board->capabilities;
 
-    if (header.flags6 & 0x01) {
-      mirror = VERTICAL;
-    }
-    else {
-      mirror = HORIZONTAL;
-    }
+  // nes 2.0 sizes needn't be whole banks. the mappers bank in 16kb and
+  // 8kb units, and a board can't run more rom than its registers reach
+  // (or, without chr ram, no chr at all)
+  if (info.prg_rom_size == 0 || info.prg_rom_size % (16*1024) || info.chr_rom_size % (8*1024)) {
+    return;
+  }
+  if (info.prg_rom_size / (16*1024) > board->max_banks_PRG || info.chr_rom_size / (8*1024) > board->max_banks_CHR) {
+    return;
+  }
+  banks_PRG = info.prg_rom_size / (16*1024);
+  banks_CHR = info.chr_rom_size / (8*1024);
+  if (banks_CHR == 0 && !(capabilities & MapperRegistry::CHR_RAM)) {
+    return;
+  }
 
-    uint8_t romtype = 1;
-    switch (romtype) {
-      case 0:
-        break;
-        
-      case 1:
-        banks_PRG = header.PRG_ROM_size;
-        mem_PRG.resize(banks_PRG*16*1024);
-        ifs.read( (char*) mem_PRG.data(), mem_PRG.size());
-
-        banks_CHR = header.CHR_ROM_size;
-        if (banks_CHR == 0) {
-          // create new 8kb ram for chr
-          mem_CHR.resize(8*1024);
-        }
-        else {
-          mem_CHR.resize(banks_CHR*8*1024);
-        }
-        if (banks_CHR > 0) {
-          ifs.read( (char*) mem_CHR.data(), mem_CHR.size());
-        }
-        break;
-        
-      case 2:
-        break;
-    }
+  mem_PRG = image->prg;
+  if (banks_CHR == 0) {
+    // chr ram, at least the 8kb the pattern tables need
+    chr_ram.resize(std::max<size_t>(8*1024, info.chr_ram_size + info.chr_nvram_size));
+    mem_CHR = chr_ram.data();
+  }
+  else {
+    mem_CHR = image->chr;
+  }
 
-    switch (mapper_id) {
-      case 0: mapper = std::make_shared<Mapper_000>(banks_PRG, banks_CHR); break;
-      case 1: mapper = std::make_shared<Mapper_001>(banks_PRG, banks_CHR, [&](uint8_t mode) {
-        switch (mode) {
-          case 0: mirror = ONESCREEN_LO; break;
-          case 1: mirror = ONESCREEN_HI; break;
-          case 2: mirror = VERTICAL; break;
-          case 3: mirror = HORIZONTAL; break;
-      }});
-      break;
+  MapperRegistry::Board config;
+  config.banks_PRG = banks_PRG;
+  config.banks_CHR = banks_CHR;
+  config.submapper = info.submapper;
+  // mappers that switch mirroring report it in mmc1's encoding
+  config.set_mirror = [this](uint8_t mode) {
+    switch (mode) {
+      case 0: mirror = ONESCREEN_LO; break;
+      case 1: mirror = ONESCREEN_HI; break;
+      case 2: mirror = VERTICAL; break;
+      case 3: mirror = HORIZONTAL; break;
     }
+  };
+  mapper = board->create(config);
 
-    valid = true;
-    ifs.close();
+  // boards that map prg ram at 0x6000 get at least 8kb of it
+  if (capabilities & MapperRegistry::PRG_RAM) {
+    prg_ram.resize(std::max<size_t>(8*1024, info.prg_ram_size + info.prg_nvram_size));
+    mem_RAM = prg_ram.data();
   }
+
+  valid = true;
 }
 
 
@@ -92,35 +79,35 @@ Cartridge::~Cartridge() {
 bool Cartridge::cpu_read(uint16_t addr, uint8_t &data) {
   uint32_t addr_mapped = 0;
   if (mapper->cpu_mapread(addr, addr_mapped)) {
-      // for PRG-RAM read from mapper internal ram
-      if (addr >= 0x6000 && addr <= 0x7FFF && mapper_id == 1) {
-        auto mapper_001 = std::dynamic_pointer_cast<Mapper_001>(mapper);
-        if (mapper_001) {
-          data = mapper_001->prg_ram[addr_mapped];
-          return true;
-        }
-    }
-    else {
+    if (addr >= 0x8000) {
       data = this->mem_PRG[addr_mapped];
       return true;
     }
+    // prg ram, on boards that have it
+    if (mem_RAM) {
+      data = this->mem_RAM[addr_mapped];
+      return true;
+    }
   }
   return false;
 }
 
 bool Cartridge::cpu_write(uint16_t addr, uint8_t data) {
   uint32_t addr_mapped = 0;
+  // the cpu and the rom both drive the bus, 0 wins
+  if (addr >= 0x8000 && mapper->bus_conflicts && mapper->cpu_mapread(addr, addr_mapped)) {
+    data &= this->mem_PRG[addr_mapped];
+  }
   if (mapper->cpu_mapwrite(addr, addr_mapped, data)) {
-      // for prg-ram write to mappers internal ram
-      if (addr >= 0x6000 && addr <= 0x7FFF && mapper_id == 1) {
-        auto mapper_001 = std::dynamic_pointer_cast<Mapper_001>(mapper);
-        if (mapper_001) {
-          mapper_001->prg_ram[addr_mapped] = data;
-          return true;
-        }
+    if (addr >= 0x8000) {
+      // prg rom is shared and read only, the write goes nowhere
+      return true;
+    }
+    if (mem_RAM) {
+      this->mem_RAM[addr_mapped] = data;
+      if (save_ram) {
+        save_ram->touch(addr_mapped);
       }
-    else {
-      this->mem_PRG[addr_mapped] = data;
       return true;
     }
   }
@@ -139,9 +126,61 @@ bool Cartridge::ppu_read(uint16_t addr, uint8_t &data) {
 bool Cartridge::ppu_write(uint16_t addr, uint8_t data) {
   uint32_t addr_mapped = 0;
   if (mapper->ppu_mapwrite(addr, addr_mapped)) {
-    this->mem_CHR[addr_mapped] = data;
+    // mappers only allow chr writes on boards with chr ram
+    this->chr_ram[addr_mapped] = data;
     return true;
   }
   return false;
 }
 
+void Cartridge::save_state(StateWriter &w) const {
+  w.write(mirror);
+  // chr rom never changes, chr ram is part of the state
+  if (banks_CHR == 0) {
+    w.write_bytes(chr_ram.data(), chr_ram.size());
+  }
+  if (mapper) {
+    mapper->save_state(w);
+  }
+  if (mem_RAM) {
+    w.write_bytes(mem_RAM, prg_ram.size());
+  }
+}
+
+void Cartridge::load_state(StateReader &r) {
+  r.read(mirror);
+  if (banks_CHR == 0) {
+    r.read_bytes(chr_ram.data(), chr_ram.size());
+  }
+  if (mapper) {
+    mapper->load_state(r);
+  }
+  if (mem_RAM) {
+    r.read_bytes(mem_RAM, prg_ram.size());
+    if (save_ram) {
+      save_ram->touch_all();
+    }
+  }
+}
+
+bool Cartridge::open_save(const std::string &path) {
+  if (!image || !image->info.battery || !(capabilities & MapperRegistry::BATTERY) || !mem_RAM) {
+    return false;
+  }
+  std::unique_ptr<SaveRam> file = std::make_unique<SaveRam>();
+  if (!file->open(path, prg_ram.size())) {
+    return false;
+  }
+  save_ram = std::move(file);
+  mem_RAM = save_ram->data();
+  return true;
+}
+
+std::string Cartridge::save_path(const std::string &romfile) {
+  std::filesystem::path path(romfile);
+  // game.nes.gz -> game.sav
+  if (path.extension() == ".gz") {
+    path.replace_extension();
+  }
+  return path.replace_extension(".sav").string();
+}
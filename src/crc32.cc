@@ -0,0 +1,41 @@
+#include "crc32.hh"
+
+struct Crc32Tables {
+  uint32_t t[8][256];
+
+  Crc32Tables() {
+    for (uint32_t n = 0; n < 256; n++) {
+      uint32_t c = n;
+      for (int k = 0; k < 8; k++) {
+        c = c & 1 ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+      }
+      t[0][n] = c;
+    }
+    // t[k][n] is n followed by k zero bytes
+    for (int k = 1; k < 8; k++) {
+      for (int n = 0; n < 256; n++) {
+        t[k][n] = (t[k - 1][n] >> 8) ^ t[0][t[k - 1][n] & 0xFF];
+      }
+    }
+  }
+};
+
+uint32_t Crc32::update(uint32_t crc, const void* data, size_t len) {
+  static const Crc32Tables tables;
+  const uint32_t (*t)[256] = tables.t;
+  const uint8_t* p = (const uint8_t*) data;
+  crc = ~crc;
+
+  while (len >= 8) {
+    uint32_t lo = crc ^ (p[0] | p[1] << 8 | p[2] << 16 | (uint32_t) p[3] << 24);
+    uint32_t hi = p[4] | p[5] << 8 | p[6] << 16 | (uint32_t) p[7] << 24;
+    crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24]
+        ^ t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^ t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+    p += 8;
+    len -= 8;
+  }
+  while (len--) {
+    crc = t[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+  }
+  return ~crc;
+}
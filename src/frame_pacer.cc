@@ -0,0 +1,89 @@
+#include "frame_pacer.hh"
+#include <cmath>
+#include <thread>
+
+FramePacer::FramePacer(double rate) {
+  this->rate = rate;
+  this->period = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(1.0 / rate));
+  this->reset();
+}
+
+FramePacer::~FramePacer() {
+
+}
+
+void FramePacer::reset() {
+  std::lock_guard<std::mutex> guard(stats_lock);
+  next = clock::now() + period;
+  window_start = clock::now();
+  frames = 0;
+  late = 0;
+  jitter_samples = 0;
+  jitter_sum = 0.0;
+  jitter_sum_sq = 0.0;
+  jitter_max = 0.0;
+}
+
+void FramePacer::set_unlimited(bool b) {
+  unlimited = b;
+}
+
+void FramePacer::wait() {
+  if (unlimited) {
+    std::lock_guard<std::mutex> guard(stats_lock);
+    frames++;
+    // pick up from here when pacing is switched back on
+    next = clock::now() + period;
+    return;
+  }
+
+  std::this_thread::sleep_until(next);
+  clock::time_point now = clock::now();
+  double jitter = std::chrono::duration<double, std::milli>(now - next).count();
+
+  std::lock_guard<std::mutex> guard(stats_lock);
+  frames++;
+  jitter_samples++;
+  jitter_sum += jitter;
+  jitter_sum_sq += jitter * jitter;
+  if (jitter > jitter_max) {
+    jitter_max = jitter;
+  }
+
+  // deadlines are absolute so short stalls are caught up, but after a long
+  // one (host too slow, window dragged) start over instead of running fast
+  if (now - next > period) {
+    late++;
+    next = now + period;
+  }
+  else {
+    next += period;
+  }
+}
+
+FramePacer::Stats FramePacer::collect() {
+  std::lock_guard<std::mutex> guard(stats_lock);
+  Stats stats;
+  clock::time_point now = clock::now();
+  double seconds = std::chrono::duration<double>(now - window_start).count();
+
+  stats.frames = frames;
+  stats.late = late;
+  stats.fps = seconds > 0.0 ? frames / seconds : 0.0;
+  stats.speed = stats.fps / rate;
+  if (jitter_samples) {
+    double mean = jitter_sum / jitter_samples;
+    stats.jitter_avg_ms = mean;
+    stats.jitter_stddev_ms = std::sqrt(std::fmax(0.0, jitter_sum_sq / jitter_samples - mean * mean));
+    stats.jitter_max_ms = jitter_max;
+  }
+
+  window_start = now;
+  frames = 0;
+  late = 0;
+  jitter_samples = 0;
+  jitter_sum = 0.0;
+  jitter_sum_sq = 0.0;
+  jitter_max = 0.0;
+  return stats;
+}
@@ -0,0 +1,163 @@
+#include "hash64.hh"
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+static const uint64_t PRIME32_1 = 0x9E3779B1ull;
+static const uint64_t PRIME64_1 = 0x9E3779B185EBCA87ull;
+static const uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4Full;
+static const uint64_t PRIME64_4 = 0x85EBCA77C2B2AE63ull;
+
+static const uint64_t ACC_INIT[8] = {
+  0x00000000C2B2AE3Dull, 0x9E3779B185EBCA87ull, 0xC2B2AE3D27D4EB4Full, 0x165667B19E3779F9ull,
+  0x85EBCA77C2B2AE63ull, 0x0000000085EBCA77ull, 0x27D4EB2F165667C5ull, 0x000000009E3779B1ull
+};
+
+// mixed into the input before the multiply. like xxh3's secret, each
+// stripe of a block reads it one lane further along, so the same bytes at
+// different offsets add different amounts
+static const uint64_t STRIPE_KEY[Hash64::STRIPES_PER_BLOCK + 7] = {
+  0xF0E628DF814F4AF3ull, 0x4503B01B93A52A5Full, 0x1C190FA67E716529ull, 0xF9160203B2BE497Full,
+  0xD632F540E21958A5ull, 0x3E1C8186E0F37E4Bull, 0x52A601B603655CB3ull, 0x92150A787E68C63Dull,
+  0x7E85FCABFEA2F519ull, 0xD6B98B358FEECDA1ull, 0x812A8E0242FA3BB7ull, 0xCC2F84147CABFF8Bull,
+  0x68842A9C9BBCC943ull, 0xC5075069E9B69EFDull, 0x505BEA738ED31C0Dull, 0x4D3E812A410DBBC3ull,
+  0xAC71A9249A12AC4Full, 0xB0AA31BDD4C927EFull, 0xCCA497109A8E4FB3ull, 0x91E12FAF2954AE19ull,
+  0x13C935B8E5CD91E3ull, 0x5A53C283900467F9ull, 0x594ABDFCF3273E71ull
+};
+// mixed into the accumulators when scrambling
+static const uint64_t SCRAMBLE_KEY[8] = {
+  0xCB00C391BB52283Cull, 0xA32E531B8B65D088ull, 0x4EF90DA297486471ull, 0xD8ACDEA946EF1938ull,
+  0x3F349CE33F76FAA8ull, 0x1D4F0BC7C7BBDCF9ull, 0x3159B4CD4BE0518Aull, 0x647378D9C97E9FC8ull
+};
+
+static inline uint64_t read64(const uint8_t* p) {
+  uint64_t v;
+  memcpy(&v, p, sizeof(v));
+  #if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  v = __builtin_bswap64(v);
+  #endif
+  return v;
+}
+
+static inline uint64_t rotl64(uint64_t x, int r) {
+  return (x << r) | (x >> (64 - r));
+}
+
+uint64_t Hash64::hash(const void* data, size_t len, uint64_t seed) {
+  #ifdef __SSE2__
+  return hash_sse2(data, len, seed);
+  #else
+  return hash_scalar(data, len, seed);
+  #endif
+}
+
+void Hash64::init(uint64_t acc[8], uint64_t seed) {
+  for (int i = 0; i < 8; i++) {
+    acc[i] = ACC_INIT[i] + seed;
+  }
+}
+
+void Hash64::stripe_scalar(uint64_t acc[8], const uint8_t* p, int n) {
+  const uint64_t* key = STRIPE_KEY + n;
+  for (int i = 0; i < 8; i++) {
+    uint64_t d = read64(p + i * 8);
+    uint64_t dk = d ^ key[i];
+    // neighbouring lane keeps the raw input, so zero products lose nothing
+    acc[i ^ 1] += d;
+    acc[i] += (dk & 0xFFFFFFFF) * (dk >> 32);
+  }
+}
+
+void Hash64::scramble_scalar(uint64_t acc[8]) {
+  for (int i = 0; i < 8; i++) {
+    uint64_t a = acc[i];
+    a ^= a >> 47;
+    a ^= SCRAMBLE_KEY[i];
+    acc[i] = a * PRIME32_1;
+  }
+}
+
+uint64_t Hash64::finish(uint64_t acc[8], const uint8_t* tail, size_t tail_len, size_t len) {
+  if (tail_len) {
+    uint8_t last[STRIPE] = {0};
+    memcpy(last, tail, tail_len);
+    stripe_scalar(acc, last, (len / STRIPE) % STRIPES_PER_BLOCK);
+  }
+
+  uint64_t h = len * PRIME64_1;
+  for (int i = 0; i < 8; i++) {
+    h ^= rotl64(acc[i] * PRIME64_2, 31) * PRIME64_1;
+    h = rotl64(h, 27) * PRIME64_1 + PRIME64_4;
+  }
+
+  // avalanche
+  h ^= h >> 37;
+  h *= 0x165667919E3779F9ull;
+  h ^= h >> 32;
+  return h;
+}
+
+uint64_t Hash64::hash_scalar(const void* data, size_t len, uint64_t seed) {
+  const uint8_t* p = (const uint8_t*) data;
+  uint64_t acc[8];
+  init(acc, seed);
+
+  size_t stripes = len / STRIPE;
+  for (size_t s = 0; s < stripes; s++) {
+    stripe_scalar(acc, p + s * STRIPE, s % STRIPES_PER_BLOCK);
+    if ((s + 1) % STRIPES_PER_BLOCK == 0) {
+      scramble_scalar(acc);
+    }
+  }
+  return finish(acc, p + stripes * STRIPE, len % STRIPE, len);
+}
+
+#ifdef __SSE2__
+uint64_t Hash64::hash_sse2(const void* data, size_t len, uint64_t seed) {
+  const uint8_t* p = (const uint8_t*) data;
+  uint64_t lanes[8];
+  init(lanes, seed);
+
+  __m128i acc[4];
+  __m128i scramble_key[4];
+  for (int i = 0; i < 4; i++) {
+    acc[i] = _mm_loadu_si128((const __m128i*) (lanes + i * 2));
+    scramble_key[i] = _mm_loadu_si128((const __m128i*) (SCRAMBLE_KEY + i * 2));
+  }
+  const __m128i prime = _mm_set1_epi64x(PRIME32_1);
+
+  size_t stripes = len / STRIPE;
+  for (size_t s = 0; s < stripes; s++) {
+    const uint8_t* stripe = p + s * STRIPE;
+    const uint64_t* key = STRIPE_KEY + s % STRIPES_PER_BLOCK;
+    for (int i = 0; i < 4; i++) {
+      __m128i d = _mm_loadu_si128((const __m128i*) (stripe + i * 16));
+      __m128i dk = _mm_xor_si128(d, _mm_loadu_si128((const __m128i*) (key + i * 2)));
+      // low half of each lane times its high half
+      __m128i product = _mm_mul_epu32(dk, _mm_srli_epi64(dk, 32));
+      // lanes i and i^1 share a register, swap them for the raw input
+      __m128i swapped = _mm_shuffle_epi32(d, _MM_SHUFFLE(1, 0, 3, 2));
+      acc[i] = _mm_add_epi64(acc[i], _mm_add_epi64(product, swapped));
+    }
+
+    if ((s + 1) % STRIPES_PER_BLOCK == 0) {
+      for (int i = 0; i < 4; i++) {
+        __m128i a = acc[i];
+        a = _mm_xor_si128(a, _mm_srli_epi64(a, 47));
+        a = _mm_xor_si128(a, scramble_key[i]);
+        // 64x32 multiply from two 32x32 ones
+        __m128i lo = _mm_mul_epu32(a, prime);
+        __m128i hi = _mm_mul_epu32(_mm_srli_epi64(a, 32), prime);
+        acc[i] = _mm_add_epi64(lo, _mm_slli_epi64(hi, 32));
+      }
+    }
+  }
+
+  for (int i = 0; i < 4; i++) {
+    _mm_storeu_si128((__m128i*) (lanes + i * 2), acc[i]);
+  }
+  return finish(lanes, p + stripes * STRIPE, len % STRIPE, len);
+}
+#endif
@@ -0,0 +1,336 @@
+#include "inflate.hh"
+#include <cstring>
+
+static const uint16_t LENGTH_BASE[29] = {
+  3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+  35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const uint8_t LENGTH_EXTRA[29] = {
+  0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+  3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const uint16_t DIST_BASE[30] = {
+  1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+  257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const uint8_t DIST_EXTRA[30] = {
+  0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+  7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+// little endian bit reader. reading past the end gives zeros and is
+// caught by overrun(), so the hot paths don't check the input length
+struct Inflate::Bits {
+  const uint8_t* in;
+  size_t size;
+  size_t pos = 0;
+  uint64_t buf = 0;
+  int count = 0;
+  // zero bytes fed in after the end
+  int padding = 0;
+
+  Bits(const uint8_t* in, size_t size) : in(in), size(size) {}
+
+  inline void refill() {
+    if (pos + 8 <= size) {
+      // whole bytes that fit. the bits of the next byte that land above
+      // count are the same ones it loads later, so or-ing them is harmless
+      uint64_t v;
+      memcpy(&v, in + pos, sizeof(v));
+      #if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+      v = __builtin_bswap64(v);
+      #endif
+      buf |= v << count;
+      pos += (63 - count) >> 3;
+      count |= 56;
+      return;
+    }
+    while (count <= 56) {
+      uint64_t b = 0;
+      if (pos < size) {
+        b = in[pos++];
+      }
+      else {
+        padding++;
+      }
+      buf |= b << count;
+      count += 8;
+    }
+  }
+
+  inline void drop(int n) {
+    buf >>= n;
+    count -= n;
+  }
+
+  // n <= 32
+  inline uint32_t get(int n) {
+    this->refill();
+    uint32_t v = buf & ((1ull << n) - 1);
+    this->drop(n);
+    return v;
+  }
+
+  bool overrun() const {
+    return padding * 8 > count;
+  }
+
+  // stored blocks start on a byte boundary and are copied straight from
+  // the input, give back the bytes that were read ahead
+  bool align() {
+    this->drop(count & 7);
+    if (this->overrun()) {
+      return false;
+    }
+    pos -= count / 8 - padding;
+    buf = 0;
+    count = 0;
+    padding = 0;
+    return true;
+  }
+};
+
+bool Inflate::build(Huffman &h, const uint8_t* lengths, int n) {
+  memset(h.count, 0, sizeof(h.count));
+  for (int i = 0; i < n; i++) {
+    h.count[lengths[i]]++;
+  }
+  h.count[0] = 0;
+
+  int left = 1;
+  for (int len = 1; len <= MAX_BITS; len++) {
+    left <<= 1;
+    left -= h.count[len];
+    if (left < 0) {
+      return false;
+    }
+  }
+
+  // symbols sorted by code length, then by value
+  uint16_t offset[MAX_BITS + 2];
+  offset[1] = 0;
+  for (int len = 1; len <= MAX_BITS; len++) {
+    offset[len + 1] = offset[len] + h.count[len];
+  }
+  for (int i = 0; i < n; i++) {
+    if (lengths[i]) {
+      h.symbol[offset[lengths[i]]++] = i;
+    }
+  }
+
+  // codes are sent msb first into an lsb first stream, so the table is
+  // indexed by the bit reversed code, every entry that starts with it
+  memset(h.fast, 0, sizeof(h.fast));
+  int code = 0;
+  int index = 0;
+  for (int len = 1; len <= FAST_BITS; len++) {
+    for (int k = 0; k < h.count[len]; k++, index++, code++) {
+      int reversed = 0;
+      for (int b = 0; b < len; b++) {
+        reversed |= ((code >> b) & 1) << (len - 1 - b);
+      }
+      for (int r = reversed; r < (1 << FAST_BITS); r += 1 << len) {
+        h.fast[r] = h.symbol[index] | len << 9;
+      }
+    }
+    code <<= 1;
+  }
+  return true;
+}
+
+int Inflate::decode(Bits &bits, const Huffman &h) {
+  bits.refill();
+  uint16_t entry = h.fast[bits.buf & ((1 << FAST_BITS) - 1)];
+  if (entry) {
+    bits.drop(entry >> 9);
+    return entry & 0x1FF;
+  }
+
+  // longer than FAST_BITS, walk the canonical code a bit at a time
+  int code = 0;
+  int first = 0;
+  int index = 0;
+  for (int len = 1; len <= MAX_BITS; len++) {
+    code |= (bits.buf >> (len - 1)) & 1;
+    int count = h.count[len];
+    if (code - first < count) {
+      bits.drop(len);
+      return h.symbol[index + code - first];
+    }
+    index += count;
+    first += count;
+    first <<= 1;
+    code <<= 1;
+  }
+  return -1;
+}
+
+bool Inflate::codes(Bits &bits, const Huffman &lit, const Huffman &dist, uint8_t* out, size_t out_size, size_t &pos) {
+  while (true) {
+    int symbol = decode(bits, lit);
+    if (symbol < 0 || bits.overrun()) {
+      return false;
+    }
+    if (symbol < 256) {
+      if (pos >= out_size) {
+        return false;
+      }
+      out[pos++] = symbol;
+      continue;
+    }
+    if (symbol == 256) {
+      return true;
+    }
+
+    symbol -= 257;
+    if (symbol >= 29) {
+      return false;
+    }
+    size_t len = LENGTH_BASE[symbol] + bits.get(LENGTH_EXTRA[symbol]);
+    int d = decode(bits, dist);
+    if (d < 0 || d >= 30) {
+      return false;
+    }
+    size_t distance = DIST_BASE[d] + bits.get(DIST_EXTRA[d]);
+    if (bits.overrun() || distance > pos || len > out_size - pos) {
+      return false;
+    }
+
+    uint8_t* dst = out + pos;
+    const uint8_t* src = dst - distance;
+    if (distance >= len) {
+      memcpy(dst, src, len);
+    }
+    else {
+      // overlapping, repeats the last distance bytes
+      for (size_t i = 0; i < len; i++) {
+        dst[i] = src[i];
+      }
+    }
+    pos += len;
+  }
+}
+
+bool Inflate::dynamic_tables(Bits &bits, Huffman &lit, Huffman &dist) {
+  static const uint8_t ORDER[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+  int n_lit = bits.get(5) + 257;
+  int n_dist = bits.get(5) + 1;
+  int n_len = bits.get(4) + 4;
+  if (n_lit > 286 || n_dist > 30) {
+    return false;
+  }
+
+  // the code lengths are themselves huffman coded, lit holds that code
+  // until the real lengths are known
+  uint8_t code_lengths[19] = {0};
+  for (int i = 0; i < n_len; i++) {
+    code_lengths[ORDER[i]] = bits.get(3);
+  }
+  if (!build(lit, code_lengths, 19)) {
+    return false;
+  }
+
+  uint8_t lengths[286 + 30] = {0};
+  int n = 0;
+  while (n < n_lit + n_dist) {
+    int symbol = decode(bits, lit);
+    if (symbol < 0 || bits.overrun()) {
+      return false;
+    }
+    if (symbol < 16) {
+      lengths[n++] = symbol;
+      continue;
+    }
+    int value = 0;
+    int repeat;
+    if (symbol == 16) {
+      if (n == 0) {
+        return false;
+      }
+      value = lengths[n - 1];
+      repeat = 3 + bits.get(2);
+    }
+    else if (symbol == 17) {
+      repeat = 3 + bits.get(3);
+    }
+    else {
+      repeat = 11 + bits.get(7);
+    }
+    if (n + repeat > n_lit + n_dist) {
+      return false;
+    }
+    while (repeat--) {
+      lengths[n++] = value;
+    }
+  }
+
+  // a block without an end code can't be decoded
+  if (lengths[256] == 0) {
+    return false;
+  }
+  return build(lit, lengths, n_lit) && build(dist, lengths + n_lit, n_dist);
+}
+
+bool Inflate::inflate(const uint8_t* in, size_t in_size, uint8_t* out, size_t out_size, size_t &out_len) {
+  struct FixedTables {
+    Huffman lit;
+    Huffman dist;
+
+    FixedTables() {
+      uint8_t lengths[288];
+      memset(lengths, 8, 144);
+      memset(lengths + 144, 9, 112);
+      memset(lengths + 256, 7, 24);
+      memset(lengths + 280, 8, 8);
+      build(lit, lengths, 288);
+      memset(lengths, 5, 30);
+      build(dist, lengths, 30);
+    }
+  };
+  static const FixedTables fixed;
+
+  Bits bits(in, in_size);
+  size_t pos = 0;
+  out_len = 0;
+  bool last;
+  do {
+    last = bits.get(1);
+    int type = bits.get(2);
+
+    if (type == 0) {
+      if (!bits.align() || bits.pos + 4 > in_size) {
+        return false;
+      }
+      const uint8_t* p = in + bits.pos;
+      size_t len = p[0] | p[1] << 8;
+      size_t nlen = p[2] | p[3] << 8;
+      bits.pos += 4;
+      if (len != (~nlen & 0xFFFF) || bits.pos + len > in_size || len > out_size - pos) {
+        return false;
+      }
+      if (len) {
+        memcpy(out + pos, in + bits.pos, len);
+      }
+      bits.pos += len;
+      pos += len;
+    }
+    else if (type == 1) {
+      if (!codes(bits, fixed.lit, fixed.dist, out, out_size, pos)) {
+        return false;
+      }
+    }
+    else if (type == 2) {
+      Huffman lit, dist;
+      if (!dynamic_tables(bits, lit, dist) || !codes(bits, lit, dist, out, out_size, pos)) {
+        return false;
+      }
+    }
+    else {
+      return false;
+    }
+  } while (!last);
+
+  out_len = pos;
+  return !bits.overrun();
+}
@@ -1,41 +1,138 @@
 #include <SDL2/SDL_audio.h>
 #include <SDL2/SDL_stdinc.h>
 #include <cstddef>
+#include <cstdio>
 #include <iostream>
 #include <SDL2/SDL.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
 #include <memory>
+#include <thread>
 #ifdef __EMSCRIPTEN__
 #include <emscripten.h>
 #endif
 
 #include "bus.hh"
 #include "cartridge.hh"
+#include "audio_capture.hh"
+#include "video_capture.hh"
+#include "frame_pacer.hh"
+#include "triple_buffer.hh"
+#include "thread_pool.hh"
+#include "video_filter.hh"
+#include "movie.hh"
+#include "rom_index.hh"
+#include "state.hh"
 
-std::shared_ptr<Bus> nes;
-SDL_Window* window = nullptr;
-SDL_Renderer* renderer = nullptr;
-SDL_Texture* texture = nullptr;
-SDL_AudioDeviceID audio_device = 0;
-bool running = true;
+// controller 1 bit for a key, 0 if it isn't mapped
+static uint8_t pad_button(SDL_Scancode key) {
+    switch (key) {
+        case SDL_SCANCODE_X:     return 0x80; // A
+        case SDL_SCANCODE_Z:     return 0x40; // B
+        case SDL_SCANCODE_A:     return 0x20; // Select
+        case SDL_SCANCODE_S:     return 0x10; // Start
+        case SDL_SCANCODE_UP:    return 0x08;
+        case SDL_SCANCODE_DOWN:  return 0x04;
+        case SDL_SCANCODE_LEFT:  return 0x02;
+        case SDL_SCANCODE_RIGHT: return 0x01;
+        default:                 return 0x00;
+    }
+}
+
+static int64_t host_time_us() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// the sdl frontend: window, audio device, threads and everything around
+// the console. nothing here is global, main() owns the one instance
+class Frontend {
+public:
+    int run(int argc, char* argv[]);
+
+private:
+    std::unique_ptr<Bus> nes;
+    AudioCapture audio_capture;
+    VideoCapture video_capture;
+    SDL_Window* window = nullptr;
+    SDL_Renderer* renderer = nullptr;
+    SDL_Texture* texture = nullptr;
+    SDL_AudioDeviceID audio_device = 0;
+    std::atomic<bool> running{true};
+
+    // emulation thread publishes finished frames, render thread shows the newest
+    std::unique_ptr<TripleBuffer<PPU::Frame>> frames;
+    FramePacer pacer;
+    std::atomic<uint8_t> input_state{0x00};
+    // buttons pressed since the last strobe, so a tap between two strobes
+    // still reaches the game
+    std::atomic<uint8_t> input_tapped{0x00};
+
+    // input latency: host time from sdl's timestamp on a pad key event to
+    // the game strobing $4016 and latching it. -1 = nothing pending
+    std::atomic<int64_t> input_changed_at{-1};
+    std::atomic<uint64_t> latency_count{0};
+    std::atomic<uint64_t> latency_total_us{0};
+    std::atomic<uint64_t> latency_max_us{0};
+
+    // fast forward: run uncapped and only render 1 of every frame_skip frames
+    std::atomic<bool> turbo{false};
+    int frame_skip = 4;
+    uint64_t frame_count = 0;
+
+    // input movie. while recording or playing, every read of a frame sees the
+    // same input so the movie replays exactly
+    MovieWriter movie_writer;
+    MovieReader movie_reader;
+    bool movie_playing = false;
+    bool headless = false;
+    uint8_t frame_input[2] = {0x00, 0x00};
+    bool frame_input_latched = false;
+    // a save state goes into the movie this often, for seeking
+    static const uint64_t KEYFRAME_INTERVAL = 600;
+
+    // scaling/ntsc filter between the ppu frame and the texture, f cycles it
+    std::unique_ptr<ThreadPool> video_pool;
+    std::unique_ptr<VideoFilter> video_filter;
+
+    // line hashes of what is currently in the texture
+    uint32_t shown_hash[240];
+    bool texture_valid = false;
+    bool redraw = true;
 
-void audio_callback(void* userdata, Uint8* stream, int len) {
+    static void audio_callback(void* userdata, Uint8* stream, int len);
+    #ifdef __EMSCRIPTEN__
+    static void browser_frame(void* frontend);
+    #endif
+
+    void handle_events();
+    uint8_t live_input();
+    uint8_t poll_input(int port);
+    void movie_frame();
+    void create_texture();
+    void present(const PPU::Frame* frame);
+    void emulate_frame();
+    void emulation_loop();
+    void show_stats();
+    void render_loop();
+    void main_loop();
+    void shutdown();
+    void run_headless();
+};
+
+void Frontend::audio_callback(void* userdata, Uint8* stream, int len) {
     Bus* bus = (Bus*) userdata;
-    float* fstream = (float*) stream;
-    int n_samples = len / sizeof(float);
+    int16_t* sstream = (int16_t*) stream;
+    int n_samples = len / sizeof(int16_t);
 
     for (int i = 0; i < n_samples; i++) {
-        fstream[i] = bus->pop_audio_sample();
+        sstream[i] = bus->pop_audio_sample();
     }
 }
 
-void main_loop() {
-    if (!running) {
-        #ifdef __EMSCRIPTEN__
-        emscripten_cancel_main_loop();
-        #endif
-        return;
-    }
-
+void Frontend::handle_events() {
     SDL_Event event;
     while (SDL_PollEvent(&event)) {
         if (event.type == SDL_QUIT) {
@@ -44,48 +141,462 @@ void main_loop() {
         if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_ESCAPE) {
             running = false;
         }
+        if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_TAB && !event.key.repeat) {
+            turbo = !turbo;
+        }
+        if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_f && !event.key.repeat) {
+            int next = (video_filter->get_type() + 1) % VideoFilter::N_TYPES;
+            video_filter->set_type((VideoFilter::Type) next);
+        }
+        // window contents were lost, present again even if the frame is the same
+        if (event.type == SDL_WINDOWEVENT) {
+            redraw = true;
+        }
+        if ((event.type == SDL_KEYDOWN || event.type == SDL_KEYUP) && !event.key.repeat) {
+            uint8_t button = pad_button(event.key.keysym.scancode);
+            if (button) {
+                // latency counts from when sdl saw the key, not from this
+                // poll. its timestamp is in SDL_GetTicks() milliseconds
+                int64_t age_us = (int64_t) (Uint32) (SDL_GetTicks() - event.key.timestamp) * 1000;
+                int64_t none = -1;
+                input_changed_at.compare_exchange_strong(none, host_time_us() - age_us);
+                // a press released before the game strobes is still seen once
+                if (event.type == SDL_KEYDOWN) {
+                    input_tapped |= button;
+                }
+            }
+        }
     }
 
     // controller 
     const uint8_t* keys = SDL_GetKeyboardState(nullptr);
     uint8_t controller = 0x00;
+    for (int scancode = 0; scancode < SDL_NUM_SCANCODES; scancode++) {
+        if (keys[scancode]) {
+            controller |= pad_button((SDL_Scancode) scancode);
+        }
+    }
+    input_state = controller;
+}
 
-    if (keys[SDL_SCANCODE_X])      controller |= 0x80; // A
-    if (keys[SDL_SCANCODE_Z])      controller |= 0x40; // B
-    if (keys[SDL_SCANCODE_A])      controller |= 0x20; // Select
-    if (keys[SDL_SCANCODE_S])      controller |= 0x10; // Start
-    if (keys[SDL_SCANCODE_UP])     controller |= 0x08;
-    if (keys[SDL_SCANCODE_DOWN])   controller |= 0x04;
-    if (keys[SDL_SCANCODE_LEFT])   controller |= 0x02;
-    if (keys[SDL_SCANCODE_RIGHT])  controller |= 0x01;
-
-    nes->rp->controller[0] = controller;
+// current keyboard state for controller 1. called once per latch, so the
+// pending tap and latency sample go to the write that latches them
+uint8_t Frontend::live_input() {
+    int64_t changed = input_changed_at.exchange(-1);
+    if (changed >= 0) {
+        uint64_t us = host_time_us() - changed;
+        latency_count++;
+        latency_total_us += us;
+        uint64_t max = latency_max_us;
+        while (us > max && !latency_max_us.compare_exchange_weak(max, us));
+    }
+    return input_state | input_tapped.exchange(0);
+}
 
-    // one frame
-    while (!nes->ppu.frame_complete) {
-        nes->clk();
+// called by the 2A03 when a $4016 write latches the pads, from the
+// emulation thread
+uint8_t Frontend::poll_input(int port) {
+    if (port < 0 || port > 1) {
+        return 0x00;
+    }
+    if (movie_playing) {
+        return frame_input[port];
+    }
+    if (movie_writer.is_open()) {
+        // first strobe of the frame decides the input for the whole frame
+        if (!frame_input_latched) {
+            frame_input[0] = live_input();
+            frame_input[1] = 0x00;
+            frame_input_latched = true;
+            movie_writer.record(nes->frame_count, frame_input[0], frame_input[1]);
+        }
+        return frame_input[port];
+    }
+    return port == 0 ? live_input() : 0x00;
+}
 
-        if (nes->sys_clocks % 122 == 0) {
-            float sample = nes->rp->apu.get_audio_sample();
-            nes->push_audio_sample(sample);
+// between frames, before the next one starts
+void Frontend::movie_frame() {
+    frame_input_latched = false;
+    if (movie_playing) {
+        if (nes->frame_count > movie_reader.length()) {
+            movie_playing = false;
+            std::cerr << "movie finished at frame " << nes->frame_count << std::endl;
+            if (headless) {
+                running = false;
+            }
+            return;
         }
+        movie_reader.input(nes->frame_count, frame_input[0], frame_input[1]);
+    }
+    if (movie_writer.is_open() && nes->frame_count > 0 && nes->frame_count % KEYFRAME_INTERVAL == 0) {
+        StateWriter state;
+        nes->save_state(state);
+        movie_writer.keyframe(nes->frame_count, state.data);
     }
-    nes->ppu.frame_complete = false;
+}
 
-    // rendering
-    SDL_UpdateTexture(
-        texture,
-        nullptr,
-        nes->ppu.screen_buffer,
-        256 * sizeof(uint32_t)
+// (re)creates the texture at the filter's output size
+void Frontend::create_texture() {
+    if (texture) {
+        SDL_DestroyTexture(texture);
+    }
+    texture = SDL_CreateTexture(
+        renderer,
+        SDL_PIXELFORMAT_ARGB8888,
+        SDL_TEXTUREACCESS_STREAMING,
+        video_filter->width(),
+        video_filter->height()
     );
+    texture_valid = false;
+}
+
+// uploads only the band of lines that changed since the last upload and
+// skips the upload and present entirely for identical frames
+void Frontend::present(const PPU::Frame* frame) {
+    int width, height;
+    SDL_QueryTexture(texture, nullptr, nullptr, &width, &height);
+    if (width != video_filter->width() || height != video_filter->height()) {
+        create_texture();
+    }
 
-    SDL_RenderClear(renderer);
-    SDL_RenderCopy(renderer, texture, nullptr, nullptr);
-    SDL_RenderPresent(renderer);
+    int first = 0;
+    int last = 239;
+
+    if (texture_valid) {
+        while (first < 240 && frame->line_hash[first] == shown_hash[first]) {
+            first++;
+        }
+        while (last >= first && frame->line_hash[last] == shown_hash[last]) {
+            last--;
+        }
+    }
+
+    if (first <= last) {
+        // frames hold palette indices, the filter converts only the dirty
+        // lines (plus the neighbours that read them) straight into the texture
+        int radius = video_filter->radius();
+        int out_first = std::max(first - radius, 0);
+        int out_last = std::min(last + radius, 239);
+        int rows = video_filter->scale_y();
+
+        SDL_Rect dirty = {0, out_first * rows, video_filter->width(), (out_last - out_first + 1) * rows};
+        void* pixels;
+        int pitch;
+        if (SDL_LockTexture(texture, &dirty, &pixels, &pitch) == 0) {
+            video_filter->apply(frame->index, out_first, out_last, (uint32_t*) pixels, pitch);
+            SDL_UnlockTexture(texture);
+        }
+        for (int i = first; i <= last; i++) {
+            shown_hash[i] = frame->line_hash[i];
+        }
+        texture_valid = true;
+        redraw = true;
+    }
+
+    if (redraw) {
+        SDL_RenderClear(renderer);
+        SDL_RenderCopy(renderer, texture, nullptr, nullptr);
+        SDL_RenderPresent(renderer);
+        redraw = false;
+    }
 }
 
-int main(int argc, char* argv[]) {
+// runs one frame, then hands it to the render side
+void Frontend::emulate_frame() {
+    bool fast = turbo;
+    pacer.set_unlimited(fast);
+    // audio would play back slower than it is produced, mute it
+    nes->audio_output = !fast && !headless;
+    nes->ppu.skip_render = fast && (frame_count % frame_skip) != 0;
+    frame_count++;
+
+    movie_frame();
+    nes->run_frame();
+
+    if (!nes->ppu.skip_render) {
+        if (video_capture.running()) {
+            video_capture.push_frame(nes->ppu.frame->index);
+        }
+        frames->publish();
+        nes->ppu.set_frame(frames->back());
+    }
+}
+
+// native: emulation runs on its own thread, paced at the real ntsc rate
+// instead of the monitor refresh
+void Frontend::emulation_loop() {
+    pacer.reset();
+    while (running) {
+        emulate_frame();
+        pacer.wait();
+    }
+}
+
+void Frontend::show_stats() {
+    FramePacer::Stats stats = pacer.collect();
+    char title[192];
+    uint64_t presses = latency_count;
+    double latency_avg_ms = presses ? latency_total_us / 1000.0 / presses : 0.0;
+    if (turbo) {
+        snprintf(title, sizeof(title), "nes - fast forward %.2fx (%.1f fps, 1/%d frames drawn)",
+                 stats.speed, stats.fps, frame_skip);
+    }
+    else {
+        snprintf(title, sizeof(title), "nes - %.2fx, %.2f fps, jitter %.2f ms avg, %.2f ms sd, %.2f ms max, %llu late, input %.1f ms avg",
+                 stats.speed, stats.fps, stats.jitter_avg_ms, stats.jitter_stddev_ms, stats.jitter_max_ms,
+                 (unsigned long long) stats.late, latency_avg_ms);
+    }
+    SDL_SetWindowTitle(window, title);
+}
+
+void Frontend::render_loop() {
+    Uint32 last_stats = SDL_GetTicks();
+    while (running) {
+        handle_events();
+
+        PPU::Frame* frame = frames->acquire();
+        if (frame) {
+            // vsync only throttles this thread now
+            present(frame);
+        }
+        else if (redraw && texture_valid) {
+            present(frames->front());
+        }
+        else {
+            SDL_Delay(1);
+        }
+
+        if (SDL_GetTicks() - last_stats >= 1000) {
+            show_stats();
+            last_stats = SDL_GetTicks();
+        }
+    }
+}
+
+// browser: single threaded, the browser drives us once per animation frame
+void Frontend::main_loop() {
+    if (!running) {
+        #ifdef __EMSCRIPTEN__
+        emscripten_cancel_main_loop();
+        #endif
+        return;
+    }
+
+    handle_events();
+    // fast forward runs a batch of frames per browser callback
+    int n = turbo ? frame_skip : 1;
+    for (int i = 0; i < n; i++) {
+        emulate_frame();
+    }
+
+    PPU::Frame* frame = frames->acquire();
+    if (frame) {
+        present(frame);
+    }
+}
+
+#ifdef __EMSCRIPTEN__
+void Frontend::browser_frame(void* frontend) {
+    ((Frontend*) frontend)->main_loop();
+}
+#endif
+
+// flushes captures and the movie being recorded
+void Frontend::shutdown() {
+    if (audio_capture.running()) {
+        nes->audio_capture = nullptr;
+        audio_capture.stop();
+        // a frame is 1/60.0988 s of audio
+        fprintf(stderr, "audio capture took %.1f us per frame on the emulation thread (%.2f%% of frame time), dropped %llu blocks\n",
+                audio_capture.capture_load() * 1e6 / 60.0988, audio_capture.capture_load() * 100,
+                (unsigned long long) audio_capture.dropped_blocks());
+    }
+    if (video_capture.running()) {
+        video_capture.stop();
+        std::cerr << "video capture wrote " << video_capture.written_frames() << " frames, dropped "
+                  << video_capture.dropped_frames() << std::endl;
+    }
+    if (movie_writer.is_open()) {
+        movie_writer.close();
+        std::cerr << "movie recorded " << nes->frame_count << " frames" << std::endl;
+    }
+}
+
+// plays a movie back without a window, unpaced
+void Frontend::run_headless() {
+    int64_t start = host_time_us();
+    uint64_t start_frame = nes->frame_count;
+    while (running) {
+        emulate_frame();
+    }
+    double seconds = (host_time_us() - start) / 1e6;
+    uint64_t frames_run = nes->frame_count - start_frame;
+
+    // ram checksum, two runs of the same movie must agree
+    uint64_t hash = 14695981039346656037ull;
+    for (uint8_t byte : nes->cpu_mem) {
+        hash = (hash ^ byte) * 1099511628211ull;
+    }
+    printf("%llu frames in %.2fs (%.1f fps), ram %016llx\n",
+           (unsigned long long) frames_run, seconds, seconds > 0.0 ? frames_run / seconds : 0.0,
+           (unsigned long long) hash);
+}
+
+int Frontend::run(int argc, char* argv[]) {
+    // preloaded rom
+    // TODO: in browser rom loading
+    std::string rom_path = "rom.nes"; 
+    std::string capture_prefix;
+    std::string video_path;
+    std::string filter_name;
+    std::string record_path;
+    std::string play_path;
+    std::string index_path;
+    int fixed_audio = -1;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--capture-audio" && i + 1 < argc) {
+            // writes <prefix>.mix.wav plus one wav per apu channel
+            capture_prefix = argv[++i];
+        }
+        else if (arg == "--fixed-audio") {
+            fixed_audio = true;
+        }
+        else if (arg == "--float-audio") {
+            fixed_audio = false;
+        }
+        else if (arg == "--turbo") {
+            // start in fast forward, tab toggles it at runtime
+            turbo = true;
+        }
+        else if (arg == "--frameskip" && i + 1 < argc) {
+            frame_skip = std::max(1, atoi(argv[++i]));
+        }
+        else if (arg == "--capture-video" && i + 1 < argc) {
+            // .y4m file, or a .png name for a numbered png sequence
+            video_path = argv[++i];
+        }
+        else if (arg == "--filter" && i + 1 < argc) {
+            // nearest, scale2x, scale3x, hq2x or ntsc
+            filter_name = argv[++i];
+        }
+        else if (arg == "--record" && i + 1 < argc) {
+            record_path = argv[++i];
+        }
+        else if (arg == "--play" && i + 1 < argc) {
+            play_path = argv[++i];
+        }
+        else if (arg == "--headless") {
+            // no window or audio, plays the movie as fast as possible
+            headless = true;
+        }
+        else if (arg == "--index" && i + 1 < argc) {
+            // rom library index from nes-index, the rom can then be
+            // given by title or hash
+            index_path = argv[++i];
+        }
+        else {
+            rom_path = arg;
+        }
+    }
+
+    if (!index_path.empty()) {
+        RomIndex index;
+        if (!index.open(index_path)) {
+            std::cerr << "failed to open index: " << index_path << std::endl;
+            return -1;
+        }
+        std::string found = index.resolve(rom_path);
+        if (!found.empty()) {
+            rom_path = found;
+        }
+    }
+
+    nes = std::make_unique<Bus>();
+    std::shared_ptr<Cartridge> cart = std::make_shared<Cartridge>(rom_path);
+
+    if (!cart->valid) {
+        std::cerr << "failed to load cartridge: " << rom_path << std::endl;
+        return -1;
+    }
+
+    // battery backed ram lives in a .sav next to the rom. not while a
+    // movie plays, its start state brings the ram it was recorded with
+    if (play_path.empty()) {
+        cart->open_save(Cartridge::save_path(rom_path));
+    }
+
+    nes->insert_cartridge(cart);
+    nes->reset();
+    nes->rp.input_provider = [this](int port) {
+        return this->poll_input(port);
+    };
+    if (fixed_audio >= 0) {
+        nes->audio_fixed_point = fixed_audio;
+    }
+
+    if (headless && play_path.empty()) {
+        std::cerr << "--headless needs a movie to --play" << std::endl;
+        return -1;
+    }
+    if (!play_path.empty()) {
+        if (!movie_reader.open(play_path)) {
+            std::cerr << "failed to open movie: " << play_path << std::endl;
+            return -1;
+        }
+        if (movie_reader.rom_hash != cart->rom_hash()) {
+            std::cerr << "movie was recorded with a different rom" << std::endl;
+            return -1;
+        }
+        StateReader state(movie_reader.start_state, movie_reader.start_state_size);
+        if (!nes->load_state(state)) {
+            std::cerr << "movie start state does not match this build" << std::endl;
+            return -1;
+        }
+        movie_playing = true;
+    }
+    else if (!record_path.empty()) {
+        StateWriter state;
+        nes->save_state(state);
+        if (!movie_writer.open(record_path, cart->rom_hash(), state.data)) {
+            std::cerr << "failed to open movie: " << record_path << std::endl;
+            return -1;
+        }
+    }
+
+    frames = std::make_unique<TripleBuffer<PPU::Frame>>();
+    nes->ppu.set_frame(frames->back());
+    nes->ppu.output_mode = PPU::OUTPUT_INDEXED;
+
+    VideoFilter::Type filter_type = VideoFilter::NEAREST;
+    if (!filter_name.empty() && !VideoFilter::from_name(filter_name, filter_type)) {
+        std::cerr << "unknown filter: " << filter_name << " (nearest, scale2x, scale3x, hq2x or ntsc)" << std::endl;
+        return -1;
+    }
+
+    #ifndef __EMSCRIPTEN__
+    if (!capture_prefix.empty()) {
+        if (audio_capture.start(capture_prefix, 44100, true)) {
+            nes->audio_capture = &audio_capture;
+        }
+        else {
+            std::cerr << "failed to open audio capture: " << capture_prefix << std::endl;
+        }
+    }
+    // recorded at the filter's output size
+    if (!video_path.empty() && !video_capture.start(video_path, &nes->ppu.palette, filter_type)) {
+        std::cerr << "failed to open video capture: " << video_path << std::endl;
+    }
+
+    if (headless) {
+        run_headless();
+        shutdown();
+        return 0;
+    }
+    #endif
+
     // SDL init
     if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO) < 0) {
         return -1;
@@ -108,35 +619,21 @@ int main(int argc, char* argv[]) {
         SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC
     );
 
-    texture = SDL_CreateTexture(
-        renderer,
-        SDL_PIXELFORMAT_ARGB8888,
-        SDL_TEXTUREACCESS_STREAMING,
-        256,
-        240
-    );
-
-    // preloaded rom
-    // TODO: in browser rom loading
-    std::string rom_path = "rom.nes"; 
-    if (argc > 1) rom_path = argv[1];
-
-    nes = std::make_shared<Bus>();
-    std::shared_ptr<Cartridge> cart = std::make_shared<Cartridge>(rom_path);
-
-    if (!cart->valid) {
-        std::cerr << "failed to load cartridge: " << rom_path << std::endl;
-        return -1;
-    }
-
-    nes->insert_cartridge(cart);
-    nes->reset();
+    #ifdef __EMSCRIPTEN__
+    video_pool = std::make_unique<ThreadPool>(1);
+    #else
+    video_pool = std::make_unique<ThreadPool>();
+    #endif
+    video_filter = std::make_unique<VideoFilter>(video_pool.get());
+    video_filter->set_palette(&nes->ppu.palette);
+    video_filter->set_type(filter_type);
+    create_texture();
 
     // audio setup
     SDL_AudioSpec want, have;
     SDL_zero(want);
     want.freq = 44100;
-    want.format = AUDIO_F32;
+    want.format = AUDIO_S16SYS;
     want.channels = 1;
     want.samples = 512;
     want.callback = audio_callback;
@@ -146,16 +643,29 @@ int main(int argc, char* argv[]) {
 
     #ifdef __EMSCRIPTEN__
     // 0 fps = let browser decide (60?), 1 = simulate infinite loop
-    emscripten_set_main_loop(main_loop, 0, 1);
+    emscripten_set_main_loop_arg(browser_frame, this, 0, 1);
     #else
-    while(running) {
-        main_loop();
+    std::thread emulation_thread(&Frontend::emulation_loop, this);
+    render_loop();
+    emulation_thread.join();
+
+    FramePacer::Stats stats = pacer.collect();
+    printf("last %.1fs: %.2f fps, frame jitter %.3f ms avg, %.3f ms sd, %.3f ms max, %llu late\n",
+           stats.frames / (stats.fps > 0.0 ? stats.fps : 1.0), stats.fps,
+           stats.jitter_avg_ms, stats.jitter_stddev_ms, stats.jitter_max_ms,
+           (unsigned long long) stats.late);
+    if (latency_count) {
+        printf("input latency (key change to $4016 strobe): %.2f ms avg, %.2f ms max over %llu changes\n",
+               latency_total_us / 1000.0 / latency_count, latency_max_us / 1000.0,
+               (unsigned long long) latency_count.load());
     }
     #endif
 
     if (audio_device) {
         SDL_CloseAudioDevice(audio_device);
     }
+
+    shutdown();
     SDL_DestroyTexture(texture);
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(window);
@@ -163,3 +673,9 @@ int main(int argc, char* argv[]) {
 
     return 0;
 }
+
+int main(int argc, char* argv[]) {
+    // large (frame buffers, audio rings), keep it off the stack
+    std::unique_ptr<Frontend> frontend = std::make_unique<Frontend>();
+    return frontend->run(argc, argv);
+}
@@ -0,0 +1,92 @@
+#include "mapped_file.hh"
+#include <cstdio>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define MAPPED_FILE_MMAP
+#endif
+
+MappedFile::MappedFile() {
+
+}
+
+MappedFile::~MappedFile() {
+  this->close();
+}
+
+MappedFile::MappedFile(MappedFile &&other) {
+  *this = std::move(other);
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) {
+  if (this != &other) {
+    this->close();
+    // a moved vector keeps its storage, so bytes stays valid
+    bytes = other.bytes;
+    length = other.length;
+    mapped = other.mapped;
+    buffer = std::move(other.buffer);
+    other.bytes = nullptr;
+    other.length = 0;
+    other.mapped = false;
+  }
+  return *this;
+}
+
+bool MappedFile::open(const std::string &path) {
+  this->close();
+
+  #ifdef MAPPED_FILE_MMAP
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) == 0 && st.st_size > 0) {
+    void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p != MAP_FAILED) {
+      bytes = (const uint8_t*) p;
+      length = st.st_size;
+      mapped = true;
+    }
+  }
+  ::close(fd);
+  if (bytes) {
+    return true;
+  }
+  #endif
+
+  FILE* f = fopen(path.c_str(), "rb");
+  if (!f) {
+    return false;
+  }
+  fseek(f, 0, SEEK_END);
+  long n = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  buffer.resize(n > 0 ? n : 0);
+  size_t got = fread(buffer.data(), 1, buffer.size(), f);
+  fclose(f);
+  if (got != buffer.size() || buffer.empty()) {
+    buffer.clear();
+    return false;
+  }
+  bytes = buffer.data();
+  length = buffer.size();
+  return true;
+}
+
+void MappedFile::close() {
+  #ifdef MAPPED_FILE_MMAP
+  if (mapped && bytes) {
+    munmap((void*) bytes, length);
+  }
+  #endif
+  mapped = false;
+  bytes = nullptr;
+  length = 0;
+  buffer.clear();
+}
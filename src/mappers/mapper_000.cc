@@ -1,8 +1,9 @@
 #include "mappers/mapper_000.hh"
+#include "mappers/mapper_registry.hh"
 #include "mappers/mapper_template.hh"
 #include <cstdint>
 
-Mapper_000::Mapper_000(uint8_t banks_PRG, uint8_t banks_CHR) : Mapper_Template(banks_PRG, banks_CHR) {
+Mapper_000::Mapper_000(uint16_t banks_PRG, uint16_t banks_CHR) : Mapper_Template(banks_PRG, banks_CHR) {
   
 }
 
@@ -44,3 +45,10 @@ bool Mapper_000::ppu_mapwrite(uint16_t addr, uint32_t &addr_mapped) {
   }
   return false;
 }
+
+static MapperRegistry::Registration registration({
+  0, "NROM", MapperRegistry::CHR_RAM, 2, 1,
+  [](const MapperRegistry::Board &board) -> std::shared_ptr<Mapper_Template> {
+    return std::make_shared<Mapper_000>(board.banks_PRG, board.banks_CHR);
+  }
+});
@@ -1,10 +1,10 @@
 #include "mappers/mapper_001.hh"
+#include "mappers/mapper_registry.hh"
 #include "mappers/mapper_template.hh"
 #include <cstdint>
 
-Mapper_001::Mapper_001(uint8_t banks_PRG, uint8_t banks_CHR, std::function<void(uint8_t)> cb)  
+Mapper_001::Mapper_001(uint16_t banks_PRG, uint16_t banks_CHR, std::function<void(uint8_t)> cb)  
   : Mapper_Template(banks_PRG, banks_CHR), mirror_callback(cb) {
-  prg_ram.resize(8*1024, 0x00);
   reset();
 }
 
@@ -169,3 +169,34 @@ bool Mapper_001::ppu_mapwrite(uint16_t addr, uint32_t &addr_mapped) {
   }
   return false;
 }
+
+void Mapper_001::save_state(StateWriter &w) const {
+  w.write(shift_register);
+  w.write(shift_count);
+  w.write(control_register);
+  w.write(chr_bank_0);
+  w.write(chr_bank_1);
+  w.write(prg_bank);
+  w.write(mirroring);
+  w.write(prg_bank_mode);
+  w.write(chr_bank_mode);
+}
+
+void Mapper_001::load_state(StateReader &r) {
+  r.read(shift_register);
+  r.read(shift_count);
+  r.read(control_register);
+  r.read(chr_bank_0);
+  r.read(chr_bank_1);
+  r.read(prg_bank);
+  r.read(mirroring);
+  r.read(prg_bank_mode);
+  r.read(chr_bank_mode);
+}
+
+static MapperRegistry::Registration registration({
+  1, "MMC1", MapperRegistry::PRG_RAM | MapperRegistry::CHR_RAM | MapperRegistry::BATTERY, 32, 16,
+  [](const MapperRegistry::Board &board) -> std::shared_ptr<Mapper_Template> {
+    return std::make_shared<Mapper_001>(board.banks_PRG, board.banks_CHR, board.set_mirror);
+  }
+});
@@ -0,0 +1,25 @@
+#include "mappers/mapper_002.hh"
+#include "mappers/mapper_registry.hh"
+
+Mapper_002::Mapper_002(uint16_t banks_PRG, uint16_t banks_CHR)
+  : Mapper_Discrete(banks_PRG, banks_CHR) {
+  apply();
+}
+
+Mapper_002::~Mapper_002() {
+}
+
+void Mapper_002::apply() {
+  set_prg_16k(0, latch);
+  set_prg_16k(1, banks_PRG - 1);
+  set_chr_8k(0);
+}
+
+static MapperRegistry::Registration registration({
+  2, "UxROM", MapperRegistry::CHR_RAM, 256, 1,
+  [](const MapperRegistry::Board &board) -> std::shared_ptr<Mapper_Template> {
+    std::shared_ptr<Mapper_002> mapper = std::make_shared<Mapper_002>(board.banks_PRG, board.banks_CHR);
+    mapper->set_submapper(board.submapper);
+    return mapper;
+  }
+});
@@ -0,0 +1,24 @@
+#include "mappers/mapper_003.hh"
+#include "mappers/mapper_registry.hh"
+
+Mapper_003::Mapper_003(uint16_t banks_PRG, uint16_t banks_CHR)
+  : Mapper_Discrete(banks_PRG, banks_CHR) {
+  apply();
+}
+
+Mapper_003::~Mapper_003() {
+}
+
+void Mapper_003::apply() {
+  set_prg_32k(0);
+  set_chr_8k(latch);
+}
+
+static MapperRegistry::Registration registration({
+  3, "CNROM", MapperRegistry::CHR_RAM, 2, 256,
+  [](const MapperRegistry::Board &board) -> std::shared_ptr<Mapper_Template> {
+    std::shared_ptr<Mapper_003> mapper = std::make_shared<Mapper_003>(board.banks_PRG, board.banks_CHR);
+    mapper->set_submapper(board.submapper);
+    return mapper;
+  }
+});
@@ -0,0 +1,183 @@
+#include "mappers/mapper_004.hh"
+#include "mappers/mapper_registry.hh"
+#include "mappers/mapper_template.hh"
+#include <cstdint>
+
+Mapper_004::Mapper_004(uint16_t banks_PRG, uint16_t banks_CHR, std::function<void(uint8_t)> cb)
+  : Mapper_Template(banks_PRG, banks_CHR), mirror_callback(cb) {
+  update_banks();
+}
+
+Mapper_004::~Mapper_004() {
+}
+
+void Mapper_004::update_banks() {
+  // 8kb prg banks, 1kb chr banks (chr ram is 8kb). the cartridge rejects
+  // roms without prg, a board built on its own maps everything to 0
+  if (banks_PRG == 0) {
+    return;
+  }
+  uint32_t n_prg = banks_PRG * 2;
+  uint32_t n_chr = banks_CHR ? banks_CHR * 8 : 8;
+
+  // prg mode 0: R6 at $8000, second to last bank fixed at $C000
+  // prg mode 1: the other way around. R7 and the last bank never move
+  uint32_t second_last = n_prg - 2;
+  bool prg_mode = bank_select & 0x40;
+  prg_offset[0] = (prg_mode ? second_last : registers[6] % n_prg) * 0x2000;
+  prg_offset[1] = (registers[7] % n_prg) * 0x2000;
+  prg_offset[2] = (prg_mode ? registers[6] % n_prg : second_last) * 0x2000;
+  prg_offset[3] = (n_prg - 1) * 0x2000;
+
+  // the two 2kb banks ignore their low bit. chr a12 inversion swaps the
+  // 2kb pair at $0000 with the 1kb banks at $1000
+  uint32_t banks[8] = {
+    (uint32_t) (registers[0] & 0xFE), (uint32_t) (registers[0] | 0x01),
+    (uint32_t) (registers[1] & 0xFE), (uint32_t) (registers[1] | 0x01),
+    registers[2], registers[3], registers[4], registers[5]
+  };
+  uint8_t invert = (bank_select & 0x80) ? 4 : 0;
+  for (int i = 0; i < 8; i++) {
+    chr_offset[i ^ invert] = (banks[i] % n_chr) * 0x0400;
+  }
+}
+
+bool Mapper_004::cpu_mapread(uint16_t addr, uint32_t &addr_mapped) {
+  // prg ram, open bus while disabled
+  if (addr >= 0x6000 && addr <= 0x7FFF) {
+    if (!(ram_protect & 0x80)) {
+      return false;
+    }
+    addr_mapped = addr & 0x1FFF;
+    return true;
+  }
+
+  if (addr >= 0x8000) {
+    addr_mapped = prg_offset[(addr >> 13) & 0x03] + (addr & 0x1FFF);
+    return true;
+  }
+  return false;
+}
+
+bool Mapper_004::cpu_mapwrite(uint16_t addr, uint32_t &addr_mapped, uint8_t data) {
+  if (addr >= 0x6000 && addr <= 0x7FFF) {
+    if ((ram_protect & 0xC0) != 0x80) {
+      return false;
+    }
+    addr_mapped = addr & 0x1FFF;
+    return true;
+  }
+
+  if (addr < 0x8000) {
+    return false;
+  }
+
+  // four register pairs, even and odd addresses in each 8kb range
+  bool odd = addr & 0x0001;
+  switch (addr & 0xE000) {
+    case 0x8000:
+      if (!odd) {
+        bank_select = data;
+      }
+      else {
+        registers[bank_select & 0x07] = data;
+      }
+      update_banks();
+      break;
+
+    case 0xA000:
+      if (!odd) {
+        // 0: vertical, 1: horizontal (the cartridge's mirror modes 2 and 3)
+        if (mirror_callback) {
+          mirror_callback((data & 0x01) ? 3 : 2);
+        }
+      }
+      else {
+        ram_protect = data;
+      }
+      break;
+
+    case 0xC000:
+      if (!odd) {
+        irq_latch = data;
+      }
+      else {
+        // the counter reloads on the next clock
+        irq_counter = 0;
+        irq_reload = true;
+      }
+      break;
+
+    case 0xE000:
+      if (!odd) {
+        // disabling also acknowledges a pending irq
+        irq_enable = false;
+        irq = false;
+      }
+      else {
+        irq_enable = true;
+      }
+      break;
+  }
+  // rom itself is never written
+  return false;
+}
+
+bool Mapper_004::ppu_mapread(uint16_t addr, uint32_t &addr_mapped) {
+  if (addr <= 0x1FFF) {
+    addr_mapped = chr_offset[addr >> 10] + (addr & 0x03FF);
+    return true;
+  }
+  return false;
+}
+
+bool Mapper_004::ppu_mapwrite(uint16_t addr, uint32_t &addr_mapped) {
+  if (addr <= 0x1FFF && banks_CHR == 0) {
+    addr_mapped = chr_offset[addr >> 10] + (addr & 0x03FF);
+    return true;
+  }
+  return false;
+}
+
+void Mapper_004::clock_scanline() {
+  if (irq_counter == 0 || irq_reload) {
+    irq_counter = irq_latch;
+    irq_reload = false;
+  }
+  else {
+    irq_counter--;
+  }
+  if (irq_counter == 0 && irq_enable) {
+    irq = true;
+  }
+}
+
+void Mapper_004::save_state(StateWriter &w) const {
+  w.write(bank_select);
+  w.write(registers);
+  w.write(ram_protect);
+  w.write(irq_latch);
+  w.write(irq_counter);
+  w.write(irq_reload);
+  w.write(irq_enable);
+  w.write(irq);
+}
+
+void Mapper_004::load_state(StateReader &r) {
+  r.read(bank_select);
+  r.read(registers);
+  r.read(ram_protect);
+  r.read(irq_latch);
+  r.read(irq_counter);
+  r.read(irq_reload);
+  r.read(irq_enable);
+  r.read(irq);
+  update_banks();
+}
+
+static MapperRegistry::Registration registration({
+  4, "MMC3", MapperRegistry::PRG_RAM | MapperRegistry::CHR_RAM | MapperRegistry::BATTERY | MapperRegistry::IRQ, 128, 32,
+  [](const MapperRegistry::Board &board) -> std::shared_ptr<Mapper_Template> {
+    return std::make_shared<Mapper_004>(board.banks_PRG, board.banks_CHR, board.set_mirror);
+  }
+});
@@ -0,0 +1,30 @@
+#include "mappers/mapper_007.hh"
+#include "mappers/mapper_registry.hh"
+
+Mapper_007::Mapper_007(uint16_t banks_PRG, uint16_t banks_CHR, std::function<void(uint8_t)> cb)
+  : Mapper_Discrete(banks_PRG, banks_CHR), mirror_callback(cb) {
+  // anrom, the common board, disables the rom during writes
+  bus_conflicts = false;
+  apply();
+}
+
+Mapper_007::~Mapper_007() {
+}
+
+void Mapper_007::apply() {
+  set_prg_32k(latch & 0x07);
+  set_chr_8k(0);
+  // reported like mmc1: 0 lower, 1 upper nametable
+  if (mirror_callback) {
+    mirror_callback((latch & 0x10) ? 1 : 0);
+  }
+}
+
+static MapperRegistry::Registration registration({
+  7, "AxROM", MapperRegistry::CHR_RAM, 16, 1,
+  [](const MapperRegistry::Board &board) -> std::shared_ptr<Mapper_Template> {
+    std::shared_ptr<Mapper_007> mapper = std::make_shared<Mapper_007>(board.banks_PRG, board.banks_CHR, board.set_mirror);
+    mapper->set_submapper(board.submapper);
+    return mapper;
+  }
+});
@@ -0,0 +1,22 @@
+#include "mappers/mapper_011.hh"
+#include "mappers/mapper_registry.hh"
+
+Mapper_011::Mapper_011(uint16_t banks_PRG, uint16_t banks_CHR)
+  : Mapper_Discrete(banks_PRG, banks_CHR) {
+  apply();
+}
+
+Mapper_011::~Mapper_011() {
+}
+
+void Mapper_011::apply() {
+  set_prg_32k(latch & 0x03);
+  set_chr_8k(latch >> 4);
+}
+
+static MapperRegistry::Registration registration({
+  11, "Color Dreams", 0, 8, 16,
+  [](const MapperRegistry::Board &board) -> std::shared_ptr<Mapper_Template> {
+    return std::make_shared<Mapper_011>(board.banks_PRG, board.banks_CHR);
+  }
+});
@@ -0,0 +1,22 @@
+#include "mappers/mapper_066.hh"
+#include "mappers/mapper_registry.hh"
+
+Mapper_066::Mapper_066(uint16_t banks_PRG, uint16_t banks_CHR)
+  : Mapper_Discrete(banks_PRG, banks_CHR) {
+  apply();
+}
+
+Mapper_066::~Mapper_066() {
+}
+
+void Mapper_066::apply() {
+  set_prg_32k((latch >> 4) & 0x03);
+  set_chr_8k(latch & 0x03);
+}
+
+static MapperRegistry::Registration registration({
+  66, "GxROM", 0, 8, 4,
+  [](const MapperRegistry::Board &board) -> std::shared_ptr<Mapper_Template> {
+    return std::make_shared<Mapper_066>(board.banks_PRG, board.banks_CHR);
+  }
+});
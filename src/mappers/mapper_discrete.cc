@@ -0,0 +1,76 @@
+#include "mappers/mapper_discrete.hh"
+#include <cstdint>
+
+Mapper_Discrete::Mapper_Discrete(uint16_t banks_PRG, uint16_t banks_CHR)
+  : Mapper_Template(banks_PRG, banks_CHR) {
+  // most of these boards let the rom drive the bus on writes
+  bus_conflicts = true;
+}
+
+Mapper_Discrete::~Mapper_Discrete() {
+}
+
+void Mapper_Discrete::set_submapper(uint8_t submapper) {
+  if (submapper == 1 || submapper == 2) {
+    bus_conflicts = submapper == 2;
+  }
+}
+
+void Mapper_Discrete::set_prg_16k(int window, uint32_t bank) {
+  // the cartridge never builds a board without prg, but a mapper made
+  // on its own mustn't divide by zero
+  prg_offset[window] = banks_PRG ? (bank % banks_PRG) * 0x4000 : 0;
+}
+
+void Mapper_Discrete::set_prg_32k(uint32_t bank) {
+  // a 16kb rom shows up in both halves
+  set_prg_16k(0, bank * 2);
+  set_prg_16k(1, bank * 2 + 1);
+}
+
+void Mapper_Discrete::set_chr_8k(uint32_t bank) {
+  // chr ram is a single 8kb bank
+  chr_offset = banks_CHR ? (bank % banks_CHR) * 0x2000 : 0;
+}
+
+bool Mapper_Discrete::cpu_mapread(uint16_t addr, uint32_t &addr_mapped) {
+  if (addr >= 0x8000) {
+    addr_mapped = prg_offset[(addr >> 14) & 0x01] + (addr & 0x3FFF);
+    return true;
+  }
+  return false;
+}
+
+bool Mapper_Discrete::cpu_mapwrite(uint16_t addr, uint32_t &addr_mapped, uint8_t data) {
+  if (addr >= 0x8000) {
+    latch = data;
+    apply();
+  }
+  // rom itself is never written
+  return false;
+}
+
+bool Mapper_Discrete::ppu_mapread(uint16_t addr, uint32_t &addr_mapped) {
+  if (addr <= 0x1FFF) {
+    addr_mapped = chr_offset + addr;
+    return true;
+  }
+  return false;
+}
+
+bool Mapper_Discrete::ppu_mapwrite(uint16_t addr, uint32_t &addr_mapped) {
+  if (addr <= 0x1FFF && banks_CHR == 0) {
+    addr_mapped = addr;
+    return true;
+  }
+  return false;
+}
+
+void Mapper_Discrete::save_state(StateWriter &w) const {
+  w.write(latch);
+}
+
+void Mapper_Discrete::load_state(StateReader &r) {
+  r.read(latch);
+  apply();
+}
@@ -0,0 +1,28 @@
+#include "mappers/mapper_registry.hh"
+#include <cstdio>
+#include <map>
+
+// built on first use, the registrations run in no particular order
+static std::map<uint16_t, MapperRegistry::Entry> &entries() {
+  static std::map<uint16_t, MapperRegistry::Entry> map;
+  return map;
+}
+
+MapperRegistry::Registration::Registration(const Entry &entry) {
+  if (!entries().emplace(entry.id, entry).second) {
+    fprintf(stderr, "mapper %u registered twice, keeping the first\n", entry.id);
+  }
+}
+
+const MapperRegistry::Entry* MapperRegistry::find(uint16_t id) {
+  auto it = entries().find(id);
+  return it == entries().end() ? nullptr : &it->second;
+}
+
+std::vector<MapperRegistry::Entry> MapperRegistry::all() {
+  std::vector<Entry> list;
+  for (const auto &it : entries()) {
+    list.push_back(it.second);
+  }
+  return list;
+}
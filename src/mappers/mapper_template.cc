@@ -1,8 +1,12 @@
 #include "mappers/mapper_template.hh"
 
-Mapper_Template::Mapper_Template(uint8_t banks_PRG, uint8_t banks_CHR) {
+Mapper_Template::Mapper_Template(uint16_t banks_PRG, uint16_t banks_CHR) {
   this->banks_CHR = banks_CHR;
   this->banks_PRG = banks_PRG;
 }
 
 Mapper_Template::~Mapper_Template() {}
+
+void Mapper_Template::save_state(StateWriter &w) const {}
+
+void Mapper_Template::load_state(StateReader &r) {}
@@ -2,105 +2,109 @@
 #include "bus.hh"
 #include <iostream>
 
+// one table shared by every cpu instance, built at compile time
+#define INST(name, opcode, addr, inst_cycles) { name, &CPU::opcode, &CPU::addr, inst_cycles }
+const CPU::Instruction CPU::lookup[256] = {
+  // 0x00
+  INST("BRK", BRK, IMM, 7),  INST("ORA", ORA, IDX, 6),  INST("???", XXX, IMP, 2),  INST("???", XXX, IMP, 8),
+  INST("???", NOP, IMP, 3),  INST("ORA", ORA, ZPG, 3),  INST("ASL", ASL, ZPG, 5),  INST("???", XXX, IMP, 5),
+  INST("PHP", PHP, IMP, 3),  INST("ORA", ORA, IMM, 2),  INST("ASL", ASL, IMP, 2),  INST("???", XXX, IMP, 2),
+  INST("???", NOP, IMP, 4),  INST("ORA", ORA, ABS, 4),  INST("ASL", ASL, ABS, 6),  INST("???", XXX, IMP, 6),
+
+  // 0x10
+  INST("BPL", BPL, REL, 2),  INST("ORA", ORA, IDY, 5),  INST("???", XXX, IMP, 2),  INST("???", XXX, IMP, 8),
+  INST("???", NOP, IMP, 4),  INST("ORA", ORA, ZPX, 4),  INST("ASL", ASL, ZPX, 6),  INST("???", XXX, IMP, 6),
+  INST("CLC", CLC, IMP, 2),  INST("ORA", ORA, ABY, 4),  INST("???", NOP, IMP, 2),  INST("???", XXX, IMP, 7),
+  INST("???", NOP, IMP, 4),  INST("ORA", ORA, ABX, 4),  INST("ASL", ASL, ABX, 7),  INST("???", XXX, IMP, 7),
+
+  // 0x20
+  INST("JSR", JSR, ABS, 6),  INST("AND", AND, IDX, 6),  INST("???", XXX, IMP, 2),  INST("???", XXX, IMP, 8),
+  INST("BIT", BIT, ZPG, 3),  INST("AND", AND, ZPG, 3),  INST("ROL", ROL, ZPG, 5),  INST("???", XXX, IMP, 5),
+  INST("PLP", PLP, IMP, 4),  INST("AND", AND, IMM, 2),  INST("ROL", ROL, IMP, 2),  INST("???", XXX, IMP, 2),
+  INST("BIT", BIT, ABS, 4),  INST("AND", AND, ABS, 4),  INST("ROL", ROL, ABS, 6),  INST("???", XXX, IMP, 6),
+
+  // 0x30
+  INST("BMI", BMI, REL, 2),  INST("AND", AND, IDY, 5),  INST("???", XXX, IMP, 2),  INST("???", XXX, IMP, 8),
+  INST("???", NOP, IMP, 4),  INST("AND", AND, ZPX, 4),  INST("ROL", ROL, ZPX, 6),  INST("???", XXX, IMP, 6),
+  INST("SEC", SEC, IMP, 2),  INST("AND", AND, ABY, 4),  INST("???", NOP, IMP, 2),  INST("???", XXX, IMP, 7),
+  INST("???", NOP, IMP, 4),  INST("AND", AND, ABX, 4),  INST("ROL", ROL, ABX, 7),  INST("???", XXX, IMP, 7),
+
+  // 0x40
+  INST("RTI", RTI, IMP, 6),  INST("EOR", EOR, IDX, 6),  INST("???", XXX, IMP, 2),  INST("???", XXX, IMP, 8),
+  INST("???", NOP, IMP, 3),  INST("EOR", EOR, ZPG, 3),  INST("LSR", LSR, ZPG, 5),  INST("???", XXX, IMP, 5),
+  INST("PHA", PHA, IMP, 3),  INST("EOR", EOR, IMM, 2),  INST("LSR", LSR, IMP, 2),  INST("???", XXX, IMP, 2),
+  INST("JMP", JMP, ABS, 3),  INST("EOR", EOR, ABS, 4),  INST("LSR", LSR, ABS, 6),  INST("???", XXX, IMP, 6),
+
+  // 0x50
+  INST("BVC", BVC, REL, 2),  INST("EOR", EOR, IDY, 5),  INST("???", XXX, IMP, 2),  INST("???", XXX, IMP, 8),
+  INST("???", NOP, IMP, 4),  INST("EOR", EOR, ZPX, 4),  INST("LSR", LSR, ZPX, 6),  INST("???", XXX, IMP, 6),
+  INST("CLI", CLI, IMP, 2),  INST("EOR", EOR, ABY, 4),  INST("???", NOP, IMP, 2),  INST("???", XXX, IMP, 7),
+  INST("???", NOP, IMP, 4),  INST("EOR", EOR, ABX, 4),  INST("LSR", LSR, ABX, 7),  INST("???", XXX, IMP, 7),
+
+  // 0x60
+  INST("RTS", RTS, IMP, 6),  INST("ADC", ADC, IDX, 6),  INST("???", XXX, IMP, 2),  INST("???", XXX, IMP, 8),
+  INST("???", NOP, IMP, 3),  INST("ADC", ADC, ZPG, 3),  INST("ROR", ROR, ZPG, 5),  INST("???", XXX, IMP, 5),
+  INST("PLA", PLA, IMP, 4),  INST("ADC", ADC, IMM, 2),  INST("ROR", ROR, IMP, 2),  INST("???", XXX, IMP, 2),
+  INST("JMP", JMP, IND, 5),  INST("ADC", ADC, ABS, 4),  INST("ROR", ROR, ABS, 6),  INST("???", XXX, IMP, 6),
+
+  // 0x70
+  INST("BVS", BVS, REL, 2),  INST("ADC", ADC, IDY, 5),  INST("???", XXX, IMP, 2),  INST("???", XXX, IMP, 8),
+  INST("???", NOP, IMP, 4),  INST("ADC", ADC, ZPX, 4),  INST("ROR", ROR, ZPX, 6),  INST("???", XXX, IMP, 6),
+  INST("SEI", SEI, IMP, 2),  INST("ADC", ADC, ABY, 4),  INST("???", NOP, IMP, 2),  INST("???", XXX, IMP, 7),
+  INST("???", NOP, IMP, 4),  INST("ADC", ADC, ABX, 4),  INST("ROR", ROR, ABX, 7),  INST("???", XXX, IMP, 7),
+
+  // 0x80
+  INST("???", NOP, IMP, 2),  INST("STA", STA, IDX, 6),  INST("???", NOP, IMP, 2),  INST("???", XXX, IMP, 6),
+  INST("STY", STY, ZPG, 3),  INST("STA", STA, ZPG, 3),  INST("STX", STX, ZPG, 3),  INST("???", XXX, IMP, 3),
+  INST("DEY", DEY, IMP, 2),  INST("???", NOP, IMP, 2),  INST("TXA", TXA, IMP, 2),  INST("???", XXX, IMP, 2),
+  INST("STY", STY, ABS, 4),  INST("STA", STA, ABS, 4),  INST("STX", STX, ABS, 4),  INST("???", XXX, IMP, 4),
+
+  // 0x90
+  INST("BCC", BCC, REL, 2),  INST("STA", STA, IDY, 6),  INST("???", XXX, IMP, 2),  INST("???", XXX, IMP, 6),
+  INST("STY", STY, ZPX, 4),  INST("STA", STA, ZPX, 4),  INST("STX", STX, ZPY, 4),  INST("???", XXX, IMP, 4),
+  INST("TYA", TYA, IMP, 2),  INST("STA", STA, ABY, 5),  INST("TXS", TXS, IMP, 2),  INST("???", XXX, IMP, 5),
+  INST("???", NOP, IMP, 5),  INST("STA", STA, ABX, 5),  INST("???", XXX, IMP, 5),  INST("???", XXX, IMP, 5),
+
+  // 0xA0
+  INST("LDY", LDY, IMM, 2),  INST("LDA", LDA, IDX, 6),  INST("LDX", LDX, IMM, 2),  INST("???", XXX, IMP, 6),
+  INST("LDY", LDY, ZPG, 3),  INST("LDA", LDA, ZPG, 3),  INST("LDX", LDX, ZPG, 3),  INST("???", XXX, IMP, 3),
+  INST("TAY", TAY, IMP, 2),  INST("LDA", LDA, IMM, 2),  INST("TAX", TAX, IMP, 2),  INST("???", XXX, IMP, 2),
+  INST("LDY", LDY, ABS, 4),  INST("LDA", LDA, ABS, 4),  INST("LDX", LDX, ABS, 4),  INST("???", XXX, IMP, 4),
+
+  // 0xB0
+  INST("BCS", BCS, REL, 2),  INST("LDA", LDA, IDY, 5),  INST("???", XXX, IMP, 2),  INST("???", XXX, IMP, 5),
+  INST("LDY", LDY, ZPX, 4),  INST("LDA", LDA, ZPX, 4),  INST("LDX", LDX, ZPY, 4),  INST("???", XXX, IMP, 4),
+  INST("CLV", CLV, IMP, 2),  INST("LDA", LDA, ABY, 4),  INST("TSX", TSX, IMP, 2),  INST("???", XXX, IMP, 4),
+  INST("LDY", LDY, ABX, 4),  INST("LDA", LDA, ABX, 4),  INST("LDX", LDX, ABY, 4),  INST("???", XXX, IMP, 4),
+
+  // 0xC0
+  INST("CPY", CPY, IMM, 2),  INST("CMP", CMP, IDX, 6),  INST("???", NOP, IMP, 2),  INST("???", XXX, IMP, 8),
+  INST("CPY", CPY, ZPG, 3),  INST("CMP", CMP, ZPG, 3),  INST("DEC", DEC, ZPG, 5),  INST("???", XXX, IMP, 5),
+  INST("INY", INY, IMP, 2),  INST("CMP", CMP, IMM, 2),  INST("DEX", DEX, IMP, 2),  INST("???", XXX, IMP, 2),
+  INST("CPY", CPY, ABS, 4),  INST("CMP", CMP, ABS, 4),  INST("DEC", DEC, ABS, 6),  INST("???", XXX, IMP, 6),
+
+  // 0xD0
+  INST("BNE", BNE, REL, 2),  INST("CMP", CMP, IDY, 5),  INST("???", XXX, IMP, 2),  INST("???", XXX, IMP, 8),
+  INST("???", NOP, IMP, 4),  INST("CMP", CMP, ZPX, 4),  INST("DEC", DEC, ZPX, 6),  INST("???", XXX, IMP, 6),
+  INST("CLD", CLD, IMP, 2),  INST("CMP", CMP, ABY, 4),  INST("NOP", NOP, IMP, 2),  INST("???", XXX, IMP, 7),
+  INST("???", NOP, IMP, 4),  INST("CMP", CMP, ABX, 4),  INST("DEC", DEC, ABX, 7),  INST("???", XXX, IMP, 7),
+
+  // 0xE0
+  INST("CPX", CPX, IMM, 2),  INST("SBC", SBC, IDX, 6),  INST("???", NOP, IMP, 2),  INST("???", XXX, IMP, 8),
+  INST("CPX", CPX, ZPG, 3),  INST("SBC", SBC, ZPG, 3),  INST("INC", INC, ZPG, 5),  INST("???", XXX, IMP, 5),
+  INST("INX", INX, IMP, 2),  INST("SBC", SBC, IMM, 2),  INST("NOP", NOP, IMP, 2),  INST("???", SBC, IMP, 2),
+  INST("CPX", CPX, ABS, 4),  INST("SBC", SBC, ABS, 4),  INST("INC", INC, ABS, 6),  INST("???", XXX, IMP, 6),
+
+  // 0xF0
+  INST("BEQ", BEQ, REL, 2),  INST("SBC", SBC, IDY, 5),  INST("???", XXX, IMP, 2),  INST("???", XXX, IMP, 8),
+  INST("???", NOP, IMP, 4),  INST("SBC", SBC, ZPX, 4),  INST("INC", INC, ZPX, 6),  INST("???", XXX, IMP, 6),
+  INST("SED", SED, IMP, 2),  INST("SBC", SBC, ABY, 4),  INST("NOP", NOP, IMP, 2),  INST("???", XXX, IMP, 7),
+  INST("???", NOP, IMP, 4),  INST("SBC", SBC, ABX, 4),  INST("INC", INC, ABX, 7),  INST("???", XXX, IMP, 7)
+};
+#undef INST
+
 CPU::CPU() {
-  #define INST(name, opcode, addr, inst_cycles) { name, &CPU::opcode, &CPU::addr, inst_cycles }
-  lookup = {
-    // 0x00
-    INST("BRK", BRK, IMM, 7),  INST("ORA", ORA, IDX, 6),  INST("???", XXX, IMP, 2),  INST("???", XXX, IMP, 8),
-    INST("???", NOP, IMP, 3),  INST("ORA", ORA, ZPG, 3),  INST("ASL", ASL, ZPG, 5),  INST("???", XXX, IMP, 5),
-    INST("PHP", PHP, IMP, 3),  INST("ORA", ORA, IMM, 2),  INST("ASL", ASL, IMP, 2),  INST("???", XXX, IMP, 2),
-    INST("???", NOP, IMP, 4),  INST("ORA", ORA, ABS, 4),  INST("ASL", ASL, ABS, 6),  INST("???", XXX, IMP, 6),
-
-    // 0x10
-    INST("BPL", BPL, REL, 2),  INST("ORA", ORA, IDY, 5),  INST("???", XXX, IMP, 2),  INST("???", XXX, IMP, 8),
-    INST("???", NOP, IMP, 4),  INST("ORA", ORA, ZPX, 4),  INST("ASL", ASL, ZPX, 6),  INST("???", XXX, IMP, 6),
-    INST("CLC", CLC, IMP, 2),  INST("ORA", ORA, ABY, 4),  INST("???", NOP, IMP, 2),  INST("???", XXX, IMP, 7),
-    INST("???", NOP, IMP, 4),  INST("ORA", ORA, ABX, 4),  INST("ASL", ASL, ABX, 7),  INST("???", XXX, IMP, 7),
-
-    // 0x20
-    INST("JSR", JSR, ABS, 6),  INST("AND", AND, IDX, 6),  INST("???", XXX, IMP, 2),  INST("???", XXX, IMP, 8),
-    INST("BIT", BIT, ZPG, 3),  INST("AND", AND, ZPG, 3),  INST("ROL", ROL, ZPG, 5),  INST("???", XXX, IMP, 5),
-    INST("PLP", PLP, IMP, 4),  INST("AND", AND, IMM, 2),  INST("ROL", ROL, IMP, 2),  INST("???", XXX, IMP, 2),
-    INST("BIT", BIT, ABS, 4),  INST("AND", AND, ABS, 4),  INST("ROL", ROL, ABS, 6),  INST("???", XXX, IMP, 6),
-
-    // 0x30
-    INST("BMI", BMI, REL, 2),  INST("AND", AND, IDY, 5),  INST("???", XXX, IMP, 2),  INST("???", XXX, IMP, 8),
-    INST("???", NOP, IMP, 4),  INST("AND", AND, ZPX, 4),  INST("ROL", ROL, ZPX, 6),  INST("???", XXX, IMP, 6),
-    INST("SEC", SEC, IMP, 2),  INST("AND", AND, ABY, 4),  INST("???", NOP, IMP, 2),  INST("???", XXX, IMP, 7),
-    INST("???", NOP, IMP, 4),  INST("AND", AND, ABX, 4),  INST("ROL", ROL, ABX, 7),  INST("???", XXX, IMP, 7),
-
-    // 0x40
-    INST("RTI", RTI, IMP, 6),  INST("EOR", EOR, IDX, 6),  INST("???", XXX, IMP, 2),  INST("???", XXX, IMP, 8),
-    INST("???", NOP, IMP, 3),  INST("EOR", EOR, ZPG, 3),  INST("LSR", LSR, ZPG, 5),  INST("???", XXX, IMP, 5),
-    INST("PHA", PHA, IMP, 3),  INST("EOR", EOR, IMM, 2),  INST("LSR", LSR, IMP, 2),  INST("???", XXX, IMP, 2),
-    INST("JMP", JMP, ABS, 3),  INST("EOR", EOR, ABS, 4),  INST("LSR", LSR, ABS, 6),  INST("???", XXX, IMP, 6),
-
-    // 0x50
-    INST("BVC", BVC, REL, 2),  INST("EOR", EOR, IDY, 5),  INST("???", XXX, IMP, 2),  INST("???", XXX, IMP, 8),
-    INST("???", NOP, IMP, 4),  INST("EOR", EOR, ZPX, 4),  INST("LSR", LSR, ZPX, 6),  INST("???", XXX, IMP, 6),
-    INST("CLI", CLI, IMP, 2),  INST("EOR", EOR, ABY, 4),  INST("???", NOP, IMP, 2),  INST("???", XXX, IMP, 7),
-    INST("???", NOP, IMP, 4),  INST("EOR", EOR, ABX, 4),  INST("LSR", LSR, ABX, 7),  INST("???", XXX, IMP, 7),
-
-    // 0x60
-    INST("RTS", RTS, IMP, 6),  INST("ADC", ADC, IDX, 6),  INST("???", XXX, IMP, 2),  INST("???", XXX, IMP, 8),
-    INST("???", NOP, IMP, 3),  INST("ADC", ADC, ZPG, 3),  INST("ROR", ROR, ZPG, 5),  INST("???", XXX, IMP, 5),
-    INST("PLA", PLA, IMP, 4),  INST("ADC", ADC, IMM, 2),  INST("ROR", ROR, IMP, 2),  INST("???", XXX, IMP, 2),
-    INST("JMP", JMP, IND, 5),  INST("ADC", ADC, ABS, 4),  INST("ROR", ROR, ABS, 6),  INST("???", XXX, IMP, 6),
-
-    // 0x70
-    INST("BVS", BVS, REL, 2),  INST("ADC", ADC, IDY, 5),  INST("???", XXX, IMP, 2),  INST("???", XXX, IMP, 8),
-    INST("???", NOP, IMP, 4),  INST("ADC", ADC, ZPX, 4),  INST("ROR", ROR, ZPX, 6),  INST("???", XXX, IMP, 6),
-    INST("SEI", SEI, IMP, 2),  INST("ADC", ADC, ABY, 4),  INST("???", NOP, IMP, 2),  INST("???", XXX, IMP, 7),
-    INST("???", NOP, IMP, 4),  INST("ADC", ADC, ABX, 4),  INST("ROR", ROR, ABX, 7),  INST("???", XXX, IMP, 7),
-
-    // 0x80
-    INST("???", NOP, IMP, 2),  INST("STA", STA, IDX, 6),  INST("???", NOP, IMP, 2),  INST("???", XXX, IMP, 6),
-    INST("STY", STY, ZPG, 3),  INST("STA", STA, ZPG, 3),  INST("STX", STX, ZPG, 3),  INST("???", XXX, IMP, 3),
-    INST("DEY", DEY, IMP, 2),  INST("???", NOP, IMP, 2),  INST("TXA", TXA, IMP, 2),  INST("???", XXX, IMP, 2),
-    INST("STY", STY, ABS, 4),  INST("STA", STA, ABS, 4),  INST("STX", STX, ABS, 4),  INST("???", XXX, IMP, 4),
-
-    // 0x90
-    INST("BCC", BCC, REL, 2),  INST("STA", STA, IDY, 6),  INST("???", XXX, IMP, 2),  INST("???", XXX, IMP, 6),
-    INST("STY", STY, ZPX, 4),  INST("STA", STA, ZPX, 4),  INST("STX", STX, ZPY, 4),  INST("???", XXX, IMP, 4),
-    INST("TYA", TYA, IMP, 2),  INST("STA", STA, ABY, 5),  INST("TXS", TXS, IMP, 2),  INST("???", XXX, IMP, 5),
-    INST("???", NOP, IMP, 5),  INST("STA", STA, ABX, 5),  INST("???", XXX, IMP, 5),  INST("???", XXX, IMP, 5),
-
-    // 0xA0
-    INST("LDY", LDY, IMM, 2),  INST("LDA", LDA, IDX, 6),  INST("LDX", LDX, IMM, 2),  INST("???", XXX, IMP, 6),
-    INST("LDY", LDY, ZPG, 3),  INST("LDA", LDA, ZPG, 3),  INST("LDX", LDX, ZPG, 3),  INST("???", XXX, IMP, 3),
-    INST("TAY", TAY, IMP, 2),  INST("LDA", LDA, IMM, 2),  INST("TAX", TAX, IMP, 2),  INST("???", XXX, IMP, 2),
-    INST("LDY", LDY, ABS, 4),  INST("LDA", LDA, ABS, 4),  INST("LDX", LDX, ABS, 4),  INST("???", XXX, IMP, 4),
-
-    // 0xB0
-    INST("BCS", BCS, REL, 2),  INST("LDA", LDA, IDY, 5),  INST("???", XXX, IMP, 2),  INST("???", XXX, IMP, 5),
-    INST("LDY", LDY, ZPX, 4),  INST("LDA", LDA, ZPX, 4),  INST("LDX", LDX, ZPY, 4),  INST("???", XXX, IMP, 4),
-    INST("CLV", CLV, IMP, 2),  INST("LDA", LDA, ABY, 4),  INST("TSX", TSX, IMP, 2),  INST("???", XXX, IMP, 4),
-    INST("LDY", LDY, ABX, 4),  INST("LDA", LDA, ABX, 4),  INST("LDX", LDX, ABY, 4),  INST("???", XXX, IMP, 4),
-
-    // 0xC0
-    INST("CPY", CPY, IMM, 2),  INST("CMP", CMP, IDX, 6),  INST("???", NOP, IMP, 2),  INST("???", XXX, IMP, 8),
-    INST("CPY", CPY, ZPG, 3),  INST("CMP", CMP, ZPG, 3),  INST("DEC", DEC, ZPG, 5),  INST("???", XXX, IMP, 5),
-    INST("INY", INY, IMP, 2),  INST("CMP", CMP, IMM, 2),  INST("DEX", DEX, IMP, 2),  INST("???", XXX, IMP, 2),
-    INST("CPY", CPY, ABS, 4),  INST("CMP", CMP, ABS, 4),  INST("DEC", DEC, ABS, 6),  INST("???", XXX, IMP, 6),
-
-    // 0xD0
-    INST("BNE", BNE, REL, 2),  INST("CMP", CMP, IDY, 5),  INST("???", XXX, IMP, 2),  INST("???", XXX, IMP, 8),
-    INST("???", NOP, IMP, 4),  INST("CMP", CMP, ZPX, 4),  INST("DEC", DEC, ZPX, 6),  INST("???", XXX, IMP, 6),
-    INST("CLD", CLD, IMP, 2),  INST("CMP", CMP, ABY, 4),  INST("NOP", NOP, IMP, 2),  INST("???", XXX, IMP, 7),
-    INST("???", NOP, IMP, 4),  INST("CMP", CMP, ABX, 4),  INST("DEC", DEC, ABX, 7),  INST("???", XXX, IMP, 7),
-
-    // 0xE0
-    INST("CPX", CPX, IMM, 2),  INST("SBC", SBC, IDX, 6),  INST("???", NOP, IMP, 2),  INST("???", XXX, IMP, 8),
-    INST("CPX", CPX, ZPG, 3),  INST("SBC", SBC, ZPG, 3),  INST("INC", INC, ZPG, 5),  INST("???", XXX, IMP, 5),
-    INST("INX", INX, IMP, 2),  INST("SBC", SBC, IMM, 2),  INST("NOP", NOP, IMP, 2),  INST("???", SBC, IMP, 2),
-    INST("CPX", CPX, ABS, 4),  INST("SBC", SBC, ABS, 4),  INST("INC", INC, ABS, 6),  INST("???", XXX, IMP, 6),
-
-    // 0xF0
-    INST("BEQ", BEQ, REL, 2),  INST("SBC", SBC, IDY, 5),  INST("???", XXX, IMP, 2),  INST("???", XXX, IMP, 8),
-    INST("???", NOP, IMP, 4),  INST("SBC", SBC, ZPX, 4),  INST("INC", INC, ZPX, 6),  INST("???", XXX, IMP, 6),
-    INST("SED", SED, IMP, 2),  INST("SBC", SBC, ABY, 4),  INST("NOP", NOP, IMP, 2),  INST("???", XXX, IMP, 7),
-    INST("???", NOP, IMP, 4),  INST("SBC", SBC, ABX, 4),  INST("INC", INC, ABX, 7),  INST("???", XXX, IMP, 7)
-  };
+
 }
 
 CPU::~CPU() {}
@@ -152,18 +156,18 @@ void CPU::fetch() {
   }
   // return m;
 }
-int ii = 0;
+
 void CPU::clk() {
   if (inst_cycles == 0) {
     opcode = read(pc++);
-    CPU::Instruction inst = lookup[opcode];
+    const CPU::Instruction &inst = lookup[opcode];
 
     #ifdef DEBUG
-    if (!(ii%1000)) {
+    if (!(debug_count%1000)) {
       std::cout << "Inst: " << inst.inst_name << " PC: " << pc << " A: " << +a << " X: " << +x << " Y: " << +y 
       <<  '\n';
-      ii = 0;
-    } ii++;
+      debug_count = 0;
+    } debug_count++;
     #endif
     
     inst_cycles = inst.inst_cycles;
@@ -1055,3 +1059,27 @@ uint8_t CPU::TYA() {
 uint8_t CPU::XXX() {
   return 0;
 }
+
+void CPU::save_state(StateWriter &w) const {
+  w.write(a); w.write(x); w.write(y);
+  w.write(sp); w.write(pc); w.write(psr);
+  w.write(opcode);
+  w.write(addr);
+  w.write(addr_branch);
+  w.write(disp);
+  w.write(cycles);
+  w.write(inst_cycles);
+  w.write(m);
+}
+
+void CPU::load_state(StateReader &r) {
+  r.read(a); r.read(x); r.read(y);
+  r.read(sp); r.read(pc); r.read(psr);
+  r.read(opcode);
+  r.read(addr);
+  r.read(addr_branch);
+  r.read(disp);
+  r.read(cycles);
+  r.read(inst_cycles);
+  r.read(m);
+}
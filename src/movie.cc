@@ -0,0 +1,283 @@
+#include "movie.hh"
+#include <algorithm>
+#include <cstring>
+
+static const char MOVIE_MAGIC[8] = {'N', 'E', 'S', 'M', 'O', 'V', 'I', 'E'};
+static const uint32_t MOVIE_VERSION = 1;
+static const size_t HEADER_SIZE = 8 + 4 + 8 + 4;
+// the header stores the start state's size in 32 bits, no state is larger
+static const uint64_t MAX_STATE_SIZE = 0xFFFFFFFF;
+
+static const size_t FILE_BUF_SIZE = 1 << 20;
+
+enum RecordKind {
+  RECORD_INPUT = 0,
+  RECORD_KEYFRAME = 1
+};
+
+static void put_le(FILE* f, uint64_t v, int bytes) {
+  uint8_t b[8];
+  for (int i = 0; i < bytes; i++) {
+    b[i] = (uint8_t) (v >> (8 * i));
+  }
+  fwrite(b, 1, bytes, f);
+}
+
+static uint64_t get_le(const uint8_t* p, int bytes) {
+  uint64_t v = 0;
+  for (int i = 0; i < bytes; i++) {
+    v |= (uint64_t) p[i] << (8 * i);
+  }
+  return v;
+}
+
+MovieWriter::MovieWriter() {
+
+}
+
+MovieWriter::~MovieWriter() {
+  this->close();
+}
+
+bool MovieWriter::open(const std::string &path, uint64_t rom_hash, const std::vector<uint8_t> &start_state) {
+  this->close();
+  file = fopen(path.c_str(), "wb");
+  if (!file) {
+    return false;
+  }
+  // append only, records go out in large writes
+  setvbuf(file, nullptr, _IOFBF, FILE_BUF_SIZE);
+
+  fwrite(MOVIE_MAGIC, 1, sizeof(MOVIE_MAGIC), file);
+  put_le(file, MOVIE_VERSION, 4);
+  put_le(file, rom_hash, 8);
+  put_le(file, start_state.size(), 4);
+  fwrite(start_state.data(), 1, start_state.size(), file);
+
+  last_frame = 0;
+  end_frame = 0;
+  input[0] = input[1] = 0x00;
+  return true;
+}
+
+void MovieWriter::close() {
+  if (file) {
+    // trailing frames that kept the same input still count
+    if (end_frame > last_frame) {
+      this->put_record(end_frame, RECORD_INPUT);
+      fwrite(input, 1, 2, file);
+    }
+    fclose(file);
+    file = nullptr;
+  }
+}
+
+void MovieWriter::put_varint(uint64_t v) {
+  // 7 bits per byte, high bit set on all but the last
+  uint8_t b[10];
+  int n = 0;
+  do {
+    b[n] = v & 0x7F;
+    v >>= 7;
+    if (v) {
+      b[n] |= 0x80;
+    }
+    n++;
+  } while (v);
+  fwrite(b, 1, n, file);
+}
+
+void MovieWriter::put_record(uint64_t frame, int kind) {
+  uint64_t delta = frame >= last_frame ? frame - last_frame : 0;
+  this->put_varint((delta << 1) | kind);
+  last_frame += delta;
+}
+
+void MovieWriter::record(uint64_t frame, uint8_t port0, uint8_t port1) {
+  end_frame = std::max(end_frame, frame);
+  if (!file || (port0 == input[0] && port1 == input[1])) {
+    return;
+  }
+  this->put_record(frame, RECORD_INPUT);
+  uint8_t ports[2] = {port0, port1};
+  fwrite(ports, 1, 2, file);
+  input[0] = port0;
+  input[1] = port1;
+}
+
+void MovieWriter::keyframe(uint64_t frame, const std::vector<uint8_t> &state) {
+  if (!file) {
+    return;
+  }
+  this->put_record(frame, RECORD_KEYFRAME);
+  fwrite(input, 1, 2, file);
+  this->put_varint(state.size());
+  fwrite(state.data(), 1, state.size(), file);
+}
+
+MovieReader::MovieReader() {
+
+}
+
+MovieReader::~MovieReader() {
+  this->close();
+}
+
+bool MovieReader::open(const std::string &path) {
+  this->close();
+
+  if (!file.open(path)) {
+    return false;
+  }
+  data = file.data();
+  size = file.size();
+
+  if (size < HEADER_SIZE || memcmp(data, MOVIE_MAGIC, sizeof(MOVIE_MAGIC)) != 0
+   || get_le(data + 8, 4) != MOVIE_VERSION) {
+    this->close();
+    return false;
+  }
+  rom_hash = get_le(data + 12, 8);
+  start_state_size = get_le(data + 20, 4);
+  if (start_state_size > size - HEADER_SIZE) {
+    this->close();
+    return false;
+  }
+  start_state = data + HEADER_SIZE;
+  records_start = HEADER_SIZE + start_state_size;
+
+  if (!this->build_index()) {
+    this->close();
+    return false;
+  }
+  pos = records_start;
+  pos_frame = 0;
+  current[0] = current[1] = 0x00;
+  return true;
+}
+
+void MovieReader::close() {
+  file.close();
+  data = nullptr;
+  size = 0;
+  start_state = nullptr;
+  start_state_size = 0;
+  keyframes.clear();
+  last_frame = 0;
+}
+
+bool MovieReader::get_varint(size_t &p, uint64_t &v) const {
+  v = 0;
+  for (int shift = 0; shift < 64 && p < size; shift += 7) {
+    uint8_t b = data[p++];
+    v |= (uint64_t) (b & 0x7F) << shift;
+    if (!(b & 0x80)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool MovieReader::next_record(size_t &p, uint64_t &frame, int &kind, uint8_t ports[2],
+                              size_t &state_offset, size_t &state_size) const {
+  size_t q = p;
+  uint64_t tag;
+  if (!this->get_varint(q, tag) || q + 2 > size) {
+    return false;
+  }
+  frame += tag >> 1;
+  kind = tag & 1;
+  ports[0] = data[q];
+  ports[1] = data[q + 1];
+  q += 2;
+
+  state_offset = 0;
+  state_size = 0;
+  if (kind == RECORD_KEYFRAME) {
+    // a damaged size near 2^64 would wrap q + n, compare against what's left
+    uint64_t n;
+    if (!this->get_varint(q, n) || n > MAX_STATE_SIZE || n > size - q) {
+      return false;
+    }
+    state_offset = q;
+    state_size = n;
+    q += n;
+  }
+  p = q;
+  return true;
+}
+
+// one pass over the record headers, keyframe states are skipped not read
+// a record cut off at the end (crashed recording) just ends the movie
+bool MovieReader::build_index() {
+  size_t p = records_start;
+  uint64_t frame = 0;
+  int kind;
+  uint8_t ports[2];
+  size_t state_offset, state_size;
+
+  while (this->next_record(p, frame, kind, ports, state_offset, state_size)) {
+    if (kind == RECORD_KEYFRAME) {
+      keyframes.push_back({frame, {ports[0], ports[1]}, state_offset, state_size, p});
+    }
+    last_frame = frame;
+  }
+  return true;
+}
+
+void MovieReader::input(uint64_t frame, uint8_t &port0, uint8_t &port1) {
+  while (true) {
+    size_t p = pos;
+    uint64_t record_frame = pos_frame;
+    int kind;
+    uint8_t ports[2];
+    size_t state_offset, state_size;
+    if (!this->next_record(p, record_frame, kind, ports, state_offset, state_size) || record_frame > frame) {
+      break;
+    }
+    pos = p;
+    pos_frame = record_frame;
+    current[0] = ports[0];
+    current[1] = ports[1];
+  }
+  port0 = current[0];
+  port1 = current[1];
+}
+
+bool MovieReader::seek(uint64_t frame, uint64_t &key_frame, const uint8_t* &state, size_t &state_size) {
+  // keyframes are in frame order
+  const Keyframe* best = nullptr;
+  size_t lo = 0, hi = keyframes.size();
+  while (lo < hi) {
+    size_t mid = (lo + hi) / 2;
+    if (keyframes[mid].frame <= frame) {
+      best = &keyframes[mid];
+      lo = mid + 1;
+    }
+    else {
+      hi = mid;
+    }
+  }
+
+  if (!best) {
+    pos = records_start;
+    pos_frame = 0;
+    current[0] = current[1] = 0x00;
+    return false;
+  }
+
+  pos = best->next;
+  pos_frame = best->frame;
+  current[0] = best->ports[0];
+  current[1] = best->ports[1];
+  key_frame = best->frame;
+  state = data + best->state_offset;
+  state_size = best->state_size;
+  return true;
+}
+
+void MovieReader::keyframe(size_t i, uint64_t &frame, const uint8_t* &state, size_t &state_size) const {
+  frame = keyframes[i].frame;
+  state = data + keyframes[i].state_offset;
+  state_size = keyframes[i].state_size;
+}
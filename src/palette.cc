@@ -0,0 +1,91 @@
+#include "palette.hh"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#endif
+
+Palette::Palette() {
+  for (int i = 0; i < 64; i++) {
+    base[i][0] = base[i][1] = base[i][2] = 0;
+  }
+  #if defined(__x86_64__) && defined(__GNUC__)
+  __builtin_cpu_init();
+  use_avx2 = __builtin_cpu_supports("avx2");
+  #endif
+  this->update();
+}
+
+Palette::~Palette() {
+
+}
+
+void Palette::set_colour(uint8_t index, uint8_t r, uint8_t g, uint8_t b) {
+  base[index & 0x3F][0] = r;
+  base[index & 0x3F][1] = g;
+  base[index & 0x3F][2] = b;
+}
+
+void Palette::update() {
+  // each emphasis bit darkens the two other channels
+  // (~0.816 is the usual approximation of the 2C02's attenuation)
+  const float attenuate = 0.816f;
+
+  for (int i = 0; i < SIZE; i++) {
+    uint8_t colour = i & 0x3F;
+    uint8_t emphasis = (i >> 6) & 0x07;
+    float rgb[3] = {(float) base[colour][0], (float) base[colour][1], (float) base[colour][2]};
+
+    // columns $xE/$xF are black and stay black
+    if ((colour & 0x0E) != 0x0E) {
+      for (int c = 0; c < 3; c++) {
+        // bit 0 = red, bit 1 = green, bit 2 = blue
+        if (emphasis & (1 << c)) {
+          for (int o = 0; o < 3; o++) {
+            if (o != c) {
+              rgb[o] *= attenuate;
+            }
+          }
+        }
+      }
+    }
+
+    argb[i] = 0xFF000000
+            | ((uint32_t) rgb[0] << 16)
+            | ((uint32_t) rgb[1] << 8)
+            |  (uint32_t) rgb[2];
+  }
+}
+
+void Palette::to_argb(const uint16_t* index, uint32_t* out, int n) const {
+  #if defined(__x86_64__) && defined(__GNUC__)
+  if (use_avx2) {
+    this->to_argb_avx2(index, out, n);
+    return;
+  }
+  #endif
+  this->to_argb_scalar(index, out, n);
+}
+
+void Palette::to_argb_scalar(const uint16_t* index, uint32_t* out, int n) const {
+  for (int i = 0; i < n; i++) {
+    out[i] = argb[index[i] & (SIZE - 1)];
+  }
+}
+
+#if defined(__x86_64__) && defined(__GNUC__)
+__attribute__((target("avx2")))
+void Palette::to_argb_avx2(const uint16_t* index, uint32_t* out, int n) const {
+  const __m256i mask = _mm256_set1_epi32(SIZE - 1);
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m128i idx16 = _mm_loadu_si128((const __m128i*) (index + i));
+    __m256i idx = _mm256_and_si256(_mm256_cvtepu16_epi32(idx16), mask);
+    __m256i px = _mm256_i32gather_epi32((const int*) argb, idx, 4);
+    _mm256_storeu_si256((__m256i*) (out + i), px);
+  }
+  // tail
+  for (; i < n; i++) {
+    out[i] = argb[index[i] & (SIZE - 1)];
+  }
+}
+#endif
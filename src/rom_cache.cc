@@ -0,0 +1,168 @@
+#include "rom_cache.hh"
+#include <cstring>
+#include <tuple>
+#include <utility>
+
+#include "archive.hh"
+#include "hash64.hh"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/stat.h>
+#define ROM_CACHE_STAT
+#endif
+
+std::shared_ptr<const RomImage> RomImage::load(const std::string &path) {
+  MappedFile file;
+  if (!file.open(path)) {
+    return nullptr;
+  }
+  return load(std::move(file));
+}
+
+std::shared_ptr<const RomImage> RomImage::load(MappedFile &&file) {
+  std::shared_ptr<RomImage> image = std::make_shared<RomImage>();
+  const uint8_t* data = file.data();
+  size_t size = file.size();
+
+  if (Archive::detect(data, size) != Archive::NONE) {
+    // inflated straight into the buffer the views point at
+    if (!Archive::extract_rom(data, size, image->bytes)) {
+      return nullptr;
+    }
+    file.close();
+    data = image->bytes.data();
+    size = image->bytes.size();
+  }
+
+  if (!RomInfo::parse(data, size, image->info)) {
+    return nullptr;
+  }
+  size_t pos = image->info.rom_offset;
+  image->prg_size = image->info.prg_rom_size;
+  image->chr_size = image->info.chr_rom_size;
+
+  size_t end = pos + image->prg_size + image->chr_size;
+  if (end > size) {
+    // a short file leaves the rest of the rom zeroed
+    if (image->bytes.empty()) {
+      image->bytes.assign(data, data + size);
+    }
+    image->bytes.resize(end);
+    data = image->bytes.data();
+  }
+  image->prg = data + pos;
+  if (image->chr_size) {
+    image->chr = image->prg + image->prg_size;
+  }
+  image->file = std::move(file);
+  return image;
+}
+
+uint64_t RomImage::rom_hash() const {
+  // cartridges on other threads may ask for it at the same time
+  std::call_once(hash_once, [this]() {
+    uint64_t h = 14695981039346656037ull;
+    for (size_t i = 0; i < prg_size; i++) {
+      h = (h ^ prg[i]) * 1099511628211ull;
+    }
+    for (size_t i = 0; i < chr_size; i++) {
+      h = (h ^ chr[i]) * 1099511628211ull;
+    }
+    hash = h;
+  });
+  return hash;
+}
+
+bool RomCache::Key::operator<(const Key &other) const {
+  return std::tie(dev, ino, size, mtime_sec, mtime_nsec)
+       < std::tie(other.dev, other.ino, other.size, other.mtime_sec, other.mtime_nsec);
+}
+
+bool RomCache::Key::operator==(const Key &other) const {
+  return !(*this < other) && !(other < *this);
+}
+
+bool RomCache::identify(const std::string &path, Key &key) {
+  #ifdef ROM_CACHE_STAT
+  struct stat st;
+  if (stat(path.c_str(), &st) != 0) {
+    return false;
+  }
+  key.dev = st.st_dev;
+  key.ino = st.st_ino;
+  key.size = st.st_size;
+  #ifdef __APPLE__
+  key.mtime_sec = st.st_mtimespec.tv_sec;
+  key.mtime_nsec = st.st_mtimespec.tv_nsec;
+  #else
+  key.mtime_sec = st.st_mtim.tv_sec;
+  key.mtime_nsec = st.st_mtim.tv_nsec;
+  #endif
+  return true;
+  #else
+  // no inodes to go by, the contents are the identity
+  MappedFile file;
+  if (!file.open(path)) {
+    return false;
+  }
+  key.ino = Hash64::hash(file.data(), file.size());
+  key.size = file.size();
+  return true;
+  #endif
+}
+
+RomCache::RomCache() {
+
+}
+
+RomCache::~RomCache() {
+
+}
+
+RomCache &RomCache::global() {
+  static RomCache cache;
+  return cache;
+}
+
+std::shared_ptr<const RomImage> RomCache::load(const std::string &path) {
+  // a stat, not a hash of the contents: a big rom's pages then only
+  // come in as the game touches them. rewriting the file changes its
+  // size or mtime, replacing it changes the inode, so the key can't go
+  // stale the way a path would
+  Key key;
+  if (!identify(path, key)) {
+    return nullptr;
+  }
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    auto it = images.find(key);
+    if (it != images.end()) {
+      return it->second;
+    }
+  }
+
+  // parsed outside the lock, two threads racing on a new rom both parse
+  // it and the first one in wins
+  std::shared_ptr<const RomImage> image = RomImage::load(path);
+  if (!image) {
+    return nullptr;
+  }
+  // checked again once mapped: a file swapped in between is used but
+  // not cached under the old one's key
+  Key mapped;
+  if (!identify(path, mapped) || !(mapped == key)) {
+    return image;
+  }
+  std::lock_guard<std::mutex> guard(lock);
+  return images.emplace(key, image).first->second;
+}
+
+size_t RomCache::size() {
+  std::lock_guard<std::mutex> guard(lock);
+  return images.size();
+}
+
+void RomCache::clear() {
+  std::lock_guard<std::mutex> guard(lock);
+  images.clear();
+}
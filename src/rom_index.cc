@@ -0,0 +1,154 @@
+#include "rom_index.hh"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cctype>
+#include <cstring>
+
+static const char INDEX_MAGIC[8] = {'N', 'E', 'S', 'I', 'N', 'D', 'E', 'X'};
+static const uint32_t INDEX_VERSION = 1;
+static const size_t HEADER_SIZE = 8 + 4 + 4;
+
+static_assert(sizeof(RomIndex::Entry) == 48, "index entries are a fixed 48 bytes");
+static_assert(HEADER_SIZE % alignof(RomIndex::Entry) == 0, "entries are read in place");
+
+RomIndex::RomIndex() {
+
+}
+
+RomIndex::~RomIndex() {
+  this->close();
+}
+
+bool RomIndex::write(const std::string &path, std::vector<Rom> roms) {
+  std::sort(roms.begin(), roms.end(), [](const Rom &a, const Rom &b) {
+    return a.file_hash < b.file_hash;
+  });
+  // the same file under two names is one game
+  roms.erase(std::unique(roms.begin(), roms.end(), [](const Rom &a, const Rom &b) {
+    return a.file_hash == b.file_hash;
+  }), roms.end());
+
+  std::vector<Entry> entries(roms.size());
+  std::string strings;
+  for (size_t i = 0; i < roms.size(); i++) {
+    const Rom &rom = roms[i];
+    Entry &e = entries[i];
+    memset(&e, 0, sizeof(e));
+    e.file_hash = rom.file_hash;
+    e.rom_hash = rom.rom_hash;
+    e.prg_rom_size = rom.info.prg_rom_size;
+    e.chr_rom_size = rom.info.chr_rom_size;
+    e.prg_ram_size = rom.info.prg_ram_size + rom.info.prg_nvram_size;
+    e.chr_ram_size = rom.info.chr_ram_size + rom.info.chr_nvram_size;
+    e.mapper = rom.info.mapper;
+    e.submapper = rom.info.submapper;
+    e.region = rom.info.region;
+    e.flags = (rom.info.format == RomInfo::NES2 ? FLAG_NES2 : 0)
+            | (rom.info.battery ? FLAG_BATTERY : 0)
+            | (rom.info.vertical_mirror ? FLAG_VERTICAL : 0)
+            | (rom.info.four_screen ? FLAG_FOUR_SCREEN : 0);
+    e.path = strings.size();
+    strings.append(rom.path).push_back('\0');
+    e.title = strings.size();
+    strings.append(rom.title).push_back('\0');
+  }
+
+  FILE* f = fopen(path.c_str(), "wb");
+  if (!f) {
+    return false;
+  }
+  uint32_t count = entries.size();
+  fwrite(INDEX_MAGIC, 1, sizeof(INDEX_MAGIC), f);
+  fwrite(&INDEX_VERSION, 4, 1, f);
+  fwrite(&count, 4, 1, f);
+  fwrite(entries.data(), sizeof(Entry), entries.size(), f);
+  fwrite(strings.data(), 1, strings.size(), f);
+  return fclose(f) == 0;
+}
+
+bool RomIndex::open(const std::string &path) {
+  this->close();
+  if (!file.open(path)) {
+    return false;
+  }
+  const uint8_t* data = file.data();
+  uint32_t version, count;
+  if (file.size() < HEADER_SIZE || memcmp(data, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0) {
+    this->close();
+    return false;
+  }
+  memcpy(&version, data + 8, 4);
+  memcpy(&count, data + 12, 4);
+  if (version != INDEX_VERSION || HEADER_SIZE + (uint64_t) count * sizeof(Entry) > file.size()) {
+    this->close();
+    return false;
+  }
+  entries = (const Entry*) (data + HEADER_SIZE);
+  n_entries = count;
+  strings = (const char*) (entries + count);
+
+  // a damaged index must not send anyone past the end of the mapping
+  size_t strings_size = file.size() - HEADER_SIZE - count * sizeof(Entry);
+  for (size_t i = 0; i < n_entries; i++) {
+    if (entries[i].path >= strings_size || entries[i].title >= strings_size) {
+      this->close();
+      return false;
+    }
+  }
+  if (strings_size && strings[strings_size - 1] != '\0') {
+    this->close();
+    return false;
+  }
+  return true;
+}
+
+void RomIndex::close() {
+  file.close();
+  entries = nullptr;
+  n_entries = 0;
+  strings = nullptr;
+}
+
+const RomIndex::Entry* RomIndex::find(uint64_t file_hash) const {
+  const Entry* end = entries + n_entries;
+  const Entry* e = std::lower_bound(entries, end, file_hash, [](const Entry &e, uint64_t hash) {
+    return e.file_hash < hash;
+  });
+  return e != end && e->file_hash == file_hash ? e : nullptr;
+}
+
+const RomIndex::Entry* RomIndex::find_rom_hash(uint64_t rom_hash) const {
+  for (size_t i = 0; i < n_entries; i++) {
+    if (entries[i].rom_hash == rom_hash) {
+      return &entries[i];
+    }
+  }
+  return nullptr;
+}
+
+const RomIndex::Entry* RomIndex::find_title(const std::string &title) const {
+  for (size_t i = 0; i < n_entries; i++) {
+    const char* t = this->title(entries[i]);
+    size_t n = 0;
+    while (n < title.size() && t[n] && tolower((uint8_t) t[n]) == tolower((uint8_t) title[n])) {
+      n++;
+    }
+    if (n == title.size() && !t[n]) {
+      return &entries[i];
+    }
+  }
+  return nullptr;
+}
+
+std::string RomIndex::resolve(const std::string &name) const {
+  const Entry* e = this->find_title(name);
+  if (!e && name.size() == 16 && name.find_first_not_of("0123456789abcdefABCDEF") == std::string::npos) {
+    uint64_t hash = strtoull(name.c_str(), nullptr, 16);
+    e = this->find(hash);
+    if (!e) {
+      e = this->find_rom_hash(hash);
+    }
+  }
+  return e ? this->path(*e) : "";
+}
@@ -0,0 +1,85 @@
+#include "rom_info.hh"
+#include <cstring>
+
+// more than any board has, a header asking for more is broken
+static const uint64_t MAX_ROM_SIZE = 64 << 20;
+
+// nes 2.0 rom sizes: a 12 bit count of units, or when the high nibble is
+// all ones, 2^exponent * (multiplier * 2 + 1) bytes
+static uint64_t rom_size(uint8_t lsb, uint8_t msb_nibble, uint64_t unit) {
+  if (msb_nibble == 0x0F) {
+    int exponent = lsb >> 2;
+    int multiplier = lsb & 0x03;
+    if (exponent > 40) {
+      return ~0ull;
+    }
+    return (1ull << exponent) * (multiplier * 2 + 1);
+  }
+  return (((uint64_t) msb_nibble << 8) | lsb) * unit;
+}
+
+// ram sizes are shift counts, 64 << n bytes (0 = none)
+static uint32_t ram_size(uint8_t shift) {
+  return shift ? 64u << shift : 0;
+}
+
+bool RomInfo::parse(const uint8_t* data, size_t size, RomInfo &info) {
+  info = RomInfo();
+  if (size < HEADER_SIZE || memcmp(data, "NES\x1A", 4) != 0) {
+    return false;
+  }
+  uint8_t flags6 = data[6];
+  uint8_t flags7 = data[7];
+
+  info.vertical_mirror = flags6 & 0x01;
+  info.battery = flags6 & 0x02;
+  info.trainer = flags6 & 0x04;
+  info.four_screen = flags6 & 0x08;
+  info.console = (Console) (flags7 & 0x03);
+  info.rom_offset = HEADER_SIZE + (info.trainer ? 512 : 0);
+
+  if ((flags7 & 0x0C) == 0x08) {
+    info.format = NES2;
+    info.mapper = (flags6 >> 4) | (flags7 & 0xF0) | ((data[8] & 0x0F) << 8);
+    info.submapper = data[8] >> 4;
+    info.prg_rom_size = rom_size(data[4], data[9] & 0x0F, 16 * 1024);
+    info.chr_rom_size = rom_size(data[5], data[9] >> 4, 8 * 1024);
+    info.prg_ram_size = ram_size(data[10] & 0x0F);
+    info.prg_nvram_size = ram_size(data[10] >> 4);
+    info.chr_ram_size = ram_size(data[11] & 0x0F);
+    info.chr_nvram_size = ram_size(data[11] >> 4);
+    info.region = (Region) (data[12] & 0x03);
+  }
+  else {
+    info.format = INES;
+    info.mapper = flags6 >> 4;
+    // old dumpers wrote their name over bytes 7-15, then byte 7 is junk
+    bool junk = data[12] || data[13] || data[14] || data[15];
+    if (!junk) {
+      info.mapper |= flags7 & 0xF0;
+    }
+    info.prg_rom_size = data[4] * 16 * 1024;
+    info.chr_rom_size = data[5] * 8 * 1024;
+    uint32_t prg_ram = (data[8] ? data[8] : 1) * 8 * 1024;
+    if (info.battery) {
+      info.prg_nvram_size = prg_ram;
+    }
+    else {
+      info.prg_ram_size = prg_ram;
+    }
+    info.chr_ram_size = info.chr_rom_size ? 0 : 8 * 1024;
+    info.region = !junk && (data[9] & 0x01) ? PAL : NTSC;
+  }
+
+  return info.prg_rom_size <= MAX_ROM_SIZE && info.chr_rom_size <= MAX_ROM_SIZE;
+}
+
+const char* RomInfo::region_name(Region region) {
+  switch (region) {
+    case NTSC: return "ntsc";
+    case PAL: return "pal";
+    case MULTI_REGION: return "multi";
+    case DENDY: return "dendy";
+  }
+  return "?";
+}
@@ -0,0 +1,173 @@
+#include "save_ram.hh"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define SAVE_RAM_MMAP
+#endif
+
+SaveRam::SaveRam() {
+
+}
+
+SaveRam::~SaveRam() {
+  this->close();
+}
+
+bool SaveRam::open(const std::string &file, size_t size) {
+  this->close();
+  if (size == 0) {
+    return false;
+  }
+  path = file;
+
+  #ifdef SAVE_RAM_MMAP
+  long page = sysconf(_SC_PAGESIZE);
+  page_shift = 12;
+  while (page > 0 && (1l << page_shift) < page) {
+    page_shift++;
+  }
+  int fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+  if (fd < 0) {
+    return false;
+  }
+  // a shorter file (or a new one) is zero filled, a longer one is left
+  // alone and only its start is used
+  struct stat st;
+  if (fstat(fd, &st) == 0 && ((size_t) st.st_size >= size || ftruncate(fd, size) == 0)) {
+    void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (p != MAP_FAILED) {
+      bytes = (uint8_t*) p;
+      length = size;
+      mapped = true;
+    }
+  }
+  ::close(fd);
+  #endif
+
+  if (!bytes) {
+    buffer.assign(size, 0x00);
+    FILE* f = fopen(path.c_str(), "rb");
+    if (f) {
+      size_t got = fread(buffer.data(), 1, size, f);
+      (void) got;
+      fclose(f);
+    }
+    bytes = buffer.data();
+    length = size;
+  }
+
+  n_pages = ((length - 1) >> page_shift) + 1;
+  dirty.reset(new std::atomic<uint8_t>[n_pages]);
+  for (size_t i = 0; i < n_pages; i++) {
+    dirty[i].store(0);
+  }
+
+  // plain memory can't be written out while the cpu writes it, it is only
+  // saved on close
+  if (mapped) {
+    quit = false;
+    flusher = std::thread(&SaveRam::flusher_loop, this);
+  }
+  return true;
+}
+
+void SaveRam::close() {
+  if (flusher.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      quit = true;
+    }
+    wake.notify_one();
+    flusher.join();
+  }
+  if (bytes) {
+    this->flush();
+  }
+
+  #ifdef SAVE_RAM_MMAP
+  if (mapped && bytes) {
+    munmap(bytes, length);
+  }
+  #endif
+  bytes = nullptr;
+  length = 0;
+  mapped = false;
+  buffer.clear();
+  dirty.reset();
+  n_pages = 0;
+}
+
+void SaveRam::touch_all() {
+  for (size_t i = 0; i < n_pages; i++) {
+    dirty[i].store(1, std::memory_order_relaxed);
+  }
+}
+
+bool SaveRam::flush() {
+  bool ok = true;
+  // a page written after its flag is cleared sets it again, and goes out
+  // on the next pass
+  if (mapped) {
+    #ifdef SAVE_RAM_MMAP
+    size_t page = (size_t) 1 << page_shift;
+    size_t i = 0;
+    while (i < n_pages) {
+      if (!dirty[i].exchange(0, std::memory_order_acquire)) {
+        i++;
+        continue;
+      }
+      // runs of dirty pages go out in one call
+      size_t first = i++;
+      while (i < n_pages && dirty[i].exchange(0, std::memory_order_acquire)) {
+        i++;
+      }
+      size_t begin = first * page;
+      size_t end = std::min(i * page, length);
+      if (msync(bytes + begin, end - begin, MS_SYNC) != 0) {
+        ok = false;
+      }
+      n_flushed += i - first;
+    }
+    #endif
+    return ok;
+  }
+
+  bool any = false;
+  for (size_t i = 0; i < n_pages; i++) {
+    if (dirty[i].exchange(0)) {
+      any = true;
+    }
+  }
+  if (!any) {
+    return true;
+  }
+  FILE* f = fopen(path.c_str(), "wb");
+  if (!f) {
+    return false;
+  }
+  ok = fwrite(bytes, 1, length, f) == length;
+  ok = fclose(f) == 0 && ok;
+  n_flushed += n_pages;
+  return ok;
+}
+
+void SaveRam::flusher_loop() {
+  std::unique_lock<std::mutex> lock(mutex);
+  while (!quit) {
+    wake.wait_for(lock, std::chrono::milliseconds(FLUSH_INTERVAL_MS), [this]() { return quit; });
+    if (quit) {
+      break;
+    }
+    lock.unlock();
+    if (!this->flush()) {
+      fprintf(stderr, "failed to write save ram: %s\n", path.c_str());
+    }
+    lock.lock();
+  }
+}
@@ -0,0 +1,82 @@
+#include "scheduler.hh"
+
+Scheduler::Scheduler() {
+  this->reset();
+}
+
+Scheduler::~Scheduler() {
+
+}
+
+void Scheduler::set_handler(Event e, std::function<void(uint64_t)> handler) {
+  handlers[e] = handler;
+}
+
+void Scheduler::schedule(Event e, uint64_t cycle) {
+  timestamps[e] = cycle;
+  if (cycle < next_event) {
+    next_event = cycle;
+  }
+  else {
+    update_next();
+  }
+}
+
+void Scheduler::cancel(Event e) {
+  timestamps[e] = NEVER;
+  update_next();
+}
+
+bool Scheduler::pending(Event e) const {
+  return timestamps[e] != NEVER;
+}
+
+uint64_t Scheduler::when(Event e) const {
+  return timestamps[e];
+}
+
+void Scheduler::reset() {
+  for (int i = 0; i < N_EVENTS; i++) {
+    timestamps[i] = NEVER;
+  }
+  next_event = NEVER;
+}
+
+void Scheduler::dispatch(uint64_t now) {
+  // handlers may reschedule themselves (or others) so keep looking until
+  // nothing else is due
+  bool fired = true;
+  while (fired) {
+    fired = false;
+    for (int i = 0; i < N_EVENTS; i++) {
+      if (timestamps[i] <= now) {
+        uint64_t at = timestamps[i];
+        timestamps[i] = NEVER;
+        if (handlers[i]) {
+          handlers[i](at);
+        }
+        fired = true;
+      }
+    }
+  }
+  update_next();
+}
+
+void Scheduler::update_next() {
+  next_event = NEVER;
+  for (int i = 0; i < N_EVENTS; i++) {
+    if (timestamps[i] < next_event) {
+      next_event = timestamps[i];
+    }
+  }
+}
+
+// handlers stay as they are, only the timestamps are state
+void Scheduler::save_state(StateWriter &w) const {
+  w.write(timestamps);
+}
+
+void Scheduler::load_state(StateReader &r) {
+  r.read(timestamps);
+  this->update_next();
+}
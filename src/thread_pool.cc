@@ -0,0 +1,132 @@
+#include "thread_pool.hh"
+
+static inline uint64_t pack(uint32_t begin, uint32_t end) {
+  return (uint64_t) begin << 32 | end;
+}
+
+ThreadPool::ThreadPool(int n_threads) {
+  if (n_threads <= 0) {
+    n_threads = std::thread::hardware_concurrency();
+  }
+  shares.reset(new Share[n_threads > 1 ? n_threads : 1]);
+  for (int i = 1; i < n_threads; i++) {
+    workers.emplace_back(&ThreadPool::worker_loop, this, i);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    stopping = true;
+  }
+  wake.notify_all();
+  for (std::thread &worker : workers) {
+    worker.join();
+  }
+}
+
+void ThreadPool::parallel_for(int n, const std::function<void(int)> &fn) {
+  if (n <= 0) {
+    return;
+  }
+  if (workers.empty() || n == 1) {
+    for (int i = 0; i < n; i++) {
+      fn(i);
+    }
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    // equal contiguous shares, neighbouring indices stay on one thread
+    int threads = this->size();
+    for (int t = 0; t < threads; t++) {
+      uint32_t begin = (uint64_t) n * t / threads;
+      uint32_t end = (uint64_t) n * (t + 1) / threads;
+      shares[t].range.store(pack(begin, end));
+    }
+    task = &fn;
+    generation++;
+  }
+  wake.notify_all();
+
+  run_tasks(&fn, 0);
+
+  // workers that wake up after this see no task and go back to sleep
+  std::unique_lock<std::mutex> guard(lock);
+  done.wait(guard, [this] { return active == 0; });
+  task = nullptr;
+}
+
+// takes the first index of the thread's own share
+bool ThreadPool::pop(int self, int &i) {
+  std::atomic<uint64_t> &range = shares[self].range;
+  uint64_t r = range.load();
+  while ((uint32_t) (r >> 32) < (uint32_t) r) {
+    if (range.compare_exchange_weak(r, r + pack(1, 0))) {
+      i = r >> 32;
+      return true;
+    }
+  }
+  return false;
+}
+
+// moves the back half of some other share into the thread's own (empty)
+// one. indices in flight belong to the thief, which is still counted as
+// active, so nothing is lost if the others give up meanwhile
+bool ThreadPool::steal(int self) {
+  int threads = this->size();
+  for (int k = 1; k < threads; k++) {
+    std::atomic<uint64_t> &range = shares[(self + k) % threads].range;
+    uint64_t r = range.load();
+    while (true) {
+      uint32_t begin = r >> 32;
+      uint32_t end = r;
+      if (begin >= end) {
+        break;
+      }
+      uint32_t half = (end - begin + 1) / 2;
+      if (range.compare_exchange_weak(r, pack(begin, end - half))) {
+        shares[self].range.store(pack(end - half, end));
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+void ThreadPool::run_tasks(const std::function<void(int)>* fn, int self) {
+  int i;
+  do {
+    while (this->pop(self, i)) {
+      (*fn)(i);
+    }
+  } while (this->steal(self));
+}
+
+void ThreadPool::worker_loop(int self) {
+  uint64_t seen = 0;
+  std::unique_lock<std::mutex> guard(lock);
+  while (true) {
+    wake.wait(guard, [&] { return stopping || generation != seen; });
+    if (stopping) {
+      return;
+    }
+    seen = generation;
+    if (!task) {
+      continue;
+    }
+
+    const std::function<void(int)>* fn = task;
+    active++;
+    guard.unlock();
+
+    run_tasks(fn, self);
+
+    guard.lock();
+    active--;
+    if (active == 0) {
+      done.notify_all();
+    }
+  }
+}
@@ -0,0 +1,359 @@
+#include "video_capture.hh"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+#include "crc32.hh"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+static const size_t FILE_BUF_SIZE = 4 << 20;
+
+std::string VideoCapture::y4m_header(int w, int h) {
+  // 60.0988 fps, nes pixels are 8:7
+  char header[96];
+  snprintf(header, sizeof(header), "YUV4MPEG2 W%d H%d F39375000:655171 Ip A8:7 C420jpeg\n", w, h);
+  return header;
+}
+
+void VideoCapture::to_yuv420(const uint32_t* argb, int w, int h, uint8_t* y_plane, uint8_t* u_plane, uint8_t* v_plane) {
+  #ifdef __SSE2__
+  to_yuv420_sse2(argb, w, h, y_plane, u_plane, v_plane);
+  #else
+  to_yuv420_scalar(argb, w, h, y_plane, u_plane, v_plane);
+  #endif
+}
+
+// luma in 8.8 fixed point, the coefficients add up to 256 so the sum
+// fits in an unsigned 16 bit lane
+void VideoCapture::to_yuv420_scalar(const uint32_t* argb, int w, int h, uint8_t* y_plane, uint8_t* u_plane, uint8_t* v_plane) {
+  for (int i = 0; i < w * h; i++) {
+    uint32_t c = argb[i];
+    uint32_t r = (c >> 16) & 0xFF;
+    uint32_t g = (c >> 8) & 0xFF;
+    uint32_t b = c & 0xFF;
+    y_plane[i] = (uint8_t) ((r * 77 + g * 150 + b * 29 + 128) >> 8);
+  }
+
+  auto avg = [](uint32_t a, uint32_t b) {
+    return ((a & 0xFF) + (b & 0xFF) + 1) >> 1;
+  };
+  for (int y = 0; y < h; y += 2) {
+    const uint32_t* row0 = argb + y * w;
+    const uint32_t* row1 = row0 + w;
+    for (int x = 0; x < w; x += 2) {
+      float ch[3];
+      for (int k = 0; k < 3; k++) {
+        int s = 8 * k;
+        uint32_t left = avg(row0[x] >> s, row1[x] >> s);
+        uint32_t right = avg(row0[x + 1] >> s, row1[x + 1] >> s);
+        ch[k] = (float) avg(left, right);
+      }
+      float r = ch[2], g = ch[1], b = ch[0];
+      float cb = 128.0f + (-0.168736f * r + -0.331264f * g + 0.5f * b);
+      float cr = 128.0f + (0.5f * r + -0.418688f * g + -0.081312f * b);
+      int ci = (int) lrintf(cb);
+      int vi = (int) lrintf(cr);
+      int o = (y / 2) * (w / 2) + x / 2;
+      u_plane[o] = (uint8_t) std::min(std::max(ci, 0), 255);
+      v_plane[o] = (uint8_t) std::min(std::max(vi, 0), 255);
+    }
+  }
+}
+
+#ifdef __SSE2__
+void VideoCapture::to_yuv420_sse2(const uint32_t* argb, int w, int h, uint8_t* y_plane, uint8_t* u_plane, uint8_t* v_plane) {
+  const __m128i byte = _mm_set1_epi32(0xFF);
+  const __m128i ky_r = _mm_set1_epi16(77);
+  const __m128i ky_g = _mm_set1_epi16(150);
+  const __m128i ky_b = _mm_set1_epi16(29);
+  const __m128i round = _mm_set1_epi16(128);
+
+  for (int i = 0; i < w * h; i += 8) {
+    __m128i p0 = _mm_loadu_si128((const __m128i*) (argb + i));
+    __m128i p1 = _mm_loadu_si128((const __m128i*) (argb + i + 4));
+    __m128i r = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 16), byte), _mm_and_si128(_mm_srli_epi32(p1, 16), byte));
+    __m128i g = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 8), byte), _mm_and_si128(_mm_srli_epi32(p1, 8), byte));
+    __m128i b = _mm_packs_epi32(_mm_and_si128(p0, byte), _mm_and_si128(p1, byte));
+
+    __m128i y = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(r, ky_r), _mm_mullo_epi16(g, ky_g)),
+                              _mm_add_epi16(_mm_mullo_epi16(b, ky_b), round));
+    y = _mm_srli_epi16(y, 8);
+    _mm_storel_epi64((__m128i*) (y_plane + i), _mm_packus_epi16(y, y));
+  }
+
+  const __m128 offset = _mm_set1_ps(128.0f);
+  for (int y = 0; y < h; y += 2) {
+    const uint32_t* row0 = argb + y * w;
+    const uint32_t* row1 = row0 + w;
+    uint8_t* u_row = u_plane + (y / 2) * (w / 2);
+    uint8_t* v_row = v_plane + (y / 2) * (w / 2);
+
+    for (int x = 0; x < w; x += 8) {
+      __m128i m0 = _mm_avg_epu8(_mm_loadu_si128((const __m128i*) (row0 + x)), _mm_loadu_si128((const __m128i*) (row1 + x)));
+      __m128i m1 = _mm_avg_epu8(_mm_loadu_si128((const __m128i*) (row0 + x + 4)), _mm_loadu_si128((const __m128i*) (row1 + x + 4)));
+      __m128i even = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(m0), _mm_castsi128_ps(m1), _MM_SHUFFLE(2, 0, 2, 0)));
+      __m128i odd = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(m0), _mm_castsi128_ps(m1), _MM_SHUFFLE(3, 1, 3, 1)));
+      __m128i c = _mm_avg_epu8(even, odd);
+
+      __m128 r = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(c, 16), byte));
+      __m128 g = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(c, 8), byte));
+      __m128 b = _mm_cvtepi32_ps(_mm_and_si128(c, byte));
+
+      __m128 cb = _mm_add_ps(offset, _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(-0.168736f), r),
+                                                           _mm_mul_ps(_mm_set1_ps(-0.331264f), g)),
+                                                _mm_mul_ps(_mm_set1_ps(0.5f), b)));
+      __m128 cr = _mm_add_ps(offset, _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(0.5f), r),
+                                                           _mm_mul_ps(_mm_set1_ps(-0.418688f), g)),
+                                                _mm_mul_ps(_mm_set1_ps(-0.081312f), b)));
+
+      __m128i packed = _mm_packs_epi32(_mm_cvtps_epi32(cb), _mm_cvtps_epi32(cr));
+      packed = _mm_packus_epi16(packed, packed);
+      uint32_t u4 = (uint32_t) _mm_cvtsi128_si32(packed);
+      uint32_t v4 = (uint32_t) _mm_cvtsi128_si32(_mm_srli_si128(packed, 4));
+      memcpy(u_row + x / 2, &u4, 4);
+      memcpy(v_row + x / 2, &v4, 4);
+    }
+  }
+}
+#endif
+
+VideoCapture::VideoCapture() {
+
+}
+
+VideoCapture::~VideoCapture() {
+  this->stop();
+}
+
+bool VideoCapture::start(const std::string &path, const Palette* palette, VideoFilter::Type type) {
+  if (active) {
+    return false;
+  }
+  this->path = path;
+  this->format = path.size() > 4 && path.compare(path.size() - 4, 4, ".png") == 0 ? PNG : Y4M;
+
+  // the converter runs the filter on its own thread, no pool
+  filter = std::make_unique<VideoFilter>(nullptr);
+  filter->set_palette(palette);
+  filter->set_type(type);
+  width = filter->width();
+  height = filter->height();
+  argb.resize(width * height);
+
+  if (format == Y4M) {
+    file = fopen(path.c_str(), "wb");
+    if (!file) {
+      return false;
+    }
+    setvbuf(file, nullptr, _IOFBF, FILE_BUF_SIZE);
+    std::string header = y4m_header(width, height);
+    fwrite(header.data(), 1, header.size(), file);
+  }
+
+  frames = std::make_unique<IndexQueue>();
+  pictures = std::make_unique<PictureQueue>();
+
+  quit = false;
+  converter_done = false;
+  dropped = 0;
+  written = 0;
+  active = true;
+  converter = std::thread(&VideoCapture::converter_loop, this);
+  writer = std::thread(&VideoCapture::writer_loop, this);
+  return true;
+}
+
+void VideoCapture::stop() {
+  if (!active) {
+    return;
+  }
+  quit = true;
+  converter.join();
+  writer.join();
+  active = false;
+
+  if (file) {
+    fclose(file);
+    file = nullptr;
+  }
+  frames.reset();
+  pictures.reset();
+}
+
+void VideoCapture::push_frame(const uint16_t* index) {
+  if (!active) {
+    return;
+  }
+  IndexFrame* frame = frames->write_slot();
+  if (!frame) {
+    dropped++;
+    return;
+  }
+  memcpy(frame->index, index, sizeof(frame->index));
+  frames->push();
+}
+
+void VideoCapture::converter_loop() {
+  while (!quit) {
+    if (!convert()) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+  }
+  // convert whatever was queued before stop()
+  while (convert());
+  converter_done = true;
+}
+
+bool VideoCapture::convert() {
+  IndexFrame* frame = frames->read_slot();
+  if (!frame) {
+    return false;
+  }
+  Picture* picture;
+  while (!(picture = pictures->write_slot())) {
+    // writer is behind, frames pile up (and get dropped) in front of us
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  filter->apply(frame->index, 0, 239, argb.data(), width * sizeof(uint32_t));
+  frames->pop();
+
+  int pixels = width * height;
+  if (format == Y4M) {
+    // slots keep their buffers, so this only allocates on the first lap
+    picture->data.resize(pixels + pixels / 2);
+    uint8_t* y = picture->data.data();
+    uint8_t* u = y + pixels;
+    uint8_t* v = u + pixels / 4;
+    to_yuv420(argb.data(), width, height, y, u, v);
+  }
+  else {
+    picture->data.resize(pixels * 3);
+    uint8_t* rgb = picture->data.data();
+    for (int i = 0; i < pixels; i++) {
+      rgb[i * 3 + 0] = (argb[i] >> 16) & 0xFF;
+      rgb[i * 3 + 1] = (argb[i] >> 8) & 0xFF;
+      rgb[i * 3 + 2] = argb[i] & 0xFF;
+    }
+  }
+  pictures->push();
+  return true;
+}
+
+void VideoCapture::writer_loop() {
+  while (true) {
+    bool done = converter_done;
+    if (!drain()) {
+      if (done) {
+        break;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+  }
+}
+
+bool VideoCapture::drain() {
+  bool any = false;
+  Picture* picture;
+  while ((picture = pictures->read_slot())) {
+    if (format == Y4M) {
+      fwrite("FRAME\n", 1, 6, file);
+      fwrite(picture->data.data(), 1, picture->data.size(), file);
+    }
+    else {
+      this->write_png(*picture);
+    }
+    pictures->pop();
+    written++;
+    any = true;
+  }
+  return any;
+}
+
+void VideoCapture::write_png(const Picture &picture) {
+  char name[32];
+  snprintf(name, sizeof(name), "_%06llu.png", (unsigned long long) written.load());
+  save_png(path.substr(0, path.size() - 4) + name, picture.data.data(), width, height);
+}
+
+// uncompressed png (deflate stored blocks), the point is to be fast and
+// lossless, not small
+// https://www.w3.org/TR/png/
+bool VideoCapture::save_png(const std::string &file_path, const uint8_t* rgb, int width, int height) {
+  FILE* f = fopen(file_path.c_str(), "wb");
+  if (!f) {
+    return false;
+  }
+  setvbuf(f, nullptr, _IOFBF, FILE_BUF_SIZE);
+
+  auto be32 = [](uint8_t* p, uint32_t v) {
+    p[0] = v >> 24; p[1] = v >> 16; p[2] = v >> 8; p[3] = v;
+  };
+  auto chunk = [&](const char* type, const uint8_t* data, uint32_t len) {
+    uint8_t word[4];
+    be32(word, len);
+    fwrite(word, 1, 4, f);
+    fwrite(type, 1, 4, f);
+    if (len) {
+      fwrite(data, 1, len, f);
+    }
+    uint32_t crc = Crc32::update(0, type, 4);
+    crc = Crc32::update(crc, data, len);
+    be32(word, crc);
+    fwrite(word, 1, 4, f);
+  };
+
+  fwrite("\x89PNG\r\n\x1a\n", 1, 8, f);
+
+  uint8_t ihdr[13];
+  be32(ihdr, width);
+  be32(ihdr + 4, height);
+  ihdr[8] = 8;   // bits per channel
+  ihdr[9] = 2;   // rgb
+  ihdr[10] = 0;  // deflate
+  ihdr[11] = 0;  // adaptive filtering
+  ihdr[12] = 0;  // no interlace
+  chunk("IHDR", ihdr, sizeof(ihdr));
+
+  // every row gets a filter type byte (0 = none) in front
+  int row_bytes = width * 3;
+  std::vector<uint8_t> raw((row_bytes + 1) * height);
+  for (int y = 0; y < height; y++) {
+    raw[y * (row_bytes + 1)] = 0;
+    memcpy(&raw[y * (row_bytes + 1) + 1], &rgb[y * row_bytes], row_bytes);
+  }
+
+  // zlib stream of stored deflate blocks
+  std::vector<uint8_t> zlib;
+  zlib.reserve(raw.size() + raw.size() / 65535 * 5 + 16);
+  zlib.push_back(0x78);
+  zlib.push_back(0x01);
+  size_t pos = 0;
+  do {
+    size_t len = std::min<size_t>(raw.size() - pos, 65535);
+    zlib.push_back(pos + len == raw.size() ? 1 : 0);
+    zlib.push_back(len & 0xFF);
+    zlib.push_back(len >> 8);
+    zlib.push_back(~len & 0xFF);
+    zlib.push_back((~len >> 8) & 0xFF);
+    zlib.insert(zlib.end(), raw.begin() + pos, raw.begin() + pos + len);
+    pos += len;
+  } while (pos < raw.size());
+
+  uint32_t a = 1, b = 0;
+  for (uint8_t byte : raw) {
+    a = (a + byte) % 65521;
+    b = (b + a) % 65521;
+  }
+  uint8_t adler[4];
+  be32(adler, (b << 16) | a);
+  zlib.insert(zlib.end(), adler, adler + 4);
+
+  chunk("IDAT", zlib.data(), zlib.size());
+  chunk("IEND", nullptr, 0);
+  return fclose(f) == 0;
+}
@@ -0,0 +1,775 @@
+#include "video_filter.hh"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// columns of padding on either side of a loaded row
+static const int PAD = 2;
+static const int ROW = 256 + 2 * PAD;
+
+static const char* type_names[VideoFilter::N_TYPES] = {
+  "nearest", "scale2x", "scale3x", "hq2x", "ntsc"
+};
+
+// copies line y (clamped to the screen) with its edge pixels repeated
+static void load_row(const uint16_t* index, int y, uint16_t* row) {
+  y = std::min(std::max(y, 0), 239);
+  const uint16_t* src = index + y * 256;
+  for (int i = 0; i < PAD; i++) {
+    row[i] = src[0];
+    row[PAD + 256 + i] = src[255];
+  }
+  memcpy(row + PAD, src, 256 * sizeof(uint16_t));
+}
+
+VideoFilter::VideoFilter(ThreadPool* pool) {
+  this->pool = pool;
+  this->build_ntsc_kernel();
+}
+
+VideoFilter::~VideoFilter() {
+
+}
+
+const char* VideoFilter::name(Type type) {
+  return type_names[type];
+}
+
+bool VideoFilter::from_name(const std::string &name, Type &type) {
+  for (int i = 0; i < N_TYPES; i++) {
+    if (name == type_names[i]) {
+      type = (Type) i;
+      return true;
+    }
+  }
+  return false;
+}
+
+void VideoFilter::set_type(Type type) {
+  this->type = type;
+}
+
+void VideoFilter::set_palette(const Palette* palette) {
+  this->palette = palette;
+  this->build_yuv();
+}
+
+int VideoFilter::scale_x() const {
+  switch (type) {
+    case SCALE2X: case HQ2X: return 2;
+    case SCALE3X: case NTSC: return 3;
+    default: return 1;
+  }
+}
+
+int VideoFilter::scale_y() const {
+  return this->scale_x();
+}
+
+int VideoFilter::width() const {
+  return 256 * this->scale_x();
+}
+
+int VideoFilter::height() const {
+  return 240 * this->scale_y();
+}
+
+int VideoFilter::radius() const {
+  switch (type) {
+    case SCALE2X: case SCALE3X: case HQ2X: return 1;
+    default: return 0;
+  }
+}
+
+void VideoFilter::apply(const uint16_t* index, int first, int last, uint32_t* out, int pitch) {
+  int lines = last - first + 1;
+  if (lines <= 0 || !palette) {
+    return;
+  }
+
+  // bands of at least 16 lines, small updates are not worth waking threads for
+  int bands = std::max(1, std::min(pool ? pool->size() : 1, (lines + 15) / 16));
+  if (bands == 1) {
+    this->filter_lines(index, first, last, out, pitch);
+    return;
+  }
+
+  int rows = this->scale_y();
+  pool->parallel_for(bands, [&](int band) {
+    int band_first = first + lines * band / bands;
+    int band_last = first + lines * (band + 1) / bands - 1;
+    uint32_t* band_out = (uint32_t*) ((uint8_t*) out + (size_t) (band_first - first) * rows * pitch);
+    this->filter_lines(index, band_first, band_last, band_out, pitch);
+  });
+}
+
+void VideoFilter::filter_lines(const uint16_t* index, int first, int last, uint32_t* out, int pitch) {
+  int rows = this->scale_y();
+  for (int y = first; y <= last; y++) {
+    switch (type) {
+      case NEAREST: this->nearest_line(index, y, out, pitch); break;
+      case SCALE2X: this->scale2x_line(index, y, out, pitch); break;
+      case SCALE3X: this->scale3x_line(index, y, out, pitch); break;
+      case HQ2X:    this->hq2x_line(index, y, out, pitch); break;
+      case NTSC:    this->ntsc_line(index, y, out, pitch); break;
+      default: break;
+    }
+    out = (uint32_t*) ((uint8_t*) out + (size_t) rows * pitch);
+  }
+}
+
+void VideoFilter::nearest_line(const uint16_t* index, int y, uint32_t* out, int pitch) {
+  palette->to_argb(index + y * 256, out, 256);
+}
+
+// scale2x and scale3x compare palette indices rather than colours, equal
+// indices always mean equal colours so the result is the same
+void VideoFilter::scale2x_line(const uint16_t* index, int y, uint32_t* out, int pitch) {
+  uint16_t above[ROW], line[ROW], below[ROW];
+  load_row(index, y - 1, above);
+  load_row(index, y, line);
+  load_row(index, y + 1, below);
+
+  //  A B C     E0 E1
+  //  D E F  -> E2 E3
+  //  G H I
+  uint16_t top[512], bottom[512];
+
+  #ifdef __SSE2__
+  const __m128i ones = _mm_set1_epi16(-1);
+  for (int x = 0; x < 256; x += 8) {
+    __m128i b = _mm_loadu_si128((const __m128i*) (above + PAD + x));
+    __m128i d = _mm_loadu_si128((const __m128i*) (line + PAD + x - 1));
+    __m128i e = _mm_loadu_si128((const __m128i*) (line + PAD + x));
+    __m128i f = _mm_loadu_si128((const __m128i*) (line + PAD + x + 1));
+    __m128i h = _mm_loadu_si128((const __m128i*) (below + PAD + x));
+
+    // b != h && d != f
+    __m128i active = _mm_andnot_si128(_mm_or_si128(_mm_cmpeq_epi16(b, h), _mm_cmpeq_epi16(d, f)), ones);
+
+    __m128i m0 = _mm_and_si128(active, _mm_cmpeq_epi16(d, b));
+    __m128i m1 = _mm_and_si128(active, _mm_cmpeq_epi16(b, f));
+    __m128i m2 = _mm_and_si128(active, _mm_cmpeq_epi16(d, h));
+    __m128i m3 = _mm_and_si128(active, _mm_cmpeq_epi16(h, f));
+
+    __m128i e0 = _mm_or_si128(_mm_and_si128(m0, d), _mm_andnot_si128(m0, e));
+    __m128i e1 = _mm_or_si128(_mm_and_si128(m1, f), _mm_andnot_si128(m1, e));
+    __m128i e2 = _mm_or_si128(_mm_and_si128(m2, d), _mm_andnot_si128(m2, e));
+    __m128i e3 = _mm_or_si128(_mm_and_si128(m3, f), _mm_andnot_si128(m3, e));
+
+    _mm_storeu_si128((__m128i*) (top + 2 * x), _mm_unpacklo_epi16(e0, e1));
+    _mm_storeu_si128((__m128i*) (top + 2 * x + 8), _mm_unpackhi_epi16(e0, e1));
+    _mm_storeu_si128((__m128i*) (bottom + 2 * x), _mm_unpacklo_epi16(e2, e3));
+    _mm_storeu_si128((__m128i*) (bottom + 2 * x + 8), _mm_unpackhi_epi16(e2, e3));
+  }
+  #else
+  for (int x = 0; x < 256; x++) {
+    uint16_t b = above[PAD + x];
+    uint16_t d = line[PAD + x - 1];
+    uint16_t e = line[PAD + x];
+    uint16_t f = line[PAD + x + 1];
+    uint16_t h = below[PAD + x];
+
+    uint16_t* t = top + 2 * x;
+    uint16_t* s = bottom + 2 * x;
+    if (b != h && d != f) {
+      t[0] = d == b ? d : e;
+      t[1] = b == f ? f : e;
+      s[0] = d == h ? d : e;
+      s[1] = h == f ? f : e;
+    }
+    else {
+      t[0] = t[1] = s[0] = s[1] = e;
+    }
+  }
+  #endif
+
+  palette->to_argb(top, out, 512);
+  palette->to_argb(bottom, (uint32_t*) ((uint8_t*) out + pitch), 512);
+}
+
+void VideoFilter::scale3x_line(const uint16_t* index, int y, uint32_t* out, int pitch) {
+  uint16_t above[ROW], line[ROW], below[ROW];
+  load_row(index, y - 1, above);
+  load_row(index, y, line);
+  load_row(index, y + 1, below);
+
+  //  A B C     E0 E1 E2
+  //  D E F  -> E3 E4 E5
+  //  G H I     E6 E7 E8
+  uint16_t rows[3][768];
+
+  #ifdef __SSE2__
+  const __m128i ones = _mm_set1_epi16(-1);
+  #define EQ(p, q) _mm_cmpeq_epi16(p, q)
+  #define NE(p, q) _mm_andnot_si128(_mm_cmpeq_epi16(p, q), ones)
+  #define AND(p, q) _mm_and_si128(p, q)
+  #define OR(p, q) _mm_or_si128(p, q)
+  #define SEL(m, p, q) _mm_or_si128(_mm_and_si128(m, p), _mm_andnot_si128(m, q))
+  for (int x = 0; x < 256; x += 8) {
+    __m128i a = _mm_loadu_si128((const __m128i*) (above + PAD + x - 1));
+    __m128i b = _mm_loadu_si128((const __m128i*) (above + PAD + x));
+    __m128i c = _mm_loadu_si128((const __m128i*) (above + PAD + x + 1));
+    __m128i d = _mm_loadu_si128((const __m128i*) (line + PAD + x - 1));
+    __m128i e = _mm_loadu_si128((const __m128i*) (line + PAD + x));
+    __m128i f = _mm_loadu_si128((const __m128i*) (line + PAD + x + 1));
+    __m128i g = _mm_loadu_si128((const __m128i*) (below + PAD + x - 1));
+    __m128i h = _mm_loadu_si128((const __m128i*) (below + PAD + x));
+    __m128i i = _mm_loadu_si128((const __m128i*) (below + PAD + x + 1));
+
+    __m128i active = AND(NE(b, h), NE(d, f));
+    __m128i db = AND(active, EQ(d, b));
+    __m128i bf = AND(active, EQ(b, f));
+    __m128i dh = AND(active, EQ(d, h));
+    __m128i hf = AND(active, EQ(h, f));
+
+    __m128i out_px[9];
+    out_px[0] = SEL(db, d, e);
+    out_px[1] = SEL(OR(AND(db, NE(e, c)), AND(bf, NE(e, a))), b, e);
+    out_px[2] = SEL(bf, f, e);
+    out_px[3] = SEL(OR(AND(db, NE(e, g)), AND(dh, NE(e, a))), d, e);
+    out_px[4] = e;
+    out_px[5] = SEL(OR(AND(bf, NE(e, i)), AND(hf, NE(e, c))), f, e);
+    out_px[6] = SEL(dh, d, e);
+    out_px[7] = SEL(OR(AND(dh, NE(e, i)), AND(hf, NE(e, g))), h, e);
+    out_px[8] = SEL(hf, f, e);
+
+    // interleaving by 3 has no cheap shuffle in sse2, spread the lanes out
+    uint16_t lanes[9][8];
+    for (int k = 0; k < 9; k++) {
+      _mm_storeu_si128((__m128i*) lanes[k], out_px[k]);
+    }
+    for (int l = 0; l < 8; l++) {
+      for (int k = 0; k < 9; k++) {
+        rows[k / 3][3 * (x + l) + k % 3] = lanes[k][l];
+      }
+    }
+  }
+  #undef EQ
+  #undef NE
+  #undef AND
+  #undef OR
+  #undef SEL
+  #else
+  for (int x = 0; x < 256; x++) {
+    uint16_t a = above[PAD + x - 1], b = above[PAD + x], c = above[PAD + x + 1];
+    uint16_t d = line[PAD + x - 1],  e = line[PAD + x],  f = line[PAD + x + 1];
+    uint16_t g = below[PAD + x - 1], h = below[PAD + x], i = below[PAD + x + 1];
+
+    uint16_t* r0 = rows[0] + 3 * x;
+    uint16_t* r1 = rows[1] + 3 * x;
+    uint16_t* r2 = rows[2] + 3 * x;
+    if (b != h && d != f) {
+      r0[0] = d == b ? d : e;
+      r0[1] = (d == b && e != c) || (b == f && e != a) ? b : e;
+      r0[2] = b == f ? f : e;
+      r1[0] = (d == b && e != g) || (d == h && e != a) ? d : e;
+      r1[1] = e;
+      r1[2] = (b == f && e != i) || (h == f && e != c) ? f : e;
+      r2[0] = d == h ? d : e;
+      r2[1] = (d == h && e != i) || (h == f && e != g) ? h : e;
+      r2[2] = h == f ? f : e;
+    }
+    else {
+      r0[0] = r0[1] = r0[2] = e;
+      r1[0] = r1[1] = r1[2] = e;
+      r2[0] = r2[1] = r2[2] = e;
+    }
+  }
+  #endif
+
+  for (int r = 0; r < 3; r++) {
+    palette->to_argb(rows[r], (uint32_t*) ((uint8_t*) out + r * pitch), 768);
+  }
+}
+
+void VideoFilter::build_yuv() {
+  for (int i = 0; i < Palette::SIZE; i++) {
+    uint32_t c = (*palette)[i];
+    int r = (c >> 16) & 0xFF;
+    int g = (c >> 8) & 0xFF;
+    int b = c & 0xFF;
+    yuv[0][i] = (r + g + b) >> 2;
+    yuv[1][i] = 128 + ((r - b) >> 2);
+    yuv[2][i] = 128 + ((-r + 2 * g - b) >> 3);
+  }
+}
+
+// hq2x: https://en.wikipedia.org/wiki/Hqx
+// each pixel is compared with its 8 neighbours in yuv, which gives an 8
+// bit pattern of the ones that differ visibly
+//   A B C    bit  0  1  2
+//   D E F         3  .  4
+//   G H I         5  6  7
+// the pattern picks one of the interpolation rules below for the top left
+// output pixel. the other three output pixels use the same table on the
+// pattern and neighbourhood rotated a quarter turn each
+static const uint8_t hq2x_rules[256] = {
+  4, 4, 6,  2, 4, 4, 6,  2, 5,  3, 15, 12, 5,  3, 17, 13,
+  4, 4, 6, 18, 4, 4, 6, 18, 5,  3, 12, 12, 5,  3,  1, 12,
+  4, 4, 6,  2, 4, 4, 6,  2, 5,  3, 17, 13, 5,  3, 16, 14,
+  4, 4, 6, 18, 4, 4, 6, 18, 5,  3, 16, 12, 5,  3,  1, 14,
+  4, 4, 6,  2, 4, 4, 6,  2, 5, 19, 12, 12, 5, 19, 16, 12,
+  4, 4, 6,  2, 4, 4, 6,  2, 5,  3, 16, 12, 5,  3, 16, 12,
+  4, 4, 6,  2, 4, 4, 6,  2, 5, 19,  1, 12, 5, 19,  1, 14,
+  4, 4, 6,  2, 4, 4, 6, 18, 5,  3, 16, 12, 5, 19,  1, 14,
+  4, 4, 6,  2, 4, 4, 6,  2, 5,  3, 15, 12, 5,  3, 17, 13,
+  4, 4, 6,  2, 4, 4, 6,  2, 5,  3, 16, 12, 5,  3, 16, 12,
+  4, 4, 6,  2, 4, 4, 6,  2, 5,  3, 17, 13, 5,  3, 16, 14,
+  4, 4, 6,  2, 4, 4, 6,  2, 5,  3, 16, 13, 5,  3,  1, 14,
+  4, 4, 6,  2, 4, 4, 6,  2, 5,  3, 16, 12, 5,  3, 16, 13,
+  4, 4, 6,  2, 4, 4, 6,  2, 5,  3, 16, 12, 5,  3,  1, 12,
+  4, 4, 6,  2, 4, 4, 6,  2, 5,  3, 16, 12, 5,  3,  1, 14,
+  4, 4, 6,  2, 4, 4, 6,  2, 5,  3,  1, 12, 5,  3,  1, 14,
+};
+
+// the pattern as seen from the next output pixel clockwise: what was C
+// is now A, F is B, B is D, H is F, D is H, and the corners follow
+static inline uint8_t hq2x_rotate(uint8_t p) {
+  return ((p >> 2) & 0x11) | ((p << 2) & 0x88)
+       | ((p & 0x01) << 5) | ((p & 0x08) << 3)
+       | ((p & 0x10) >> 3) | ((p & 0x80) >> 5);
+}
+
+// where a, b, d, f and h of the top left frame are in the 3x3 block
+//   0 1 2
+//   3 4 5   (4 is e)
+//   6 7 8
+// for each output pixel in the order the pattern rotates through them:
+// top left, top right, bottom right, bottom left
+static const uint8_t hq2x_frame[4][5] = {
+  {0, 1, 3, 5, 7},
+  {2, 5, 1, 7, 3},
+  {8, 7, 5, 3, 1},
+  {6, 3, 7, 1, 5},
+};
+
+// the rules as weights of e, a, b and d out of 16: the original
+// interpolations (3:1, 2:1:1, 5:2:1, 6:1:1, 2:3:3, 14:1:1) scaled up,
+// which truncate to the same values. rules 12-19 pick between two sets
+// by whether two neighbours are alike: b and d, b and f, or d and h
+enum { HQ2X_NO_TEST, HQ2X_BD, HQ2X_BF, HQ2X_DH };
+static const struct {
+  uint8_t test;
+  // [alike][weight]
+  uint8_t w[2][4];
+} hq2x_weights[20] = {
+  {HQ2X_NO_TEST, {{16, 0, 0, 0}, {16, 0, 0, 0}}},
+  {HQ2X_NO_TEST, {{12, 4, 0, 0}, {12, 4, 0, 0}}},
+  {HQ2X_NO_TEST, {{12, 0, 0, 4}, {12, 0, 0, 4}}},
+  {HQ2X_NO_TEST, {{12, 0, 4, 0}, {12, 0, 4, 0}}},
+  {HQ2X_NO_TEST, {{8, 0, 4, 4},  {8, 0, 4, 4}}},
+  {HQ2X_NO_TEST, {{8, 4, 4, 0},  {8, 4, 4, 0}}},
+  {HQ2X_NO_TEST, {{8, 4, 0, 4},  {8, 4, 0, 4}}},
+  // 7-11 are never picked
+  {HQ2X_NO_TEST, {{16, 0, 0, 0}, {16, 0, 0, 0}}},
+  {HQ2X_NO_TEST, {{16, 0, 0, 0}, {16, 0, 0, 0}}},
+  {HQ2X_NO_TEST, {{16, 0, 0, 0}, {16, 0, 0, 0}}},
+  {HQ2X_NO_TEST, {{16, 0, 0, 0}, {16, 0, 0, 0}}},
+  {HQ2X_NO_TEST, {{16, 0, 0, 0}, {16, 0, 0, 0}}},
+  {HQ2X_BD,      {{16, 0, 0, 0}, {8, 0, 4, 4}}},
+  {HQ2X_BD,      {{16, 0, 0, 0}, {4, 0, 6, 6}}},
+  {HQ2X_BD,      {{16, 0, 0, 0}, {14, 0, 1, 1}}},
+  {HQ2X_BD,      {{12, 4, 0, 0}, {8, 0, 4, 4}}},
+  {HQ2X_BD,      {{12, 4, 0, 0}, {12, 0, 2, 2}}},
+  {HQ2X_BD,      {{12, 4, 0, 0}, {4, 0, 6, 6}}},
+  {HQ2X_BF,      {{12, 0, 0, 4}, {10, 0, 4, 2}}},
+  {HQ2X_DH,      {{12, 0, 4, 0}, {10, 0, 2, 4}}},
+};
+
+// one output pixel by rule, in the top left frame: a is the diagonal
+// neighbour, b and d the vertical and horizontal ones, f and h the ones
+// across from d and b. the scalar path, sse2 does the same sums 8 wide
+uint32_t VideoFilter::hq2x_pixel(int rule, const uint16_t n[9], const uint32_t c[9], const uint8_t frame[5]) const {
+  bool alike = false;
+  switch (hq2x_weights[rule].test) {
+    case HQ2X_BD: alike = !differs(n[frame[1]], n[frame[2]]); break;
+    case HQ2X_BF: alike = !differs(n[frame[1]], n[frame[3]]); break;
+    case HQ2X_DH: alike = !differs(n[frame[2]], n[frame[4]]); break;
+  }
+  const uint8_t* w = hq2x_weights[rule].w[alike];
+  uint32_t ce = c[4], ca = c[frame[0]], cb = c[frame[1]], cd = c[frame[2]];
+  uint32_t rb = ((ce & 0xFF00FF) * w[0] + (ca & 0xFF00FF) * w[1]
+               + (cb & 0xFF00FF) * w[2] + (cd & 0xFF00FF) * w[3]) >> 4;
+  uint32_t g = ((ce & 0x00FF00) * w[0] + (ca & 0x00FF00) * w[1]
+              + (cb & 0x00FF00) * w[2] + (cd & 0x00FF00) * w[3]) >> 4;
+  return 0xFF000000 | (rb & 0xFF00FF) | (g & 0x00FF00);
+}
+
+// the patterns, and whether each pair of edge neighbours is alike, are
+// yuv comparisons done 8 pixels at a time. the rules are looked up per
+// pixel into weights, and the weighted sums are again 8 pixels at a time.
+// pixels whose edge neighbours are e itself and differ from nothing keep
+// e: every rule such a pattern picks gives it
+void VideoFilter::hq2x_line(const uint16_t* index, int y, uint32_t* out, int pitch) {
+  uint16_t above[ROW], line[ROW], below[ROW];
+  load_row(index, y - 1, above);
+  load_row(index, y, line);
+  load_row(index, y + 1, below);
+
+  const uint16_t* rows[3] = {above, line, below};
+  uint32_t colour[3][ROW];
+  for (int r = 0; r < 3; r++) {
+    palette->to_argb(rows[r], colour[r], ROW);
+  }
+
+  uint32_t* top = out;
+  uint32_t* bottom = (uint32_t*) ((uint8_t*) out + pitch);
+
+  #ifdef __SSE2__
+  // the three rows as y, u, v planes
+  int16_t planes[3][3][ROW];
+  for (int r = 0; r < 3; r++) {
+    for (int i = 0; i < ROW; i++) {
+      uint16_t v = rows[r][i] & (Palette::SIZE - 1);
+      planes[r][0][i] = yuv[0][v];
+      planes[r][1][i] = yuv[1][v];
+      planes[r][2][i] = yuv[2][v];
+    }
+  }
+
+  const __m128i y_threshold = _mm_set1_epi16(Y_THRESHOLD);
+  const __m128i u_threshold = _mm_set1_epi16(U_THRESHOLD);
+  const __m128i v_threshold = _mm_set1_epi16(V_THRESHOLD);
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i alpha = _mm_set1_epi32(0xFF000000);
+
+  struct Yuv { __m128i y, u, v; };
+  auto load = [&planes](int r, int x) -> Yuv {
+    return {_mm_loadu_si128((const __m128i*) (planes[r][0] + x)),
+            _mm_loadu_si128((const __m128i*) (planes[r][1] + x)),
+            _mm_loadu_si128((const __m128i*) (planes[r][2] + x))};
+  };
+  // all ones where the two colours differ visibly
+  auto differ = [&](const Yuv &a, const Yuv &b) -> __m128i {
+    auto over = [](__m128i p, __m128i q, __m128i threshold) {
+      __m128i d = _mm_sub_epi16(_mm_max_epi16(p, q), _mm_min_epi16(p, q));
+      return _mm_cmpgt_epi16(d, threshold);
+    };
+    return _mm_or_si128(_mm_or_si128(over(a.y, b.y, y_threshold), over(a.u, b.u, u_threshold)),
+                        over(a.v, b.v, v_threshold));
+  };
+  auto bit = [](__m128i mask, int n) {
+    return _mm_and_si128(mask, _mm_set1_epi16(1 << n));
+  };
+
+  // a, b and d of each output pixel's frame as (row, column offset)
+  static const int frame_row[4][3] = {{0, 0, 1}, {0, 1, 0}, {2, 2, 1}, {2, 1, 2}};
+  static const int frame_col[4][3] = {{-1, 0, -1}, {1, 1, 0}, {1, 0, 1}, {-1, -1, 0}};
+  // which edge pair (bd, bf, fh, hd) a rule's test is on, from output
+  // pixel k's frame it is pair (k + shift) & 3
+  static const int pair_shift[4] = {0, 0, 1, 3};
+
+  for (int x = 0; x < 256; x += 8) {
+    int c = PAD + x;
+    Yuv w1 = load(0, c - 1), w2 = load(0, c), w3 = load(0, c + 1);
+    Yuv w4 = load(1, c - 1), w5 = load(1, c), w6 = load(1, c + 1);
+    Yuv w7 = load(2, c - 1), w8 = load(2, c), w9 = load(2, c + 1);
+
+    // bits 0-7 the pattern, 8-11 the edge pairs that differ
+    __m128i bits = _mm_or_si128(
+      _mm_or_si128(_mm_or_si128(bit(differ(w5, w1), 0), bit(differ(w5, w2), 1)),
+                   _mm_or_si128(bit(differ(w5, w3), 2), bit(differ(w5, w4), 3))),
+      _mm_or_si128(_mm_or_si128(bit(differ(w5, w6), 4), bit(differ(w5, w7), 5)),
+                   _mm_or_si128(bit(differ(w5, w8), 6), bit(differ(w5, w9), 7))));
+    __m128i pattern = _mm_and_si128(bits, _mm_set1_epi16(0xFF));
+    bits = _mm_or_si128(bits,
+      _mm_or_si128(_mm_or_si128(bit(differ(w2, w4), 8), bit(differ(w2, w6), 9)),
+                   _mm_or_si128(bit(differ(w6, w8), 10), bit(differ(w8, w4), 11))));
+
+    __m128i e = _mm_loadu_si128((const __m128i*) (line + c));
+    __m128i same = _mm_and_si128(
+      _mm_and_si128(_mm_cmpeq_epi16(e, _mm_loadu_si128((const __m128i*) (above + c))),
+                    _mm_cmpeq_epi16(e, _mm_loadu_si128((const __m128i*) (below + c)))),
+      _mm_and_si128(_mm_cmpeq_epi16(e, _mm_loadu_si128((const __m128i*) (line + c - 1))),
+                    _mm_cmpeq_epi16(e, _mm_loadu_si128((const __m128i*) (line + c + 1)))));
+    __m128i flat = _mm_and_si128(same, _mm_cmpeq_epi16(pattern, zero));
+
+    // most blocks are flat, every pixel just doubles
+    if (_mm_movemask_epi8(flat) == 0xFFFF) {
+      for (int half = 0; half < 2; half++) {
+        __m128i ce = _mm_loadu_si128((const __m128i*) (colour[1] + c + 4 * half));
+        __m128i lo = _mm_unpacklo_epi32(ce, ce);
+        __m128i hi = _mm_unpackhi_epi32(ce, ce);
+        _mm_storeu_si128((__m128i*) (top + 2 * x + 8 * half), lo);
+        _mm_storeu_si128((__m128i*) (top + 2 * x + 8 * half + 4), hi);
+        _mm_storeu_si128((__m128i*) (bottom + 2 * x + 8 * half), lo);
+        _mm_storeu_si128((__m128i*) (bottom + 2 * x + 8 * half + 4), hi);
+      }
+      continue;
+    }
+
+    // flat lanes become -1
+    int16_t lanes[8];
+    _mm_storeu_si128((__m128i*) lanes, _mm_or_si128(bits, flat));
+
+    // weights of e, a, b, d per output pixel, as 16 bit lanes
+    int16_t weights[4][4][8];
+    for (int l = 0; l < 8; l++) {
+      if (lanes[l] < 0) {
+        for (int k = 0; k < 4; k++) {
+          weights[k][0][l] = 16;
+          weights[k][1][l] = weights[k][2][l] = weights[k][3][l] = 0;
+        }
+        continue;
+      }
+      uint8_t p = lanes[l] & 0xFF;
+      int pairs = lanes[l] >> 8;
+      for (int k = 0; k < 4; k++) {
+        int rule = hq2x_rules[p];
+        int test = hq2x_weights[rule].test;
+        bool alike = test != HQ2X_NO_TEST && !((pairs >> ((k + pair_shift[test]) & 3)) & 1);
+        const uint8_t* w = hq2x_weights[rule].w[alike];
+        for (int j = 0; j < 4; j++) {
+          weights[k][j][l] = w[j];
+        }
+        p = hq2x_rotate(p);
+      }
+    }
+
+    // the weighted sums, two pixels of 4 channels per step
+    uint32_t px[4][8];
+    for (int k = 0; k < 4; k++) {
+      const uint32_t* src[4] = {
+        colour[1] + c,
+        colour[frame_row[k][0]] + c + frame_col[k][0],
+        colour[frame_row[k][1]] + c + frame_col[k][1],
+        colour[frame_row[k][2]] + c + frame_col[k][2],
+      };
+      __m128i acc[4] = {zero, zero, zero, zero};
+      for (int j = 0; j < 4; j++) {
+        __m128i w = _mm_loadu_si128((const __m128i*) weights[k][j]);
+        __m128i w_lo = _mm_unpacklo_epi16(w, w), w_hi = _mm_unpackhi_epi16(w, w);
+        __m128i w4[4] = {_mm_unpacklo_epi32(w_lo, w_lo), _mm_unpackhi_epi32(w_lo, w_lo),
+                         _mm_unpacklo_epi32(w_hi, w_hi), _mm_unpackhi_epi32(w_hi, w_hi)};
+        for (int h = 0; h < 4; h++) {
+          __m128i colours = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*) (src[j] + 2 * h)), zero);
+          acc[h] = _mm_add_epi16(acc[h], _mm_mullo_epi16(colours, w4[h]));
+        }
+      }
+      for (int h = 0; h < 4; h += 2) {
+        __m128i packed = _mm_packus_epi16(_mm_srli_epi16(acc[h], 4), _mm_srli_epi16(acc[h + 1], 4));
+        _mm_storeu_si128((__m128i*) (px[k] + 2 * h), _mm_or_si128(packed, alpha));
+      }
+    }
+
+    // top left with top right, bottom left with bottom right
+    static const int left[2] = {0, 3}, right[2] = {1, 2};
+    for (int r = 0; r < 2; r++) {
+      uint32_t* dst = (r == 0 ? top : bottom) + 2 * x;
+      for (int half = 0; half < 2; half++) {
+        __m128i l = _mm_loadu_si128((const __m128i*) (px[left[r]] + 4 * half));
+        __m128i rt = _mm_loadu_si128((const __m128i*) (px[right[r]] + 4 * half));
+        _mm_storeu_si128((__m128i*) (dst + 8 * half), _mm_unpacklo_epi32(l, rt));
+        _mm_storeu_si128((__m128i*) (dst + 8 * half + 4), _mm_unpackhi_epi32(l, rt));
+      }
+    }
+  }
+  #else
+  uint32_t* px[4];
+  for (int x = 0; x < 256; x++) {
+    int c = PAD + x;
+    uint16_t n[9];
+    uint32_t col[9];
+    for (int r = 0; r < 3; r++) {
+      for (int k = 0; k < 3; k++) {
+        n[3 * r + k] = rows[r][c + k - 1];
+        col[3 * r + k] = colour[r][c + k - 1];
+      }
+    }
+    uint8_t p = 0;
+    static const int bit_order[8] = {0, 1, 2, 3, 5, 6, 7, 8};
+    for (int k = 0; k < 8; k++) {
+      if (this->differs(n[4], n[bit_order[k]])) {
+        p |= 1 << k;
+      }
+    }
+    px[0] = top + 2 * x;
+    px[1] = top + 2 * x + 1;
+    px[2] = bottom + 2 * x + 1;
+    px[3] = bottom + 2 * x;
+    for (int k = 0; k < 4; k++) {
+      *px[k] = this->hq2x_pixel(hq2x_rules[p], n, col, hq2x_frame[k]);
+      p = hq2x_rotate(p);
+    }
+  }
+  #endif
+}
+
+// the ppu outputs a square wave per pixel: 8 samples at 12 samples per
+// colour burst cycle, its phase picks the hue and its levels the brightness
+// https://www.nesdev.org/wiki/NTSC_video
+static float ntsc_signal(int index, int phase) {
+  static const float levels[8] = {
+    0.350f, 0.518f, 0.962f, 1.550f,  // signal low
+    1.094f, 1.506f, 1.962f, 1.962f   // signal high
+  };
+  const float black = 0.518f;
+  const float white = 1.962f;
+  const float attenuation = 0.746f;
+
+  int colour = index & 0x0F;
+  int level = (index >> 4) & 0x03;
+  int emphasis = (index >> 6) & 0x07;
+  if (colour > 13) {
+    level = 1;
+  }
+
+  float low = levels[level];
+  float high = levels[4 + level];
+  if (colour == 0) {
+    low = high;
+  }
+  if (colour > 12) {
+    high = low;
+  }
+
+  auto in_phase = [phase](int c) { return (c + phase) % 12 < 6; };
+  float signal = in_phase(colour) ? high : low;
+  if (((emphasis & 1) && in_phase(0))
+   || ((emphasis & 2) && in_phase(4))
+   || ((emphasis & 4) && in_phase(8))) {
+    signal *= attenuation;
+  }
+  return (signal - black) / (white - black);
+}
+
+// the decoder is linear, so instead of running it per frame the output of
+// every (phase, index, neighbour) combination is worked out up front and a
+// frame becomes a sum of 5 table entries per output pixel
+void VideoFilter::build_ntsc_kernel() {
+  // where the 3 output samples of a pixel sit within its 8 signal samples
+  const int sub_pos[3] = {1, 4, 6};
+  // rotates the demodulator so the hues line up with the rgb palette
+  const float hue = 8.35f;
+  const float saturation = 1.0f;
+  const float pi = 3.14159265f;
+
+  // luma: one burst cycle box filter, removes the subcarrier entirely
+  // chroma: two cycle hann window, softer colour edges like a real tv
+  float chroma_window[24];
+  float chroma_sum = 0.0f;
+  for (int k = 0; k < 24; k++) {
+    chroma_window[k] = 0.5f - 0.5f * cosf(2.0f * pi * (k + 0.5f) / 24.0f);
+    chroma_sum += chroma_window[k];
+  }
+  const float chroma_gain = 2.0f * saturation / chroma_sum;
+
+  const int taps = NTSC_TAPS;
+  const int half = taps / 2;
+  ntsc_kernel.assign(3 * Palette::SIZE * taps * 3 * 4, 0.0f);
+
+  for (int p = 0; p < 3; p++) {
+    int pixel_phase = p * 4;
+    for (int index = 0; index < Palette::SIZE; index++) {
+      float signal[12];
+      for (int k = 0; k < 12; k++) {
+        signal[k] = ntsc_signal(index, k);
+      }
+
+      for (int tap = 0; tap < taps; tap++) {
+        int d = tap - half;
+        for (int sub = 0; sub < 3; sub++) {
+          float yv = 0.0f, iv = 0.0f, qv = 0.0f;
+          int x = sub_pos[sub];
+
+          // samples of the neighbouring pixel, relative to this pixel's start
+          for (int t = 8 * d; t < 8 * d + 8; t++) {
+            int abs_phase = ((pixel_phase + t) % 12 + 12) % 12;
+            float s = signal[abs_phase];
+            if (t >= x - 6 && t < x + 6) {
+              yv += s / 12.0f;
+            }
+            if (t >= x - 12 && t < x + 12) {
+              float w = chroma_window[t - x + 12] * chroma_gain;
+              float angle = 2.0f * pi * (abs_phase - hue) / 12.0f;
+              iv += s * w * cosf(angle);
+              qv += s * w * sinf(angle);
+            }
+          }
+
+          float r = yv + 0.946882f * iv + 0.623557f * qv;
+          float g = yv - 0.274788f * iv - 0.635691f * qv;
+          float b = yv - 1.108545f * iv + 1.709007f * qv;
+
+          float* k = &ntsc_kernel[((((p * Palette::SIZE) + index) * taps + tap) * 3 + sub) * 4];
+          // bgra so the packed bytes read back as ARGB on little endian
+          k[0] = b * 255.0f;
+          k[1] = g * 255.0f;
+          k[2] = r * 255.0f;
+          k[3] = 0.0f;
+        }
+      }
+    }
+  }
+}
+
+void VideoFilter::ntsc_line(const uint16_t* index, int y, uint32_t* out, int pitch) {
+  uint16_t line[ROW];
+  load_row(index, y, line);
+
+  const int taps = NTSC_TAPS;
+  const int half = taps / 2;
+  const int stride = taps * 3 * 4;
+  // a line is 341 dots of 8 samples, so the phase moves by 4 every line
+  // it is kept the same between frames so a still picture stays still
+  int phase = (y * 4) % 12;
+
+  for (int x = 0; x < 256; x++) {
+    int p = ((phase + 8 * x) % 12) / 4;
+    const float* base = &ntsc_kernel[(size_t) p * Palette::SIZE * stride];
+
+    #ifdef __SSE2__
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+    __m128 acc2 = _mm_setzero_ps();
+    for (int tap = 0; tap < taps; tap++) {
+      uint16_t v = line[PAD + x + tap - half] & (Palette::SIZE - 1);
+      const float* k = base + v * stride + tap * 12;
+      acc0 = _mm_add_ps(acc0, _mm_loadu_ps(k));
+      acc1 = _mm_add_ps(acc1, _mm_loadu_ps(k + 4));
+      acc2 = _mm_add_ps(acc2, _mm_loadu_ps(k + 8));
+    }
+    // saturating packs do the clamping to 0-255
+    __m128i lo = _mm_packs_epi32(_mm_cvtps_epi32(acc0), _mm_cvtps_epi32(acc1));
+    __m128i hi = _mm_packs_epi32(_mm_cvtps_epi32(acc2), _mm_setzero_si128());
+    __m128i px = _mm_or_si128(_mm_packus_epi16(lo, hi), _mm_set1_epi32(0xFF000000));
+    if (x < 255) {
+      // the 4th pixel is garbage and gets overwritten by the next one
+      _mm_storeu_si128((__m128i*) (out + 3 * x), px);
+    }
+    else {
+      uint32_t tail[4];
+      _mm_storeu_si128((__m128i*) tail, px);
+      memcpy(out + 3 * x, tail, 3 * sizeof(uint32_t));
+    }
+    #else
+    float acc[12] = {0};
+    for (int tap = 0; tap < taps; tap++) {
+      uint16_t v = line[PAD + x + tap - half] & (Palette::SIZE - 1);
+      const float* k = base + v * stride + tap * 12;
+      for (int j = 0; j < 12; j++) {
+        acc[j] += k[j];
+      }
+    }
+    for (int sub = 0; sub < 3; sub++) {
+      uint32_t px = 0xFF000000;
+      for (int c = 0; c < 3; c++) {
+        int v = (int) lrintf(acc[sub * 4 + c]);
+        v = std::min(std::max(v, 0), 255);
+        px |= (uint32_t) v << (8 * c);
+      }
+      out[3 * x + sub] = px;
+    }
+    #endif
+  }
+
+  // every output line of this scanline is the same
+  for (int r = 1; r < 3; r++) {
+    memcpy((uint8_t*) out + r * pitch, out, 768 * sizeof(uint32_t));
+  }
+}
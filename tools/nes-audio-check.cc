@@ -0,0 +1,157 @@
+// bounds the error of the fixed point audio path against the float one
+//
+// drives the apu alone (no cartridge, no cpu) with random register writes
+// for all five channels and takes both mixes at every output sample of
+// the same channel state: get_audio_sample() through AudioFilter::process
+// and get_audio_sample_q15() through process_q15, one frame block at a
+// time like the bus does. both are turned into the int16 ring codes and
+// compared. exits non-zero if any sample differs by more than the bound
+//
+// usage: nes-audio-check [--seconds n] [--bound lsb] [--seed n]
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "audio_filter.hh"
+#include "bus.hh"
+
+// ntsc cpu clocks per second
+static const double CPU_RATE = 1789773.0;
+
+// random but audible settings: constant volume, lengths halted, periods
+// above the pulse cutoff. the dmc level is set directly, its sample
+// playback needs a cartridge
+static void write_random(APU &apu, std::mt19937 &rng) {
+    switch (rng() % 5) {
+        case 0:
+        case 1: {
+            uint16_t base = (rng() & 1) ? 0x4004 : 0x4000;
+            apu.cpu_write(base, (rng() & 0xC0) | 0x30 | (rng() & 0x0F));
+            apu.cpu_write(base + 2, rng() & 0xFF);
+            apu.cpu_write(base + 3, 0x08 | (rng() & 0x07));
+            break;
+        }
+        case 2:
+            apu.cpu_write(0x4008, 0xFF);
+            apu.cpu_write(0x400A, rng() & 0xFF);
+            apu.cpu_write(0x400B, 0x08 | (rng() & 0x07));
+            break;
+        case 3:
+            apu.cpu_write(0x400C, 0x30 | (rng() & 0x0F));
+            apu.cpu_write(0x400E, rng() & 0x8F);
+            apu.cpu_write(0x400F, 0x08);
+            break;
+        case 4:
+            apu.cpu_write(0x4011, rng() & 0x7F);
+            break;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    double seconds = 10.0;
+    int bound = 2;
+    uint32_t seed = 1;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--seconds" && i + 1 < argc) {
+            seconds = atof(argv[++i]);
+        }
+        else if (arg == "--bound" && i + 1 < argc) {
+            bound = atoi(argv[++i]);
+        }
+        else if (arg == "--seed" && i + 1 < argc) {
+            seed = strtoul(argv[++i], nullptr, 10);
+        }
+        else {
+            std::cerr << "usage: nes-audio-check [--seconds n] [--bound lsb] [--seed n]" << std::endl;
+            return -1;
+        }
+    }
+
+    // the bus only provides the scheduler for the frame counter
+    std::unique_ptr<Bus> nes = std::make_unique<Bus>();
+    APU &apu = nes->rp.apu;
+    apu.reset();
+    apu.cpu_write(0x4015, 0x0F);
+
+    std::mt19937 rng(seed);
+    AudioFilter filter_float, filter_q15;
+    std::vector<float> block_float;
+    std::vector<int32_t> block_q15;
+
+    uint64_t n_samples = 0;
+    uint64_t histogram[4] = {0};
+    int worst = 0;
+    uint64_t worst_at = 0;
+    int mix_worst = 0;
+    int peak = 0;
+
+    auto flush = [&]() {
+        filter_float.process(block_float.data(), (int) block_float.size());
+        filter_q15.process_q15(block_q15.data(), (int) block_q15.size());
+        for (size_t i = 0; i < block_float.size(); i++) {
+            int16_t reference = AudioFilter::to_int16(block_float[i]);
+            int diff = abs(reference - AudioFilter::to_int16_q15(block_q15[i]));
+            peak = std::max(peak, abs(reference));
+            histogram[std::min(diff, 3)]++;
+            if (diff > worst) {
+                worst = diff;
+                worst_at = n_samples + i;
+            }
+        }
+        n_samples += block_float.size();
+        block_float.clear();
+        block_q15.clear();
+    };
+
+    // the bus resamples every 122 ppu clocks, a frame is ~735 samples
+    uint64_t end = (uint64_t) (seconds * CPU_RATE);
+    uint64_t next_write = 0;
+    uint64_t ppu_clocks = 0;
+    for (uint64_t t = 0; t < end; t++) {
+        if (t == next_write) {
+            write_random(apu, rng);
+            next_write += 100 + rng() % 4000;
+        }
+        nes->scheduler.run(nes->cpu_clocks);
+        apu.clk();
+        nes->cpu_clocks++;
+
+        ppu_clocks += 3;
+        if (ppu_clocks >= Bus::AUDIO_RESAMPLE_PERIOD) {
+            ppu_clocks -= Bus::AUDIO_RESAMPLE_PERIOD;
+            float mix = apu.get_audio_sample();
+            int32_t mix_q15 = apu.get_audio_sample_q15();
+            mix_worst = std::max(mix_worst, abs(AudioFilter::to_int16(mix) - AudioFilter::to_int16_q15(mix_q15)));
+            block_float.push_back(mix);
+            block_q15.push_back(mix_q15);
+            if (block_float.size() == 735) {
+                flush();
+            }
+        }
+    }
+    flush();
+
+    // a silent run would pass without testing anything
+    if (peak < 1000) {
+        printf("FAIL: output peaked at %d, the channels didn't play\n", peak);
+        return 1;
+    }
+    printf("%llu samples (peak %d), mixer max error %d lsb, after filters max error %d lsb (sample %llu)\n",
+           (unsigned long long) n_samples, peak, mix_worst, worst, (unsigned long long) worst_at);
+    printf("error 0: %llu, 1: %llu, 2: %llu, 3+: %llu\n",
+           (unsigned long long) histogram[0], (unsigned long long) histogram[1],
+           (unsigned long long) histogram[2], (unsigned long long) histogram[3]);
+    if (worst > bound) {
+        printf("FAIL: above the bound of %d lsb\n", bound);
+        return 1;
+    }
+    printf("ok, within %d lsb\n", bound);
+    return 0;
+}
@@ -0,0 +1,592 @@
+// runs many emulation jobs at once, e.g. a regression suite
+//
+// the manifest is a JSONL file with one job per line:
+//
+//   {"id": "smb-title", "rom": "smb.nes", "frames": 600,
+//    "screenshot": "out/smb.png"}
+//   {"rom": "smb.nes", "movie": "smb.nesmov", "timeout": 30}
+//   {"rom": "smb.nes", "frames": 300, "input": [[0, 0], [120, 8], [130, 0]]}
+//
+// rom is required. input comes from a movie (played from its start state)
+// or from an input script of [frame, port0] or [frame, port0, port1]
+// entries, each holding until the next one. frames defaults to the rest
+// of the movie, timeout (seconds) to --timeout. a job stops when it runs
+// out of time and is reported with the frames it got through
+//
+// every job gets its own machine, roms are loaded once and shared through
+// the rom cache. the jobs run on a work stealing thread pool and results
+// are appended to the output as each job finishes, one JSON object per
+// line: the job's line in the manifest, status (ok, timeout or error),
+// frames, time, the final state hash and per component hashes, and the
+// screenshot of the last frame if one was asked for
+//
+// with --index (see nes-index), rom can also be a title or a hash from
+// the library index
+//
+// usage: nes-batch manifest.jsonl results.jsonl [--threads n] [--timeout seconds]
+//                  [--index library.nesidx]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "bus.hh"
+#include "cartridge.hh"
+#include "hash64.hh"
+#include "movie.hh"
+#include "rom_index.hh"
+#include "state.hh"
+#include "thread_pool.hh"
+#include "video_capture.hh"
+#include "video_filter.hh"
+
+// just enough JSON for the manifest: objects, arrays, strings, numbers
+// and literals
+struct Json {
+    enum Type {
+        NONE,
+        BOOL,
+        NUMBER,
+        STRING,
+        ARRAY,
+        OBJECT
+    };
+    Type type = NONE;
+    bool boolean = false;
+    double number = 0.0;
+    std::string string;
+    std::vector<Json> items;
+    std::vector<std::pair<std::string, Json>> fields;
+
+    const Json* get(const std::string &key) const {
+        for (const auto &field : fields) {
+            if (field.first == key) {
+                return &field.second;
+            }
+        }
+        return nullptr;
+    }
+};
+
+class JsonParser {
+public:
+    JsonParser(const std::string &text) : p(text.c_str()) {}
+
+    // false with error set if the text is not a single JSON value
+    bool parse(Json &value) {
+        if (!this->value(value)) {
+            return false;
+        }
+        this->space();
+        if (*p) {
+            error = "trailing characters";
+            return false;
+        }
+        return true;
+    }
+
+    std::string error;
+
+private:
+    const char* p;
+
+    void space() {
+        while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') {
+            p++;
+        }
+    }
+
+    bool literal(const char* word) {
+        size_t n = strlen(word);
+        if (strncmp(p, word, n) != 0) {
+            error = "unexpected character";
+            return false;
+        }
+        p += n;
+        return true;
+    }
+
+    bool value(Json &v) {
+        this->space();
+        if (*p == '{') {
+            v.type = Json::OBJECT;
+            p++;
+            this->space();
+            if (*p == '}') {
+                p++;
+                return true;
+            }
+            while (true) {
+                this->space();
+                std::pair<std::string, Json> field;
+                if (*p != '"' || !this->string(field.first)) {
+                    error = "expected a key";
+                    return false;
+                }
+                this->space();
+                if (*p++ != ':') {
+                    error = "expected ':'";
+                    return false;
+                }
+                if (!this->value(field.second)) {
+                    return false;
+                }
+                v.fields.push_back(std::move(field));
+                this->space();
+                if (*p == ',') {
+                    p++;
+                    continue;
+                }
+                if (*p++ != '}') {
+                    error = "expected ',' or '}'";
+                    return false;
+                }
+                return true;
+            }
+        }
+        if (*p == '[') {
+            v.type = Json::ARRAY;
+            p++;
+            this->space();
+            if (*p == ']') {
+                p++;
+                return true;
+            }
+            while (true) {
+                v.items.emplace_back();
+                if (!this->value(v.items.back())) {
+                    return false;
+                }
+                this->space();
+                if (*p == ',') {
+                    p++;
+                    continue;
+                }
+                if (*p++ != ']') {
+                    error = "expected ',' or ']'";
+                    return false;
+                }
+                return true;
+            }
+        }
+        if (*p == '"') {
+            v.type = Json::STRING;
+            return this->string(v.string);
+        }
+        if (*p == 't' || *p == 'f') {
+            v.type = Json::BOOL;
+            v.boolean = *p == 't';
+            return this->literal(v.boolean ? "true" : "false");
+        }
+        if (*p == 'n') {
+            return this->literal("null");
+        }
+        char* end;
+        v.number = strtod(p, &end);
+        if (end == p) {
+            error = "unexpected character";
+            return false;
+        }
+        v.type = Json::NUMBER;
+        p = end;
+        return true;
+    }
+
+    // paths are the only strings, \u escapes are kept to latin-1
+    bool string(std::string &s) {
+        p++;
+        while (*p && *p != '"') {
+            if (*p != '\\') {
+                s += *p++;
+                continue;
+            }
+            p++;
+            switch (*p) {
+                case 'n': s += '\n'; break;
+                case 't': s += '\t'; break;
+                case 'r': s += '\r'; break;
+                case 'b': s += '\b'; break;
+                case 'f': s += '\f'; break;
+                case 'u':
+                    if (strlen(p) < 5) {
+                        error = "bad escape";
+                        return false;
+                    }
+                    s += (char) strtol(std::string(p + 1, 4).c_str(), nullptr, 16);
+                    p += 4;
+                    break;
+                case 0:
+                    error = "unterminated string";
+                    return false;
+                default: s += *p; break;
+            }
+            p++;
+        }
+        if (*p != '"') {
+            error = "unterminated string";
+            return false;
+        }
+        p++;
+        return true;
+    }
+};
+
+static std::string quote(const std::string &s) {
+    std::string out = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        }
+        else if ((uint8_t) c < 0x20) {
+            char escape[8];
+            snprintf(escape, sizeof(escape), "\\u%04x", c);
+            out += escape;
+        }
+        else {
+            out += c;
+        }
+    }
+    return out + "\"";
+}
+
+struct Job {
+    // line in the manifest, from 1
+    int line = 0;
+    std::string id;
+    std::string rom_path;
+    std::string movie_path;
+    // input script, sorted by frame
+    struct Input {
+        uint64_t frame;
+        uint8_t ports[2];
+    };
+    std::vector<Input> script;
+    // 0 = until the end of the movie
+    uint64_t frames = 0;
+    double timeout = 0.0;
+    std::string screenshot;
+    // set when the manifest line itself was bad
+    std::string error;
+};
+
+struct Batch {
+    std::vector<Job> jobs;
+    double timeout = 600.0;
+
+    FILE* out = nullptr;
+    std::mutex out_lock;
+
+    std::atomic<int> finished{0};
+    std::atomic<int> failed{0};
+};
+
+static bool read_manifest(const std::string &path, Batch &batch) {
+    FILE* f = fopen(path.c_str(), "r");
+    if (!f) {
+        return false;
+    }
+    std::string line;
+    int number = 0;
+    int c;
+    do {
+        c = fgetc(f);
+        if (c != '\n' && c != EOF) {
+            line += (char) c;
+            continue;
+        }
+        number++;
+        if (line.find_first_not_of(" \t\r") == std::string::npos) {
+            line.clear();
+            continue;
+        }
+
+        Job job;
+        job.line = number;
+        job.id = std::to_string(number);
+        job.timeout = batch.timeout;
+
+        Json v;
+        JsonParser parser(line);
+        bool parsed = parser.parse(v);
+        line.clear();
+        if (!parsed || v.type != Json::OBJECT) {
+            job.error = "bad manifest line: " + (parser.error.empty() ? "not an object" : parser.error);
+            batch.jobs.push_back(job);
+            continue;
+        }
+
+        const Json* field;
+        if ((field = v.get("id"))) {
+            job.id = field->type == Json::STRING ? field->string : std::to_string((long long) field->number);
+        }
+        if ((field = v.get("rom")) && field->type == Json::STRING) {
+            job.rom_path = field->string;
+        }
+        if ((field = v.get("movie")) && field->type == Json::STRING) {
+            job.movie_path = field->string;
+        }
+        if ((field = v.get("frames")) && field->type == Json::NUMBER) {
+            job.frames = (uint64_t) std::max(0.0, field->number);
+        }
+        if ((field = v.get("timeout")) && field->type == Json::NUMBER) {
+            job.timeout = field->number;
+        }
+        if ((field = v.get("screenshot")) && field->type == Json::STRING) {
+            job.screenshot = field->string;
+        }
+        if ((field = v.get("input")) && field->type == Json::ARRAY) {
+            for (const Json &entry : field->items) {
+                if (entry.type != Json::ARRAY || entry.items.size() < 2 || entry.items.size() > 3) {
+                    job.error = "input entries are [frame, port0] or [frame, port0, port1]";
+                    break;
+                }
+                Job::Input input = {(uint64_t) entry.items[0].number, {0, 0}};
+                for (size_t port = 1; port < entry.items.size(); port++) {
+                    input.ports[port - 1] = (uint8_t) entry.items[port].number;
+                }
+                job.script.push_back(input);
+            }
+            std::stable_sort(job.script.begin(), job.script.end(), [](const Job::Input &a, const Job::Input &b) {
+                return a.frame < b.frame;
+            });
+        }
+
+        if (job.error.empty() && job.rom_path.empty()) {
+            job.error = "job has no rom";
+        }
+        else if (job.error.empty() && job.movie_path.empty() && job.frames == 0) {
+            job.error = "job needs a movie or a frame count";
+        }
+        batch.jobs.push_back(job);
+    } while (c != EOF);
+    fclose(f);
+    return true;
+}
+
+struct Result {
+    std::string status = "ok";
+    std::string error;
+    uint64_t frames = 0;
+    double seconds = 0.0;
+    bool hashed = false;
+    uint64_t hash = 0;
+    uint64_t component_hash[Bus::N_STATE_COMPONENTS] = {0};
+};
+
+// last frame through the default filter into an rgb png
+static bool screenshot(const std::string &path, Bus &nes) {
+    VideoFilter filter(nullptr);
+    filter.set_palette(&nes.ppu.palette);
+    filter.set_type(VideoFilter::NEAREST);
+    int w = filter.width();
+    int h = filter.height();
+    std::vector<uint32_t> argb(w * h);
+    filter.apply(nes.ppu.frame->index, 0, 239, argb.data(), w * sizeof(uint32_t));
+    std::vector<uint8_t> rgb(w * h * 3);
+    for (int i = 0; i < w * h; i++) {
+        rgb[i * 3 + 0] = (argb[i] >> 16) & 0xFF;
+        rgb[i * 3 + 1] = (argb[i] >> 8) & 0xFF;
+        rgb[i * 3 + 2] = argb[i] & 0xFF;
+    }
+    return VideoCapture::save_png(path, rgb.data(), w, h);
+}
+
+static void run_job(const Job &job, Result &result) {
+    auto start = std::chrono::steady_clock::now();
+    auto deadline = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(job.timeout));
+
+    std::shared_ptr<Cartridge> cart = std::make_shared<Cartridge>(job.rom_path, &RomCache::global());
+    if (!cart->valid) {
+        result.error = "failed to load cartridge: " + job.rom_path;
+        return;
+    }
+    std::unique_ptr<Bus> nes = std::make_unique<Bus>();
+    nes->insert_cartridge(cart);
+    nes->reset();
+    nes->audio_output = false;
+    nes->ppu.output_mode = PPU::OUTPUT_INDEXED;
+
+    // the reader streams its input forwards, frames only ever increase
+    MovieReader movie;
+    uint64_t end_frame = job.frames;
+    if (!job.movie_path.empty()) {
+        if (!movie.open(job.movie_path)) {
+            result.error = "failed to open movie: " + job.movie_path;
+            return;
+        }
+        if (movie.rom_hash != cart->rom_hash()) {
+            result.error = "movie was recorded with a different rom";
+            return;
+        }
+        StateReader state(movie.start_state, movie.start_state_size);
+        if (!nes->load_state(state)) {
+            result.error = "movie start state does not match this build";
+            return;
+        }
+        end_frame = job.frames ? nes->frame_count + job.frames : movie.length() + 1;
+    }
+
+    Bus* bus = nes.get();
+    size_t next_input = 0;
+    uint8_t script_ports[2] = {0x00, 0x00};
+    bus->rp.input_provider = [&, bus](int port) -> uint8_t {
+        if (port < 0 || port > 1) {
+            return 0x00;
+        }
+        if (!job.movie_path.empty()) {
+            uint8_t ports[2];
+            movie.input(bus->frame_count, ports[0], ports[1]);
+            return ports[port];
+        }
+        while (next_input < job.script.size() && job.script[next_input].frame <= bus->frame_count) {
+            script_ports[0] = job.script[next_input].ports[0];
+            script_ports[1] = job.script[next_input].ports[1];
+            next_input++;
+        }
+        return script_ports[port];
+    };
+
+    // only the last frame is ever looked at
+    uint64_t first_frame = nes->frame_count;
+    nes->ppu.skip_render = true;
+    while (nes->frame_count < end_frame) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            result.status = "timeout";
+            break;
+        }
+        nes->ppu.skip_render = job.screenshot.empty() || nes->frame_count + 1 < end_frame;
+        nes->run_frame();
+    }
+    result.frames = nes->frame_count - first_frame;
+
+    nes->hash_state(result.component_hash);
+    result.hash = Hash64::hash(result.component_hash, sizeof(result.component_hash));
+    result.hashed = true;
+
+    if (result.status == "ok" && !job.screenshot.empty() && !screenshot(job.screenshot, *nes)) {
+        result.error = "failed to write screenshot: " + job.screenshot;
+    }
+}
+
+static void report(Batch &batch, const Job &job, const Result &result) {
+    std::string line = "{\"line\": " + std::to_string(job.line) + ", \"id\": " + quote(job.id);
+    std::string status = result.error.empty() ? result.status : "error";
+    line += ", \"status\": " + quote(status);
+    if (!result.error.empty()) {
+        line += ", \"error\": " + quote(result.error);
+    }
+
+    char buf[128];
+    snprintf(buf, sizeof(buf), ", \"frames\": %" PRIu64 ", \"seconds\": %.3f, \"fps\": %.1f",
+             result.frames, result.seconds, result.seconds > 0.0 ? result.frames / result.seconds : 0.0);
+    line += buf;
+
+    if (result.hashed) {
+        snprintf(buf, sizeof(buf), ", \"hash\": \"%016" PRIx64 "\", \"state\": {", result.hash);
+        line += buf;
+        for (int c = 0; c < Bus::N_STATE_COMPONENTS; c++) {
+            snprintf(buf, sizeof(buf), "%s\"%s\": \"%016" PRIx64 "\"",
+                     c ? ", " : "", Bus::component_name(c), result.component_hash[c]);
+            line += buf;
+        }
+        line += "}";
+    }
+    if (!job.screenshot.empty() && result.error.empty() && status == "ok") {
+        line += ", \"screenshot\": " + quote(job.screenshot);
+    }
+    line += "}\n";
+
+    // one write per line and flushed, a crash keeps everything so far
+    std::lock_guard<std::mutex> guard(batch.out_lock);
+    fwrite(line.data(), 1, line.size(), batch.out);
+    fflush(batch.out);
+    if (status != "ok") {
+        batch.failed++;
+    }
+    batch.finished++;
+}
+
+int main(int argc, char* argv[]) {
+    Batch batch;
+    int n_threads = 0;
+    std::string index_path;
+    std::vector<std::string> files;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--threads" && i + 1 < argc) {
+            n_threads = atoi(argv[++i]);
+        }
+        else if (arg == "--timeout" && i + 1 < argc) {
+            batch.timeout = atof(argv[++i]);
+        }
+        else if (arg == "--index" && i + 1 < argc) {
+            index_path = argv[++i];
+        }
+        else {
+            files.push_back(arg);
+        }
+    }
+    if (files.size() != 2) {
+        std::cerr << "usage: nes-batch manifest.jsonl results.jsonl [--threads n] [--timeout seconds] [--index library.nesidx]" << std::endl;
+        return -1;
+    }
+
+    if (!read_manifest(files[0], batch)) {
+        std::cerr << "failed to read manifest: " << files[0] << std::endl;
+        return -1;
+    }
+    if (!index_path.empty()) {
+        RomIndex index;
+        if (!index.open(index_path)) {
+            std::cerr << "failed to open index: " << index_path << std::endl;
+            return -1;
+        }
+        for (Job &job : batch.jobs) {
+            std::string found = index.resolve(job.rom_path);
+            if (!found.empty()) {
+                job.rom_path = found;
+            }
+        }
+    }
+
+    batch.out = fopen(files[1].c_str(), "w");
+    if (!batch.out) {
+        std::cerr << "failed to open results: " << files[1] << std::endl;
+        return -1;
+    }
+
+    ThreadPool pool(n_threads);
+    int jobs = (int) batch.jobs.size();
+    std::cerr << "running " << jobs << " jobs on " << pool.size() << " threads" << std::endl;
+    auto start = std::chrono::steady_clock::now();
+    pool.parallel_for(jobs, [&batch](int i) {
+        const Job &job = batch.jobs[i];
+        Result result;
+        auto job_start = std::chrono::steady_clock::now();
+        if (!job.error.empty()) {
+            result.error = job.error;
+        }
+        else {
+            run_job(job, result);
+        }
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - job_start).count();
+        report(batch, job, result);
+    });
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    fclose(batch.out);
+
+    printf("%d jobs in %.2fs, %d failed\n", batch.finished.load(), seconds, batch.failed.load());
+    return batch.failed ? 1 : 0;
+}
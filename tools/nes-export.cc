@@ -0,0 +1,291 @@
+// renders an input movie to a y4m video using every core
+//
+// the movie is split into segments that each start from a save state.
+// recorded movies carry keyframes already, otherwise (or with --rescan) a
+// first pass plays the movie with rendering off and keeps a save state
+// every segment. the segments are then re-emulated in parallel with
+// rendering on, each one writing its frames straight to their place in
+// the output file (y4m frames all have the same size)
+//
+// usage: nes-export rom.nes movie.nesmov out.y4m [--filter name]
+//                   [--segment seconds] [--rescan] [--threads n]
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "bus.hh"
+#include "cartridge.hh"
+#include "movie.hh"
+#include "state.hh"
+#include "thread_pool.hh"
+#include "video_capture.hh"
+#include "video_filter.hh"
+
+static const size_t FILE_BUF_SIZE = 4 << 20;
+
+struct Export {
+    std::string rom_path;
+    std::string out_path;
+    VideoFilter::Type filter = VideoFilter::NEAREST;
+
+    // input of every frame, [frame][port]
+    std::vector<std::array<uint8_t, 2>> inputs;
+    // frame the movie starts at, the output begins with it
+    uint64_t first_frame = 0;
+    uint64_t end_frame = 0;
+
+    struct Segment {
+        uint64_t begin;
+        const uint8_t* state;
+        size_t state_size;
+    };
+    std::vector<Segment> segments;
+    // states taken by scan(), the movie's own ones stay in the mapping
+    std::vector<std::vector<uint8_t>> scanned;
+    uint64_t segment_frames = 600;
+
+    int width = 0;
+    int height = 0;
+    long long header_size = 0;
+    long long frame_size = 0;
+
+    std::atomic<uint64_t> frames_done{0};
+    std::atomic<bool> failed{false};
+};
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// a machine that plays back the recorded inputs
+std::shared_ptr<Bus> make_machine(Export &ex) {
+    std::shared_ptr<Cartridge> cart = std::make_shared<Cartridge>(ex.rom_path, &RomCache::global());
+    if (!cart->valid) {
+        return nullptr;
+    }
+    std::shared_ptr<Bus> nes = std::make_shared<Bus>();
+    nes->insert_cartridge(cart);
+    nes->reset();
+    nes->audio_output = false;
+    nes->ppu.output_mode = PPU::OUTPUT_INDEXED;
+
+    Bus* bus = nes.get();
+    nes->rp.input_provider = [&ex, bus](int port) -> uint8_t {
+        if (port < 0 || port > 1 || bus->frame_count >= ex.inputs.size()) {
+            return 0x00;
+        }
+        return ex.inputs[bus->frame_count][port];
+    };
+    return nes;
+}
+
+// reads the whole input track, the movie itself is not needed after this
+bool read_inputs(Export &ex, MovieReader &movie) {
+    std::shared_ptr<Bus> nes = make_machine(ex);
+    if (!nes) {
+        std::cerr << "failed to load cartridge: " << ex.rom_path << std::endl;
+        return false;
+    }
+    if (movie.rom_hash != nes->cart->rom_hash()) {
+        std::cerr << "movie was recorded with a different rom" << std::endl;
+        return false;
+    }
+    StateReader start(movie.start_state, movie.start_state_size);
+    if (!nes->load_state(start)) {
+        std::cerr << "movie start state does not match this build" << std::endl;
+        return false;
+    }
+    ex.first_frame = nes->frame_count;
+    ex.end_frame = movie.length() + 1;
+    ex.inputs.resize(ex.end_frame);
+    for (uint64_t f = ex.first_frame; f < ex.end_frame; f++) {
+        movie.input(f, ex.inputs[f][0], ex.inputs[f][1]);
+    }
+    ex.segments.push_back({ex.first_frame, movie.start_state, movie.start_state_size});
+    return true;
+}
+
+// segments from the keyframes stored in the movie
+void use_keyframes(Export &ex, MovieReader &movie) {
+    for (size_t i = 0; i < movie.keyframe_count(); i++) {
+        Export::Segment segment;
+        movie.keyframe(i, segment.begin, segment.state, segment.state_size);
+        if (segment.begin > ex.segments.back().begin && segment.begin < ex.end_frame) {
+            ex.segments.push_back(segment);
+        }
+    }
+}
+
+// first pass: no video, just the states the segments start from
+void scan(Export &ex) {
+    std::shared_ptr<Bus> nes = make_machine(ex);
+    StateReader start(ex.segments[0].state, ex.segments[0].state_size);
+    nes->load_state(start);
+
+    std::vector<uint64_t> begins;
+    nes->ppu.skip_render = true;
+    while (nes->frame_count < ex.end_frame) {
+        if (nes->frame_count > ex.first_frame && (nes->frame_count - ex.first_frame) % ex.segment_frames == 0) {
+            StateWriter state;
+            nes->save_state(state);
+            ex.scanned.push_back(std::move(state.data));
+            begins.push_back(nes->frame_count);
+        }
+        nes->run_frame();
+    }
+    for (size_t i = 0; i < begins.size(); i++) {
+        ex.segments.push_back({begins[i], ex.scanned[i].data(), ex.scanned[i].size()});
+    }
+}
+
+// second pass, one segment per task
+void render_segment(Export &ex, int segment) {
+    const Export::Segment &seg = ex.segments[segment];
+    std::shared_ptr<Bus> nes = make_machine(ex);
+    StateReader state(seg.state, seg.state_size);
+    if (!nes || !nes->load_state(state) || nes->frame_count != seg.begin) {
+        ex.failed = true;
+        return;
+    }
+
+    VideoFilter filter(nullptr);
+    filter.set_palette(&nes->ppu.palette);
+    filter.set_type(ex.filter);
+
+    FILE* file = fopen(ex.out_path.c_str(), "r+b");
+    if (!file) {
+        ex.failed = true;
+        return;
+    }
+    setvbuf(file, nullptr, _IOFBF, FILE_BUF_SIZE);
+
+    int pixels = ex.width * ex.height;
+    std::vector<uint32_t> argb(pixels);
+    std::vector<uint8_t> yuv(pixels + pixels / 2);
+
+    uint64_t end = segment + 1 < (int) ex.segments.size() ? ex.segments[segment + 1].begin : ex.end_frame;
+    // segments are contiguous, seek once and write sequentially
+    fseeko(file, ex.header_size + (off_t) (seg.begin - ex.first_frame) * ex.frame_size, SEEK_SET);
+
+    while (nes->frame_count < end && !ex.failed) {
+        nes->run_frame();
+        filter.apply(nes->ppu.frame->index, 0, 239, argb.data(), ex.width * sizeof(uint32_t));
+        uint8_t* y = yuv.data();
+        uint8_t* u = y + pixels;
+        uint8_t* v = u + pixels / 4;
+        VideoCapture::to_yuv420(argb.data(), ex.width, ex.height, y, u, v);
+        fwrite("FRAME\n", 1, 6, file);
+        fwrite(yuv.data(), 1, yuv.size(), file);
+        ex.frames_done++;
+    }
+    if (fclose(file) != 0) {
+        ex.failed = true;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    Export ex;
+    std::string movie_path;
+    double segment_seconds = 10.0;
+    bool rescan = false;
+    int n_threads = 0;
+    std::vector<std::string> files;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--filter" && i + 1 < argc) {
+            std::string name = argv[++i];
+            if (!VideoFilter::from_name(name, ex.filter)) {
+                std::cerr << "unknown filter: " << name << std::endl;
+                return -1;
+            }
+        }
+        else if (arg == "--segment" && i + 1 < argc) {
+            segment_seconds = atof(argv[++i]);
+        }
+        else if (arg == "--rescan") {
+            // ignore the movie's keyframes, e.g. for shorter segments
+            rescan = true;
+        }
+        else if (arg == "--threads" && i + 1 < argc) {
+            n_threads = atoi(argv[++i]);
+        }
+        else {
+            files.push_back(arg);
+        }
+    }
+    if (files.size() != 3) {
+        std::cerr << "usage: nes-export rom.nes movie out.y4m [--filter name] [--segment seconds] [--rescan] [--threads n]" << std::endl;
+        return -1;
+    }
+    ex.rom_path = files[0];
+    movie_path = files[1];
+    ex.out_path = files[2];
+    // 60.0988 frames per second
+    ex.segment_frames = std::max<uint64_t>(1, (uint64_t) (segment_seconds * 60.0988));
+
+    MovieReader movie;
+    if (!movie.open(movie_path)) {
+        std::cerr << "failed to open movie: " << movie_path << std::endl;
+        return -1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    if (!read_inputs(ex, movie)) {
+        return -1;
+    }
+    if (!rescan) {
+        use_keyframes(ex, movie);
+    }
+    if (ex.segments.size() == 1) {
+        scan(ex);
+    }
+    double scan_time = seconds_since(start);
+
+    VideoFilter sizes(nullptr);
+    sizes.set_type(ex.filter);
+    ex.width = sizes.width();
+    ex.height = sizes.height();
+    ex.frame_size = 6 + (long long) ex.width * ex.height * 3 / 2;
+
+    FILE* out = fopen(ex.out_path.c_str(), "wb");
+    if (!out) {
+        std::cerr << "failed to open output: " << ex.out_path << std::endl;
+        return -1;
+    }
+    std::string header = VideoCapture::y4m_header(ex.width, ex.height);
+    fwrite(header.data(), 1, header.size(), out);
+    fclose(out);
+    ex.header_size = header.size();
+
+    // more segments than threads, so the last ones to finish are short
+    ThreadPool pool(n_threads);
+    int segments = (int) ex.segments.size();
+    std::cerr << "rendering " << segments << " segments on " << pool.size() << " threads" << std::endl;
+    auto render_start = std::chrono::steady_clock::now();
+    pool.parallel_for(segments, [&ex](int segment) {
+        render_segment(ex, segment);
+    });
+    double render_time = seconds_since(render_start);
+
+    if (ex.failed) {
+        std::cerr << "export failed" << std::endl;
+        return -1;
+    }
+    uint64_t frames = ex.frames_done;
+    double total_time = seconds_since(start);
+    double movie_time = frames / 60.0988;
+    printf("%llu frames: scan %.2fs, render %.2fs (%.1f fps), %.1fx real time\n",
+           (unsigned long long) frames, scan_time, render_time,
+           render_time > 0.0 ? frames / render_time : 0.0,
+           total_time > 0.0 ? movie_time / total_time : 0.0);
+    return 0;
+}
@@ -0,0 +1,151 @@
+// builds the metadata index of a rom library (see rom_index.hh)
+//
+// every .nes file (or .zip or .gz holding one) under the given
+// directories is mapped, hashed and has its header parsed, spread over
+// all cores. the frontend and nes-batch then take --index and find roms
+// by title or hash without touching the library. --list prints an index
+//
+// usage: nes-index out.nesidx dir|file... [--threads n]
+//        nes-index --list index.nesidx
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "hash64.hh"
+#include "mapped_file.hh"
+#include "rom_cache.hh"
+#include "rom_index.hh"
+#include "thread_pool.hh"
+
+namespace fs = std::filesystem;
+
+static bool is_rom(const fs::path &path) {
+    std::string ext = path.extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return tolower(c); });
+    return ext == ".nes" || ext == ".zip" || ext == ".gz";
+}
+
+// directories are walked here, reading the files is the parallel part
+static void collect(const std::string &root, std::vector<std::string> &files) {
+    std::error_code error;
+    if (fs::is_regular_file(root, error)) {
+        files.push_back(root);
+        return;
+    }
+    fs::recursive_directory_iterator it(root, fs::directory_options::skip_permission_denied, error), end;
+    if (error) {
+        std::cerr << "can't read " << root << ": " << error.message() << std::endl;
+        return;
+    }
+    for (; it != end; it.increment(error)) {
+        if (error) {
+            break;
+        }
+        if (it->is_regular_file(error) && is_rom(it->path())) {
+            files.push_back(it->path().string());
+        }
+    }
+}
+
+static bool scan(const std::string &path, RomIndex::Rom &rom) {
+    MappedFile file;
+    if (!file.open(path)) {
+        return false;
+    }
+    rom.file_hash = Hash64::hash(file.data(), file.size());
+    std::shared_ptr<const RomImage> image = RomImage::load(std::move(file));
+    if (!image) {
+        return false;
+    }
+    rom.info = image->info;
+    rom.rom_hash = image->rom_hash();
+    rom.path = fs::absolute(path).string();
+    // game.nes.gz -> game
+    fs::path title = fs::path(path).stem();
+    if (is_rom(title)) {
+        title = title.stem();
+    }
+    rom.title = title.string();
+    return true;
+}
+
+static int list(const std::string &path) {
+    RomIndex index;
+    if (!index.open(path)) {
+        std::cerr << "failed to open index: " << path << std::endl;
+        return -1;
+    }
+    for (size_t i = 0; i < index.count(); i++) {
+        const RomIndex::Entry &e = index.entry(i);
+        printf("%016" PRIx64 " mapper %3u.%u prg %5uk chr %4uk %-5s %s%s %s\n",
+               e.file_hash, e.mapper, e.submapper, e.prg_rom_size / 1024, e.chr_rom_size / 1024,
+               RomInfo::region_name((RomInfo::Region) e.region),
+               e.flags & RomIndex::FLAG_NES2 ? "nes2 " : "",
+               e.flags & RomIndex::FLAG_BATTERY ? "battery " : "",
+               index.title(e));
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    int n_threads = 0;
+    std::vector<std::string> args;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--threads" && i + 1 < argc) {
+            n_threads = atoi(argv[++i]);
+        }
+        else if (arg == "--list" && i + 1 < argc) {
+            return list(argv[++i]);
+        }
+        else {
+            args.push_back(arg);
+        }
+    }
+    if (args.size() < 2) {
+        std::cerr << "usage: nes-index out.nesidx dir|file... [--threads n]" << std::endl;
+        std::cerr << "       nes-index --list index.nesidx" << std::endl;
+        return -1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::string> files;
+    for (size_t i = 1; i < args.size(); i++) {
+        collect(args[i], files);
+    }
+
+    std::vector<RomIndex::Rom> roms(files.size());
+    std::vector<char> ok(files.size());
+    ThreadPool pool(n_threads);
+    pool.parallel_for((int) files.size(), [&](int i) {
+        ok[i] = scan(files[i], roms[i]);
+    });
+
+    std::vector<RomIndex::Rom> found;
+    for (size_t i = 0; i < files.size(); i++) {
+        if (ok[i]) {
+            found.push_back(std::move(roms[i]));
+        }
+        else {
+            std::cerr << "skipped " << files[i] << std::endl;
+        }
+    }
+    size_t n_found = found.size();
+    if (!RomIndex::write(args[0], std::move(found))) {
+        std::cerr << "failed to write index: " << args[0] << std::endl;
+        return -1;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("indexed %zu of %zu files in %.2fs on %d threads\n", n_found, files.size(), seconds, pool.size());
+    return 0;
+}
@@ -0,0 +1,115 @@
+// times the mappers' address translation against nrom's
+//
+// every registered board is built with 256kb of prg and 64kb of chr,
+// switched to a middle bank, and asked to map the same random cpu and ppu
+// addresses through the Mapper_Template interface the cartridge uses. the
+// cost per access should match mapper 0's, a bank switch only changes an
+// offset the read adds
+//
+// usage: nes-mapper-bench [--reads n]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "mappers/mapper_registry.hh"
+
+// the fastest of a few runs, in ns per access
+template <typename F>
+static double time_reads(F read, const std::vector<uint16_t> &addrs, uint32_t &sink) {
+    double best = 1e9;
+    for (int run = 0; run < 5; run++) {
+        auto start = std::chrono::steady_clock::now();
+        for (uint16_t addr : addrs) {
+            uint32_t mapped = 0;
+            if (read(addr, mapped)) {
+                sink += mapped;
+            }
+        }
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        if (ns / addrs.size() < best) {
+            best = ns / addrs.size();
+        }
+    }
+    return best;
+}
+
+int main(int argc, char* argv[]) {
+    size_t n_reads = 1 << 22;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--reads" && i + 1 < argc) {
+            n_reads = strtoull(argv[++i], nullptr, 10);
+        }
+        else {
+            std::cerr << "usage: nes-mapper-bench [--reads n]" << std::endl;
+            return -1;
+        }
+    }
+    if (n_reads == 0) {
+        n_reads = 1;
+    }
+
+    MapperRegistry::Board board;
+    board.banks_PRG = 16;
+    board.banks_CHR = 8;
+    board.set_mirror = [](uint8_t) {};
+    std::vector<MapperRegistry::Entry> entries = MapperRegistry::all();
+    std::vector<std::shared_ptr<Mapper_Template>> mappers;
+    for (const MapperRegistry::Entry &entry : entries) {
+        std::shared_ptr<Mapper_Template> mapper = entry.create(board);
+        // pick a bank that isn't the power-on one. mmc1 takes five serial
+        // writes, mmc3 a select then a bank, the rest one latch write
+        uint32_t ignored = 0;
+        if (entry.id == 1) {
+            for (int i = 0; i < 5; i++) {
+                mapper->cpu_mapwrite(0xE000, ignored, (3 >> i) & 1);
+            }
+        }
+        else if (entry.id == 4) {
+            mapper->cpu_mapwrite(0x8000, ignored, 6);
+            mapper->cpu_mapwrite(0x8001, ignored, 3);
+        }
+        else {
+            mapper->cpu_mapwrite(0x8000, ignored, 0x21);
+        }
+        mappers.push_back(mapper);
+    }
+
+    std::mt19937 rng(1);
+    std::vector<uint16_t> cpu_addrs(n_reads), ppu_addrs(n_reads);
+    for (size_t i = 0; i < n_reads; i++) {
+        cpu_addrs[i] = 0x8000 | (rng() & 0x7FFF);
+        ppu_addrs[i] = rng() & 0x1FFF;
+    }
+
+    uint32_t sink = 0;
+    double base_cpu = 0, base_ppu = 0;
+    printf("%-18s %10s %10s\n", "mapper", "cpu ns", "ppu ns");
+    for (size_t i = 0; i < entries.size(); i++) {
+        Mapper_Template* m = mappers[i].get();
+        char name[32];
+        snprintf(name, sizeof(name), "%03u %s", entries[i].id, entries[i].name);
+        double cpu = time_reads([m](uint16_t a, uint32_t &out) { return m->cpu_mapread(a, out); }, cpu_addrs, sink);
+        double ppu = time_reads([m](uint16_t a, uint32_t &out) { return m->ppu_mapread(a, out); }, ppu_addrs, sink);
+        if (entries[i].id == 0) {
+            base_cpu = cpu;
+            base_ppu = ppu;
+            printf("%-18s %10.2f %10.2f\n", name, cpu, ppu);
+        }
+        else {
+            printf("%-18s %10.2f %10.2f   (%+.0f%%, %+.0f%%)\n", name, cpu, ppu,
+                   (cpu / base_cpu - 1) * 100, (ppu / base_ppu - 1) * 100);
+        }
+    }
+    // keeps the reads from being optimized out
+    if (sink == 1) {
+        printf("\n");
+    }
+    return 0;
+}
@@ -0,0 +1,225 @@
+// checks that an input movie replays deterministically
+//
+// runs two independent machines on the movie in parallel threads, hashing
+// every component's state after each frame, and reports the first frame
+// and components where they disagree. --dump writes the hashes of a run to
+// a text file and --against compares a run with such a file, e.g. one made
+// by another build or on another platform
+//
+// usage: nes-verify rom.nes movie [--dump hashes.txt] [--against hashes.txt]
+
+#include <algorithm>
+#include <array>
+#include <cinttypes>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bus.hh"
+#include "cartridge.hh"
+#include "movie.hh"
+#include "state.hh"
+
+typedef std::array<uint64_t, Bus::N_STATE_COMPONENTS> FrameHash;
+
+struct Run {
+    std::vector<FrameHash> hashes;
+    // first frame the hashes are for
+    uint64_t first_frame = 0;
+    std::string error;
+};
+
+// plays the whole movie on a fresh machine, hashing every frame
+void play(const std::string &rom_path, const MovieReader &movie,
+          const std::vector<std::array<uint8_t, 2>> &inputs, Run &run) {
+    std::shared_ptr<Cartridge> cart = std::make_shared<Cartridge>(rom_path, &RomCache::global());
+    if (!cart->valid) {
+        run.error = "failed to load cartridge: " + rom_path;
+        return;
+    }
+    if (movie.rom_hash != cart->rom_hash()) {
+        run.error = "movie was recorded with a different rom";
+        return;
+    }
+    std::shared_ptr<Bus> nes = std::make_shared<Bus>();
+    nes->insert_cartridge(cart);
+    nes->reset();
+    nes->audio_output = false;
+    nes->ppu.output_mode = PPU::OUTPUT_INDEXED;
+
+    StateReader start(movie.start_state, movie.start_state_size);
+    if (!nes->load_state(start)) {
+        run.error = "movie start state does not match this build";
+        return;
+    }
+
+    Bus* bus = nes.get();
+    nes->rp.input_provider = [&inputs, bus](int port) -> uint8_t {
+        if (port < 0 || port > 1 || bus->frame_count >= inputs.size()) {
+            return 0x00;
+        }
+        return inputs[bus->frame_count][port];
+    };
+
+    nes->hash_frames = true;
+    run.first_frame = nes->frame_count;
+    run.hashes.reserve(inputs.size() - run.first_frame);
+    while (nes->frame_count < inputs.size()) {
+        nes->run_frame();
+        FrameHash hash;
+        std::copy(nes->frame_hash, nes->frame_hash + Bus::N_STATE_COMPONENTS, hash.begin());
+        run.hashes.push_back(hash);
+    }
+}
+
+// one line per frame: the frame number then each component's hash
+bool dump(const std::string &path, const Run &run) {
+    FILE* f = fopen(path.c_str(), "w");
+    if (!f) {
+        return false;
+    }
+    fprintf(f, "# frame");
+    for (int c = 0; c < Bus::N_STATE_COMPONENTS; c++) {
+        fprintf(f, " %s", Bus::component_name(c));
+    }
+    fprintf(f, "\n");
+    for (size_t i = 0; i < run.hashes.size(); i++) {
+        fprintf(f, "%" PRIu64, run.first_frame + i);
+        for (uint64_t h : run.hashes[i]) {
+            fprintf(f, " %016" PRIx64, h);
+        }
+        fprintf(f, "\n");
+    }
+    return fclose(f) == 0;
+}
+
+bool load(const std::string &path, Run &run) {
+    FILE* f = fopen(path.c_str(), "r");
+    if (!f) {
+        return false;
+    }
+    char line[512];
+    bool first = true;
+    while (fgets(line, sizeof(line), f)) {
+        if (line[0] == '#') {
+            continue;
+        }
+        uint64_t frame;
+        FrameHash hash;
+        int n = 0;
+        const char* p = line;
+        int used;
+        if (sscanf(p, "%" SCNu64 "%n", &frame, &used) != 1) {
+            continue;
+        }
+        p += used;
+        while (n < Bus::N_STATE_COMPONENTS && sscanf(p, " %" SCNx64 "%n", &hash[n], &used) == 1) {
+            p += used;
+            n++;
+        }
+        if (n != Bus::N_STATE_COMPONENTS) {
+            fclose(f);
+            return false;
+        }
+        if (first) {
+            run.first_frame = frame;
+            first = false;
+        }
+        run.hashes.push_back(hash);
+    }
+    fclose(f);
+    return true;
+}
+
+// returns true if the runs agree on every frame they both have
+bool compare(const Run &a, const Run &b) {
+    if (a.first_frame != b.first_frame) {
+        std::cerr << "runs start at different frames: " << a.first_frame << " and " << b.first_frame << std::endl;
+        return false;
+    }
+    size_t n = std::min(a.hashes.size(), b.hashes.size());
+    for (size_t i = 0; i < n; i++) {
+        if (a.hashes[i] == b.hashes[i]) {
+            continue;
+        }
+        // the frame's hashes are taken after it ran
+        printf("diverged in frame %" PRIu64 ":", a.first_frame + i);
+        for (int c = 0; c < Bus::N_STATE_COMPONENTS; c++) {
+            if (a.hashes[i][c] != b.hashes[i][c]) {
+                printf(" %s", Bus::component_name(c));
+            }
+        }
+        printf("\n");
+        return false;
+    }
+    if (a.hashes.size() != b.hashes.size()) {
+        printf("runs agree on %zu frames, but one has %zu and the other %zu\n",
+               n, a.hashes.size(), b.hashes.size());
+        return false;
+    }
+    printf("%zu frames identical\n", n);
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    std::string dump_path;
+    std::string against_path;
+    std::vector<std::string> files;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--dump" && i + 1 < argc) {
+            dump_path = argv[++i];
+        }
+        else if (arg == "--against" && i + 1 < argc) {
+            against_path = argv[++i];
+        }
+        else {
+            files.push_back(arg);
+        }
+    }
+    if (files.size() != 2) {
+        std::cerr << "usage: nes-verify rom.nes movie [--dump hashes.txt] [--against hashes.txt]" << std::endl;
+        return -1;
+    }
+
+    MovieReader movie;
+    if (!movie.open(files[1])) {
+        std::cerr << "failed to open movie: " << files[1] << std::endl;
+        return -1;
+    }
+    // the input track is read once and shared, the reader streams
+    std::vector<std::array<uint8_t, 2>> inputs(movie.length() + 1);
+    for (uint64_t f = 0; f < inputs.size(); f++) {
+        movie.input(f, inputs[f][0], inputs[f][1]);
+    }
+
+    Run a, b;
+    if (against_path.empty()) {
+        std::thread other([&]() {
+            play(files[0], movie, inputs, b);
+        });
+        play(files[0], movie, inputs, a);
+        other.join();
+    }
+    else {
+        play(files[0], movie, inputs, a);
+        if (!load(against_path, b)) {
+            std::cerr << "failed to read hashes: " << against_path << std::endl;
+            return -1;
+        }
+    }
+    if (!a.error.empty() || !b.error.empty()) {
+        std::cerr << (a.error.empty() ? b.error : a.error) << std::endl;
+        return -1;
+    }
+
+    if (!dump_path.empty() && !dump(dump_path, a)) {
+        std::cerr << "failed to write hashes: " << dump_path << std::endl;
+        return -1;
+    }
+    return compare(a, b) ? 0 : 1;
+}